@@ -1,15 +1,30 @@
 {
+  "variables": {
+    # The tree-sitter runtime, which the binding compiles in for
+    # parseFiles since an addon cannot link against the one in the
+    # tree-sitter module. The script stops with an error if the module,
+    # a peer dependency, is missing.
+    "tree_sitter_lib%": "<!(node script/tree-sitter-lib.js)"
+  },
   "targets": [
     {
       "target_name": "tree_sitter_latex_binding",
       "include_dirs": [
         "<!(node -e \"require('nan')\")",
-        "src"
+        "src",
+        "<(tree_sitter_lib)/include",
+        "<(tree_sitter_lib)/src"
       ],
       "sources": [
+        "<(tree_sitter_lib)/src/lib.c",
+        "src/batch.cc",
         "src/binding.cc",
+        "src/budget.cc",
         "src/catcode.cc",
+        "src/histogram.cc",
+        "src/index.cc",
         "src/parser.c",
+        "src/parser_pool.cc",
         "src/scanner_control_sequences.cc",
         "src/scanner_environments.cc",
         "src/scanner_keywords.cc",
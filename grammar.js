@@ -45,6 +45,14 @@ function parenGroup ($, ...contents) {
   return seq($.lparen, ...contents, $.rparen)
 }
 
+function opaqueBody ($, opaque, ...contents) {
+  if (!opaque) {
+    return contents
+  }
+
+  return [choice($.opaque_env, (contents.length === 1) ? contents[0] : seq(...contents))]
+}
+
 let rules = {
   _: [],
   common: [],
@@ -70,6 +78,7 @@ let g = {
     $.comma,
     $.comment_arara,
     $.comment_bib,
+    $.comment_lines,
     $.comment_tag,
     $.comment_tex,
     $.comment,
@@ -257,6 +266,8 @@ let g = {
     $.minus,
     $.name,
     $.octal,
+    $.opaque_env,
+    $.opaque_math,
     $.par_eol,
     $.parameter_ref,
     $.plus_sym,
@@ -285,6 +296,7 @@ let g = {
     $._space,
     $.comment_arara,
     $.comment_bib,
+    $.comment_lines,
     $.comment_tag,
     $.comment_tex,
     $.comment
@@ -554,7 +566,9 @@ function defCmd (mode, label, { cs, parameters, apply }) {
   rules[mode].push($ => label === cmdSym ? $[cmdSym] : alias($[cmdSym], $[label]))
 }
 
-function defEnv (mode, label, { name, beginParameters, endParameters, contents, bare }) {
+// With opaque set the body may instead be a single opaque_env token when the
+// scanner is in opaque region mode.
+function defEnv (mode, label, { name, beginParameters, endParameters, contents, bare, opaque }) {
   const envSym = `${label}_env`
   const envMathSym = `${label}_math_env`
   const envTextSym = `${label}_text_env`
@@ -595,7 +609,7 @@ function defEnv (mode, label, { name, beginParameters, endParameters, contents,
     g.rules[envMathSym] = $ => seq(
       alias($[beginRuleSym], $.begin),
       // ...(bare ? [] : [$._env_begin]),
-      repeat($._math_mode),
+      ...opaqueBody($, opaque, repeat($._math_mode)),
       choice(
         alias($[endRuleSym], $.end),
         $.exit
@@ -606,7 +620,7 @@ function defEnv (mode, label, { name, beginParameters, endParameters, contents,
     g.rules[envTextSym] = $ => seq(
       alias($[beginRuleSym], $.begin),
       // ...(bare ? [] : [$._env_begin]),
-      repeat($._text_mode),
+      ...opaqueBody($, opaque, repeat($._text_mode)),
       choice(
         alias($[endRuleSym], $.end),
         $.exit
@@ -620,7 +634,7 @@ function defEnv (mode, label, { name, beginParameters, endParameters, contents,
     g.rules[envSym] = $ => seq(
       alias($[beginRuleSym], $.begin),
       // ...(bare ? [] : [$._env_begin]),
-      ...(contents ? contents($) : [repeat(mode === 'math' ? $._math_mode : $._text_mode)]),
+      ...opaqueBody($, opaque, ...(contents ? contents($) : [repeat(mode === 'math' ? $._math_mode : $._text_mode)])),
       choice(
         alias($[endRuleSym], $.end),
         $.exit
@@ -634,9 +648,29 @@ function defEnv (mode, label, { name, beginParameters, endParameters, contents,
 
 const root = 'grammar'
 
-console.warn(`Loading grammar definitions...`)
+// Each profile lists the module path prefixes under grammar/ it includes. The
+// scanner has to be built with the matching LATEX_PROFILE_* define.
+const profiles = {
+  core: ['initex.js', 'latex/base/', 'latex/tools/verbatim-sty.js'],
+  'core+ams': ['initex.js', 'latex/base/', 'latex/tools/verbatim-sty.js', 'latex/amsmath/'],
+  full: ['']
+}
+
+const profile = process.env.TREE_SITTER_LATEX_PROFILE || 'full'
+
+if (!(profile in profiles)) {
+  throw new Error(`Unknown grammar profile ${profile}`)
+}
+
+console.warn(`Loading grammar definitions for ${profile} profile...`)
 
 for (const filePath of readdir.sync(root, { deep: true, filter: '**/*.js' })) {
+  const modulePath = filePath.split(path.sep).join('/')
+
+  if (!profiles[profile].some(prefix => modulePath.startsWith(prefix))) {
+    continue
+  }
+
   console.warn(`  ${path.join(root, filePath)}`)
   const m = require(path.join(__dirname, root, filePath))
 
@@ -121,7 +121,7 @@ module.exports = {
     rules: {
       tex_display_math: $ => seq(
         $.display_math_shift,
-        repeat($._math_mode),
+        choice($.opaque_math, repeat($._math_mode)),
         choice(
           alias($.display_math_shift_end, $.display_math_shift),
           seq($.math_shift, $.exit),
@@ -130,7 +130,7 @@ module.exports = {
       ),
       tex_inline_math: $ => seq(
         $.math_shift,
-        repeat1($._math_mode),
+        choice($.opaque_math, repeat1($._math_mode)),
         choice(alias($.math_shift_end, $.math_shift), $.exit)
       )
     }
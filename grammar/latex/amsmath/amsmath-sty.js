@@ -6,6 +6,7 @@ module.exports = {
     environments: {
       alignat: {
         name: $ => $.env_name_alignat,
+        opaque: true,
         beginParameters: $ => [$._text_token],
         contents: $ => [repeat($._math_mode)]
       }
@@ -179,6 +179,7 @@ module.exports = {
     environments: {
       tabular: {
         name: $ => $.env_name_tabular,
+        opaque: true,
         beginParameters: $ => [
           optional($.brack_group),
           $._text_token
@@ -187,6 +188,7 @@ module.exports = {
       },
       tabularstar: {
         name: $ => $.env_name_tabularstar,
+        opaque: true,
         beginParameters: $ => [
           $._text_token,
           optional($.brack_group),
@@ -247,6 +249,7 @@ module.exports = {
     environments: {
       array: {
         name: $ => $.env_name_array,
+        opaque: true,
         beginParameters: $ => [
           optional($.brack_group),
           $._text_token
@@ -527,6 +530,7 @@ module.exports = {
     environments: {
       display_math: {
         name: $ => $.env_name_display_math,
+        opaque: true,
         contents: $ => [repeat($._math_mode)]
       },
       document: {
@@ -539,6 +543,7 @@ module.exports = {
       },
       inline_math: {
         name: $ => $.env_name_inline_math,
+        opaque: true,
         contents: $ => [repeat($._math_mode)]
       },
       itemize: {
@@ -585,12 +590,12 @@ module.exports = {
     rules: {
       latex_display_math: $ => seq(
         alias($.cs_display_math_begin, $.cs),
-        repeat($._math_mode),
+        choice($.opaque_math, repeat($._math_mode)),
         choice(alias($.cs_display_math_end, $.cs), $.exit)
       ),
       latex_inline_math: $ => seq(
         alias($.cs_inline_math_begin, $.cs),
-        repeat($._math_mode),
+        choice($.opaque_math, repeat($._math_mode)),
         choice(alias($.cs_inline_math_end, $.cs), $.exit)
       )
     }
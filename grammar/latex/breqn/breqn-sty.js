@@ -3,6 +3,7 @@ module.exports = {
     environments: {
       dmath: {
         name: $ => $.env_name_dmath,
+        opaque: true,
         beginParameters: $ => [optional($.brack_group)],
         contents: $ => [repeat($._math_mode)]
       },
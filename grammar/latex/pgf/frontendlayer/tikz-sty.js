@@ -3,6 +3,7 @@ module.exports = {
     environments: {
       tikzpicture: {
         name: $ => $.env_name_tikzpicture,
+        opaque: true,
         beginParameters: $ => [optional($.brack_group)]
       }
     }
@@ -0,0 +1,36 @@
+try {
+  module.exports = require('./build/Release/tree_sitter_latex_binding')
+} catch (error) {
+  try {
+    module.exports = require('./build/Debug/tree_sitter_latex_binding')
+  } catch (_) {
+    throw error
+  }
+}
+
+// The kinds in the records of parseFilesAsync, indexed by their number. Each
+// record is the seven numbers kind, level, section, startByte, endByte,
+// keyStart and keyEnd, see LaTeX::IndexEntry in src/index.hh.
+module.exports.recordKinds = [
+  'label', 'ref', 'cite', 'section', 'bibitem', 'newcommand',
+  'newenvironment', 'newglossaryentry', 'input', 'package', 'class'
+]
+
+// Reads and parses files on the libuv thread pool, so the files are parsed
+// on up to UV_THREADPOOL_SIZE threads while the event loop goes on. No trees
+// are kept. Each result has the path and either an error, budgetExceeded and
+// the offset the parse reached, or hasError and the records of the file as
+// an Int32Array. With the keys option the key of each record is included as
+// a string and with a budget in milliseconds the parse of a file is
+// abandoned when it takes longer.
+module.exports.parseFilesAsync = function (paths, options) {
+  return new Promise((resolve, reject) => {
+    module.exports.parseFiles(paths, options || {}, (error, results) => {
+      if (error) {
+        reject(error)
+      } else {
+        resolve(results)
+      }
+    })
+  })
+}
@@ -0,0 +1,207 @@
+#!/usr/bin/env node
+
+// Parses LaTeX files or the examples in corpus files with the parser's log
+// enabled and aggregates the GLR stack splits and merges by parse state and by
+// the command that the input at the split belongs to. Steps taken on stack
+// versions other than the first are counted as redundant work and used to
+// estimate the share of the parse time each command is responsible for.
+//
+// Usage: script/ambiguity-profile.js [file or directory ...]
+//
+// Directories are searched for .txtt, .tex, .ltx, .cls, .sty and .dtx files.
+// The corpus directory is profiled if no paths are given.
+
+const fs = require('fs')
+const Parser = require('tree-sitter')
+const language = require('..')
+const path = require('path')
+const readdir = require('readdir-enhanced')
+
+const REPORT_COUNT = 25
+const EXAMPLE_SEPARATOR = /^={3,}\n[^\n]*\n={3,}\n([\s\S]*?)\n-{3,}\n/gm
+
+const states = new Map()
+const commands = new Map()
+const reductions = new Map()
+const totals = { documents: 0, steps: 0, redundant: 0, splits: 0, merges: 0, time: 0 }
+
+function entry (map, key) {
+  if (!map.has(key)) {
+    map.set(key, { key, splits: 0, merges: 0, redundant: 0, time: 0 })
+  }
+
+  return map.get(key)
+}
+
+// Log lines look like "process version:0, version_count:1, state:1, row:0,
+// col:0". Depending on the binding the arguments are either passed separately
+// or left in the message.
+function parseLog (message, params) {
+  const [name, ...rest] = message.split(' ')
+  const args = Object.assign({}, params)
+
+  for (const pair of rest.join(' ').split(', ')) {
+    const index = pair.indexOf(':')
+
+    if (index > 0) {
+      args[pair.slice(0, index)] = pair.slice(index + 1)
+    }
+  }
+
+  return { name, args }
+}
+
+// Find the command the input at a position belongs to, i.e. the nearest
+// ancestor that starts with a control sequence.
+function commandAt (tree, row, column) {
+  let node = tree.rootNode.descendantForPosition({ row, column })
+
+  while (node) {
+    const first = node.firstChild
+
+    if (first && first.type === 'cs' && node.type !== 'cs') {
+      return node.type
+    }
+
+    if (!node.parent) {
+      return node.type
+    }
+
+    node = node.parent
+  }
+
+  return 'document'
+}
+
+function profileDocument (code) {
+  const parser = new Parser()
+  const events = []
+  let versionCount = 1
+  let previous = null
+  let redundant = false
+
+  parser.setLanguage(language)
+
+  // Time a parse without the log first since logging dominates otherwise.
+  const start = process.hrtime()
+  parser.parse(code)
+  const [seconds, nanoseconds] = process.hrtime(start)
+  const time = seconds * 1e3 + nanoseconds / 1e6
+
+  parser.setLogger((message, params, type) => {
+    if (type === 'lex') {
+      return
+    }
+
+    const { name, args } = parseLog(message, params)
+
+    if (name === 'process') {
+      const count = parseInt(args.version_count)
+      const event = {
+        state: parseInt(args.state),
+        row: parseInt(args.row),
+        column: parseInt(args.col),
+        split: 0,
+        merge: 0,
+        redundant: parseInt(args.version) > 0
+      }
+
+      // A change in the number of versions is caused by the actions of the
+      // previously processed version.
+      if (previous && count > versionCount) {
+        previous.split += count - versionCount
+      } else if (previous && count < versionCount) {
+        previous.merge += versionCount - count
+      }
+
+      versionCount = count
+      previous = event
+      redundant = event.redundant
+      events.push(event)
+    } else if (name === 'reduce' && redundant) {
+      entry(reductions, args.sym).redundant++
+    }
+  })
+
+  const tree = parser.parse(code)
+  parser.setLogger(null)
+
+  const redundantSteps = events.filter(event => event.redundant).length
+
+  totals.documents++
+  totals.steps += events.length
+  totals.redundant += redundantSteps
+  totals.time += time
+
+  for (const event of events) {
+    if (!event.split && !event.merge && !event.redundant) {
+      continue
+    }
+
+    const command = commandAt(tree, event.row, event.column)
+    const share = event.redundant ? time / events.length : 0
+
+    for (const e of [entry(states, event.state), entry(commands, command)]) {
+      e.splits += event.split
+      e.merges += event.merge
+      e.redundant += event.redundant ? 1 : 0
+      e.time += share
+    }
+
+    totals.splits += event.split
+    totals.merges += event.merge
+  }
+}
+
+function profileFile (filePath) {
+  const code = fs.readFileSync(filePath, 'utf8')
+
+  if (path.extname(filePath) !== '.txtt') {
+    profileDocument(code)
+    return
+  }
+
+  let match
+
+  EXAMPLE_SEPARATOR.lastIndex = 0
+
+  while ((match = EXAMPLE_SEPARATOR.exec(code)) !== null) {
+    profileDocument(match[1])
+  }
+}
+
+function report (title, map, key) {
+  const rows = Array.from(map.values())
+    .sort((a, b) => (b[key] - a[key]) || (b.splits - a.splits))
+    .slice(0, REPORT_COUNT)
+
+  console.log(`\n${title}`)
+  console.log(['Splits', 'Merges', 'Redundant', 'Est. ms', 'Name'].join('\t'))
+
+  for (const row of rows) {
+    console.log([row.splits, row.merges, row.redundant, row.time.toFixed(3), row.key].join('\t'))
+  }
+}
+
+const paths = process.argv.length > 2
+  ? process.argv.slice(2)
+  : [path.join(__dirname, '..', 'corpus')]
+
+for (const p of paths) {
+  if (fs.statSync(p).isDirectory()) {
+    for (const filePath of readdir.sync(p, { deep: true, filter: '**/*.{txtt,tex,ltx,cls,sty,dtx}' })) {
+      profileFile(path.join(p, filePath))
+    }
+  } else {
+    profileFile(p)
+  }
+}
+
+console.log(`Documents: ${totals.documents} Parse time: ${totals.time.toFixed(1)} ms`)
+console.log(`Steps: ${totals.steps} Redundant: ${totals.redundant} ` +
+  `(${(100 * totals.redundant / Math.max(totals.steps, 1)).toFixed(1)}%) ` +
+  `Splits: ${totals.splits} Merges: ${totals.merges}`)
+
+report('Commands by estimated parse time on redundant stacks', commands, 'time')
+report('Parse states by splits', states, 'splits')
+report('Rules reduced on redundant stacks', reductions, 'redundant')
@@ -0,0 +1,93 @@
+// Measures the throughput of the catcode bitmap kernels over the
+// concatenation of the given files, e.g. the corpus. Every kernel the CPU
+// supports is checked against the scalar one first.
+//
+// Usage: catcode-benchmark <file>...
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "catcode_bitmap.hh"
+
+using namespace LaTeX;
+
+const int ITERATION_COUNT = 200;
+
+template <typename Function> double measure(Function function) {
+  std::vector<double> durations;
+
+  for (int i = 0; i < ITERATION_COUNT; i++) {
+    auto start = std::chrono::steady_clock::now();
+    function();
+    std::chrono::duration<double> duration =
+        std::chrono::steady_clock::now() - start;
+    durations.push_back(duration.count());
+  }
+
+  // The median is less sensitive to other work on the machine.
+  std::sort(durations.begin(), durations.end());
+
+  return durations[durations.size() / 2];
+}
+
+int main(int argc, char **argv) {
+  const char *names[] = {"auto", "scalar", "sse2", "avx2"};
+  std::string text;
+
+  if (argc < 2) {
+    std::cerr << "Usage: catcode-benchmark <file>..." << std::endl;
+    return 1;
+  }
+
+  for (int i = 1; i < argc; i++) {
+    std::ifstream stream(argv[i], std::ios::binary);
+    std::stringstream contents;
+
+    if (!stream) {
+      std::cerr << "Unable to read " << argv[i] << std::endl;
+      return 1;
+    }
+
+    contents << stream.rdbuf();
+    text += contents.str();
+  }
+
+  std::vector<CatCodeBitmaps> expected, actual;
+
+  CatCodeClassifier(CatCodeTable(), SCALAR_KERNEL)
+      .classify(text.data(), text.size(), expected);
+
+  std::cerr << "Bytes: " << text.size() << std::endl;
+
+  for (CatCodeKernel id : {SCALAR_KERNEL, SSE2_KERNEL, AVX2_KERNEL}) {
+    if (!CatCodeClassifier::supported(id)) {
+      std::cerr << names[id] << ": not supported" << std::endl;
+      continue;
+    }
+
+    CatCodeClassifier classifier(CatCodeTable(), id);
+
+    classifier.classify(text.data(), text.size(), actual);
+
+    if (actual.size() != expected.size() ||
+        std::memcmp(actual.data(), expected.data(),
+                    actual.size() * sizeof(CatCodeBitmaps)) != 0) {
+      std::cerr << names[id] << ": bitmaps differ from scalar" << std::endl;
+      return 1;
+    }
+
+    double duration = measure(
+        [&]() { classifier.classify(text.data(), text.size(), actual); });
+
+    std::cerr << names[id] << ": " << text.size() / duration / 1e9 << " GB/s"
+              << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,108 @@
+#!/usr/bin/env node
+
+// Builds the grammar with CMake in each build profile and compares the
+// throughput of the corpus benchmark, or of the scanner benchmark over the
+// corpus files if no tree-sitter runtime was found. The PGO profile is built
+// in two stages, with a training run on the corpus in between.
+//
+// Usage: script/compare-builds.js [<build directory>]
+
+const childProcess = require('child_process')
+const fs = require('fs')
+const path = require('path')
+
+const ROOT = path.resolve(__dirname, '..')
+const PROFILES = [
+  { name: 'default', options: [] },
+  { name: 'O3', options: ['-DLATEX_O3=ON'] },
+  { name: 'O3+LTO', options: ['-DLATEX_O3=ON', '-DLATEX_LTO=ON'] },
+  { name: 'O3+LTO+PGO', options: ['-DLATEX_O3=ON', '-DLATEX_LTO=ON'], pgo: true }
+]
+const RUNS = 5
+
+const buildRoot = path.resolve(process.argv[2] || path.join(ROOT, 'build', 'profiles'))
+const corpusFiles = []
+
+collect(path.join(ROOT, 'corpus'))
+
+const directories = PROFILES.map(profile => {
+  const directory = path.join(buildRoot, profile.name.replace(/\+/g, '-'))
+
+  if (profile.pgo) {
+    build(directory, profile.options.concat('-DLATEX_PGO=GENERATE'))
+    run('cmake', ['--build', directory, '--target', 'pgo-train'])
+    build(directory, profile.options.concat('-DLATEX_PGO=USE'))
+  } else {
+    build(directory, profile.options.concat('-DLATEX_PGO='))
+  }
+
+  return directory
+})
+
+// The scanner benchmark reads a single file.
+const corpusText = path.join(buildRoot, 'corpus.txtt')
+
+fs.writeFileSync(corpusText, Buffer.concat(corpusFiles.map(name => fs.readFileSync(name))))
+
+// The profiles take turns so that a slow phase of the machine affects all of
+// them, and the best run of each counts since other processes only ever slow
+// a run down.
+const results = PROFILES.map(profile => ({ name: profile.name, throughput: 0 }))
+
+for (let i = 0; i < RUNS; i++) {
+  directories.forEach((directory, index) => {
+    results[index].throughput = Math.max(results[index].throughput, benchmark(directory))
+  })
+}
+
+console.log('profile'.padEnd(12) + 'MB/s'.padStart(10) + 'gain'.padStart(10))
+
+for (const result of results) {
+  const gain = 100 * (result.throughput / results[0].throughput - 1)
+
+  console.log(result.name.padEnd(12) + result.throughput.toFixed(2).padStart(10) +
+    ((gain >= 0 ? '+' : '') + gain.toFixed(1) + '%').padStart(10))
+}
+
+function collect (directory) {
+  for (const entry of fs.readdirSync(directory)) {
+    const name = path.join(directory, entry)
+
+    if (fs.statSync(name).isDirectory()) {
+      collect(name)
+    } else if (name.endsWith('.txtt')) {
+      corpusFiles.push(name)
+    }
+  }
+}
+
+function run (command, args) {
+  const result = childProcess.spawnSync(command, args, { encoding: 'utf8' })
+
+  if (result.status !== 0) {
+    console.warn(result.stdout + result.stderr)
+    console.warn(command + ' ' + args.join(' ') + ' failed')
+    process.exit(1)
+  }
+
+  return result.stderr
+}
+
+function build (directory, options) {
+  run('cmake', ['-S', ROOT, '-B', directory].concat(options))
+  run('cmake', ['--build', directory])
+}
+
+function throughputOf (output) {
+  return parseFloat(/MB\/s: ([0-9.]+)/.exec(output)[1])
+}
+
+function benchmark (directory) {
+  const corpusBenchmark = path.join(directory, 'corpus-benchmark')
+
+  if (fs.existsSync(corpusBenchmark)) {
+    return throughputOf(run(corpusBenchmark, [path.join(ROOT, 'corpus')]))
+  }
+
+  return throughputOf(run(path.join(directory, 'scanner-benchmark'), ['text', corpusText]))
+}
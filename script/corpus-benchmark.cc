@@ -0,0 +1,110 @@
+// Parses the input of every test case in the corpus files below a set of
+// directories and reports the throughput. The cases cover most of the
+// grammar and the scanner, which makes this the training run of a PGO
+// build as well, see CMakeLists.txt. The load time is that of creating the
+// parser and the first parse, which pages in the parse table.
+//
+// Usage: corpus-benchmark [-n <iterations>] <directory ...>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ftw.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "tree_sitter/api.h"
+
+#include "corpus.hh"
+
+extern "C" const TSLanguage *tree_sitter_latex();
+
+std::vector<std::string> cases;
+
+int collect(const char *path, const struct stat *, int type, struct FTW *) {
+  const char *extension = std::strrchr(path, '.');
+
+  if (type == FTW_F && extension && std::strcmp(extension, ".txtt") == 0) {
+    LaTeX::read_corpus_cases(path, cases);
+  }
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int iterations = 20;
+  int first = 1;
+
+  if (argc > 2 && std::strcmp(argv[1], "-n") == 0) {
+    iterations = std::max(1, std::atoi(argv[2]));
+    first = 3;
+  }
+
+  if (first >= argc) {
+    std::cerr << "Usage: corpus-benchmark [-n <iterations>] <directory ...>"
+              << std::endl;
+    return 1;
+  }
+
+  for (int i = first; i < argc; i++) {
+    nftw(argv[i], collect, 64, FTW_PHYS);
+  }
+
+  auto load_start = std::chrono::steady_clock::now();
+  TSParser *parser = ts_parser_new();
+  std::vector<double> durations;
+  size_t bytes = 0, errors = 0;
+
+  ts_parser_set_language(parser, tree_sitter_latex());
+
+  if (!cases.empty()) {
+    ts_tree_delete(ts_parser_parse_string(parser, nullptr, cases[0].data(),
+                                          cases[0].length()));
+  }
+
+  double load = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - load_start)
+                    .count();
+
+  for (const std::string &source : cases) {
+    bytes += source.length();
+  }
+
+  for (int i = 0; i < iterations; i++) {
+    auto start = std::chrono::steady_clock::now();
+
+    errors = 0;
+
+    for (const std::string &source : cases) {
+      TSTree *tree = ts_parser_parse_string(parser, nullptr, source.data(),
+                                            source.length());
+      errors += ts_node_has_error(ts_tree_root_node(tree));
+      ts_tree_delete(tree);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    durations.push_back(
+        std::chrono::duration<double, std::milli>(end - start).count());
+  }
+
+  ts_parser_delete(parser);
+  std::sort(durations.begin(), durations.end());
+
+  double average = 0;
+  for (double duration : durations) {
+    average += duration;
+  }
+  average /= iterations;
+
+  std::cerr << "Corpus:" << std::endl
+            << "Cases: " << cases.size() << " Bytes: " << bytes
+            << " With errors: " << errors << std::endl
+            << "Average: " << average << " Min: " << durations.front()
+            << " Max: " << durations.back() << std::endl
+            << "MB/s: " << bytes / average / 1000.0 << std::endl
+            << "Load: " << load << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,156 @@
+// Writes the syntax tree of a file in the binary export format or checks
+// that exporting and reading back the trees of a set of files, e.g. the
+// corpus, gives the same nodes as walking the trees directly. The examples
+// of a .txtt file are checked one at a time.
+//
+// Usage: export-tree <input> <output>
+//        export-tree --verify <file ...>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "corpus.hh"
+#include "export.hh"
+
+using namespace LaTeX;
+
+extern "C" const TSLanguage *tree_sitter_latex();
+
+std::string read_file(const char *path) {
+  std::ifstream file(path, std::ios::binary);
+  std::stringstream contents;
+  contents << file.rdbuf();
+
+  return contents.str();
+}
+
+// Compares the subtree below the cursor with the exported node and returns
+// the index just past it, or 0 on a mismatch.
+uint32_t compare(const ExportedTree &exported, uint32_t index,
+                 TSTreeCursor *cursor, std::string &message) {
+  TSNode node = ts_tree_cursor_current_node(cursor);
+
+  if (index >= exported.node_count() ||
+      std::strcmp(exported.type(index), ts_node_type(node)) != 0 ||
+      exported.start_byte(index) != ts_node_start_byte(node) ||
+      exported.end_byte(index) != ts_node_end_byte(node) ||
+      exported.child_count(index) != ts_node_child_count(node) ||
+      exported.is_named(index) != ts_node_is_named(node)) {
+    message = "node " + std::to_string(index) + " (" + ts_node_type(node) +
+              ") differs";
+    return 0;
+  }
+
+  uint32_t child = index + 1, count = 0;
+
+  if (ts_tree_cursor_goto_first_child(cursor)) {
+    do {
+      if (child >= exported.subtree_end(index)) {
+        message = "node " + std::to_string(index) + " has too few children";
+        return 0;
+      }
+
+      child = compare(exported, child, cursor, message);
+      count++;
+
+      if (!child) {
+        return 0;
+      }
+    } while (ts_tree_cursor_goto_next_sibling(cursor));
+
+    ts_tree_cursor_goto_parent(cursor);
+  }
+
+  if (child != exported.subtree_end(index) ||
+      count != exported.child_count(index)) {
+    message = "node " + std::to_string(index) + " has the wrong subtree end";
+    return 0;
+  }
+
+  return child;
+}
+
+bool verify(TSParser *parser, const std::string &source,
+            std::string &message) {
+  TSTree *tree = ts_parser_parse_string(parser, nullptr, source.data(),
+                                        source.length());
+  std::string output;
+
+  export_tree(output, tree);
+
+  ExportedTree exported(output.data(), output.size());
+  bool result = exported.valid();
+
+  if (result) {
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+    result = compare(exported, 0, &cursor, message) == exported.node_count();
+    ts_tree_cursor_delete(&cursor);
+  } else {
+    message = "the export is not valid";
+  }
+
+  ts_tree_delete(tree);
+
+  return result;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: export-tree <input> <output>" << std::endl
+              << "       export-tree --verify <file ...>" << std::endl;
+    return 1;
+  }
+
+  TSParser *parser = ts_parser_new();
+  ts_parser_set_language(parser, tree_sitter_latex());
+
+  if (std::strcmp(argv[1], "--verify") != 0) {
+    std::string source = read_file(argv[1]), output;
+    TSTree *tree = ts_parser_parse_string(parser, nullptr, source.data(),
+                                          source.length());
+
+    export_tree(output, tree);
+    std::ofstream(argv[2], std::ios::binary) << output;
+    ts_tree_delete(tree);
+    ts_parser_delete(parser);
+
+    return 0;
+  }
+
+  size_t count = 0, failures = 0;
+
+  for (int i = 2; i < argc; i++) {
+    std::string message;
+    std::vector<std::string> sources;
+    size_t length = std::strlen(argv[i]);
+
+    if (length > 5 && std::strcmp(argv[i] + length - 5, ".txtt") == 0) {
+      if (!read_corpus_cases(argv[i], sources)) {
+        std::cerr << "Unable to read " << argv[i] << std::endl;
+        failures++;
+      }
+    } else {
+      sources.push_back(read_file(argv[i]));
+    }
+
+    for (size_t j = 0; j < sources.size(); j++) {
+      count++;
+
+      if (!verify(parser, sources[j], message)) {
+        std::cerr << argv[i] << " example " << j + 1 << ": " << message
+                  << std::endl;
+        failures++;
+      }
+    }
+  }
+
+  ts_parser_delete(parser);
+  std::cerr << count - failures << " of " << count << " trees match"
+            << std::endl;
+
+  return failures ? 1 : 0;
+}
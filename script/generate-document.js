@@ -0,0 +1,280 @@
+#!/usr/bin/env node
+
+// Writes a synthetic LaTeX document of a given size for scaling benchmarks.
+// The document is built from constructs the corpus covers: sections, labels
+// and references, nested groups and environments, inline and display math,
+// tabulars, verbatim blocks, \makeatletter regions, short verb delimiters
+// and comments. The same seed and options always produce the same bytes.
+//
+// Options:
+//
+//   --seed <n>            Seed of the random generator, 1 by default.
+//   --size <MB>           Size of the document in megabytes, 1 by default.
+//   --depth <n>           How deep groups and environments nest, 3.
+//   --environments <p>    Chance that a block is an environment, 0.2.
+//   --math <p>            Chance that a phrase is math, 0.1. Half as many
+//                         blocks are display math.
+//   --verbatim <lines>    Lines in each verbatim block, 20. Zero leaves them
+//                         out.
+//   --makeatletter <p>    Chance that a block is a \makeatletter region,
+//                         0.01.
+//   --short-verb <p>      Chance that a block uses a short verb delimiter,
+//                         0.01.
+//   --comments <p>        Chance that a line ends in a comment, 0.05.
+//
+// Usage: script/generate-document.js [<options>] [<output>]
+
+const fs = require('fs')
+
+const DEFAULTS = {
+  seed: 1,
+  size: 1,
+  depth: 3,
+  environments: 0.2,
+  math: 0.1,
+  verbatim: 20,
+  makeatletter: 0.01,
+  shortVerb: 0.01,
+  comments: 0.05
+}
+
+const WORDS = [
+  'the', 'of', 'and', 'a', 'to', 'in', 'is', 'that', 'for', 'it', 'as',
+  'with', 'be', 'on', 'not', 'this', 'by', 'are', 'we', 'from', 'or',
+  'which', 'an', 'at', 'can', 'if', 'then', 'each', 'space', 'function',
+  'group', 'order', 'theorem', 'proof', 'result', 'value', 'section',
+  'equation', 'follows', 'bound', 'sequence', 'converges', 'limit',
+  'operator', 'matrix', 'vector', 'finite', 'integral', 'measure', 'set'
+]
+const SYMBOLS = ['x', 'y', 'z', 'n', 'k', '\\alpha', '\\beta', '\\lambda',
+  '\\epsilon', '\\pi']
+const OPERATORS = ['+', '-', '=', '<', '\\leq', '\\cdot', '\\times']
+const LISTS = ['itemize', 'enumerate']
+const FONTS = ['\\em', '\\bf', '\\it', '\\sc']
+const CODE = ['int main(void) {', '  return 0;', '}', 'for (i = 0; i < n; i++)',
+  '  x[i] = y[i] * 2;', 'if (x == NULL) return;', '#include <stdio.h>']
+const SHORT_VERB_DELIMITERS = ['|', '+', '!']
+
+// mulberry32, which is small and good enough for choosing constructs.
+function random (seed) {
+  let state = seed >>> 0
+
+  return () => {
+    state = (state + 0x6d2b79f5) >>> 0
+    let t = state
+    t = Math.imul(t ^ (t >>> 15), t | 1)
+    t ^= t + Math.imul(t ^ (t >>> 7), t | 61)
+    return ((t ^ (t >>> 14)) >>> 0) / 4294967296
+  }
+}
+
+// Writes the document to fd in chunks, so that documents of hundreds of
+// megabytes do not have to fit in a string.
+function generate (fd, options) {
+  options = Object.assign({}, DEFAULTS, options)
+
+  const next = random(options.seed)
+  const size = Math.floor(options.size * 1e6)
+  const chunks = []
+  let buffered = 0
+  let written = 0
+  let labels = 0
+  let sections = 0
+
+  const chance = p => next() < p
+  const pick = list => list[Math.floor(next() * list.length)]
+  const integer = (min, max) => min + Math.floor(next() * (max - min + 1))
+
+  function emit (text) {
+    chunks.push(text)
+    buffered += text.length
+
+    if (buffered >= 1 << 20) flush()
+  }
+
+  function flush () {
+    const chunk = Buffer.from(chunks.join(''))
+
+    fs.writeSync(fd, chunk)
+    written += chunk.length
+    chunks.length = 0
+    buffered = 0
+  }
+
+  function endLine () {
+    if (chance(options.comments)) {
+      emit(' % ' + words(integer(2, 8)))
+    }
+
+    emit('\n')
+  }
+
+  function words (count) {
+    const result = []
+
+    for (let i = 0; i < count; i++) result.push(pick(WORDS))
+
+    return result.join(' ')
+  }
+
+  function formula () {
+    const terms = [pick(SYMBOLS)]
+
+    for (let i = integer(1, 4); i > 0; i--) {
+      let term = pick(SYMBOLS)
+
+      if (chance(0.3)) term += '_{' + pick(SYMBOLS) + '}'
+      if (chance(0.3)) term += '^{' + integer(2, 9) + '}'
+      if (chance(0.1)) term = '\\frac{' + term + '}{' + pick(SYMBOLS) + '}'
+
+      terms.push(pick(OPERATORS), term)
+    }
+
+    return terms.join(' ')
+  }
+
+  function phrase (depth) {
+    if (chance(options.math)) return '$' + formula() + '$'
+    if (depth < options.depth && chance(0.1)) {
+      return '{' + pick(FONTS) + ' ' + sentence(depth + 1) + '}'
+    }
+    if (labels > 0 && chance(0.03)) return '\\ref{l' + integer(1, labels) + '}'
+    if (chance(0.02)) return '\\cite{key' + integer(1, 500) + '}'
+
+    return words(integer(1, 6))
+  }
+
+  function sentence (depth) {
+    const phrases = []
+
+    for (let i = integer(1, 4); i > 0; i--) phrases.push(phrase(depth))
+
+    return phrases.join(' ')
+  }
+
+  function paragraph (depth) {
+    for (let i = integer(1, 5); i > 0; i--) {
+      emit(sentence(depth) + '.')
+      endLine()
+    }
+  }
+
+  function environment (depth) {
+    const kind = integer(0, 3)
+
+    if (kind === 0) {
+      const name = pick(LISTS)
+
+      emit('\\begin{' + name + '}\n')
+      for (let i = integer(1, 5); i > 0; i--) {
+        emit('\\item ')
+        block(depth + 1)
+      }
+      emit('\\end{' + name + '}\n')
+    } else if (kind === 1) {
+      emit('\\begin{equation}\n' + formula() + '\n')
+      emit('\\label{l' + ++labels + '}\n\\end{equation}\n')
+    } else if (kind === 2) {
+      emit('\\begin{tabular}{l|c|r}\n')
+      for (let i = integer(1, 6); i > 0; i--) {
+        emit([phrase(depth), phrase(depth), phrase(depth)].join(' & ') +
+          ' \\\\\n')
+      }
+      emit('\\end{tabular}\n')
+    } else {
+      emit('\\begin{theorem}\n')
+      block(depth + 1)
+      emit('\\end{theorem}\n')
+    }
+  }
+
+  function verbatim () {
+    emit('\\begin{verbatim}\n')
+    for (let i = 0; i < options.verbatim; i++) emit(pick(CODE) + '\n')
+    emit('\\end{verbatim}\n')
+  }
+
+  function makeatletter () {
+    emit('\\makeatletter\n')
+    for (let i = integer(1, 4); i > 0; i--) {
+      emit('\\def\\latex@' + pick(WORDS) + '{\\@ifstar{\\@' + pick(WORDS) +
+        '}{' + words(2) + '}}\n')
+    }
+    emit('\\makeatother\n')
+  }
+
+  function shortVerb () {
+    const delimiter = pick(SHORT_VERB_DELIMITERS)
+    const code = CODE.filter(line => !line.includes(delimiter))
+
+    emit('\\MakeShortVerb{\\' + delimiter + '}\n')
+    for (let i = integer(1, 3); i > 0; i--) {
+      emit(words(integer(1, 5)) + ' ' + delimiter + pick(code).trim() +
+        delimiter + ' ' + words(integer(1, 5)) + '.')
+      endLine()
+    }
+    emit('\\DeleteShortVerb{\\' + delimiter + '}\n')
+  }
+
+  function block (depth) {
+    if (depth < options.depth && chance(options.environments)) {
+      environment(depth)
+    } else if (chance(options.math / 2)) {
+      emit('\\[\n' + formula() + '\n\\]\n')
+    } else if (options.verbatim > 0 && chance(0.02)) {
+      verbatim()
+    } else if (chance(options.makeatletter)) {
+      makeatletter()
+    } else if (chance(options.shortVerb)) {
+      shortVerb()
+    } else {
+      paragraph(depth)
+    }
+
+    emit('\n')
+  }
+
+  emit('\\documentclass{article}\n\\usepackage{amsmath}\n' +
+    '\\usepackage{shortvrb}\n\\newtheorem{theorem}{Theorem}\n' +
+    '\\begin{document}\n\n')
+
+  while (written + buffered < size) {
+    emit('\\section{' + words(integer(1, 4)) + '}\n')
+    emit('\\label{s' + ++sections + '}\n\n')
+
+    for (let i = integer(3, 12); i > 0 && written + buffered < size; i--) {
+      block(0)
+    }
+  }
+
+  emit('\\end{document}\n')
+  flush()
+
+  return written
+}
+
+module.exports = generate
+
+if (require.main === module) {
+  const args = process.argv.slice(2)
+  const options = {}
+
+  while (args.length > 1 && args[0].startsWith('--')) {
+    const name = args.shift().slice(2)
+    options[name.replace(/-(.)/g, (m, c) => c.toUpperCase())] = parseFloat(args.shift())
+  }
+
+  if (args.length > 1 || args.some(arg => arg.startsWith('--')) ||
+      Object.keys(options).some(name => !(name in DEFAULTS) || isNaN(options[name]))) {
+    console.warn('Usage: script/generate-document.js [--seed <n>] [--size <MB>] [--depth <n>]')
+    console.warn('         [--environments <p>] [--math <p>] [--verbatim <lines>]')
+    console.warn('         [--makeatletter <p>] [--short-verb <p>] [--comments <p>] [<output>]')
+    process.exit(1)
+  }
+
+  const fd = args.length ? fs.openSync(args[0], 'w') : 1
+
+  generate(fd, options)
+
+  if (args.length) fs.closeSync(fd)
+}
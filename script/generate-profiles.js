@@ -0,0 +1,113 @@
+#!/usr/bin/env node
+
+// Generates a parser for each grammar profile into src/profiles/<profile> and
+// reports the size of the resulting parse tables. The full profile is
+// generated last so that src/parser.c is left as the default grammar.
+//
+// If CMake is found each profile is then built in
+// build/grammar-profiles/<profile>, see LATEX_PROFILE in CMakeLists.txt, and
+// the size of the shared library is reported. With a tree-sitter runtime the
+// load time and the throughput of corpus-benchmark are reported too. They
+// are measured on the initex and latex/base corpus, which every profile
+// covers.
+
+const childProcess = require('child_process')
+const fs = require('fs')
+const path = require('path')
+
+const profiles = [
+  { name: 'core', directory: 'core' },
+  { name: 'core+ams', directory: 'core-ams' },
+  { name: 'full', directory: 'full' }
+]
+
+const root = path.join(__dirname, '..')
+const buildRoot = path.join(root, 'build', 'grammar-profiles')
+const benchmarkInputs = [
+  path.join(root, 'corpus', 'initex.txtt'),
+  path.join(root, 'corpus', 'latex', 'base')
+]
+
+function define (source, name) {
+  const match = source.match(new RegExp(`#define ${name} (\\d+)`))
+  return match ? parseInt(match[1]) : 0
+}
+
+function run (command, args) {
+  const result = childProcess.spawnSync(command, args, { encoding: 'utf8' })
+
+  if (result.status !== 0) {
+    console.warn(result.stdout + result.stderr)
+    console.warn(command + ' ' + args.join(' ') + ' failed')
+    process.exit(1)
+  }
+
+  return result.stderr
+}
+
+for (const profile of profiles) {
+  console.warn(`Generating ${profile.name} profile...`)
+
+  childProcess.execSync('tree-sitter generate', {
+    cwd: root,
+    env: Object.assign({}, process.env, { TREE_SITTER_LATEX_PROFILE: profile.name }),
+    stdio: 'inherit'
+  })
+
+  const directory = path.join(root, 'src', 'profiles', profile.directory)
+  const source = fs.readFileSync(path.join(root, 'src', 'parser.c'), 'utf8')
+
+  fs.mkdirSync(directory, { recursive: true })
+  fs.writeFileSync(path.join(directory, 'parser.c'), source)
+
+  profile.states = define(source, 'STATE_COUNT')
+  profile.symbols = define(source, 'SYMBOL_COUNT')
+  // Parsers from the 0.13 CLI have one uint16_t entry per state and symbol.
+  profile.tableBytes = profile.states * profile.symbols * 2
+  profile.sourceBytes = source.length
+}
+
+const cmake = childProcess.spawnSync('cmake', ['--version']).status === 0
+
+if (!cmake) {
+  console.warn('CMake was not found, the profiles are not built.')
+}
+
+for (const profile of cmake ? profiles : []) {
+  const directory = path.join(buildRoot, profile.directory)
+
+  console.warn(`Building ${profile.name} profile...`)
+  run('cmake', ['-S', root, '-B', directory, '-DCMAKE_BUILD_TYPE=Release',
+    '-DLATEX_PROFILE=' + profile.directory])
+  run('cmake', ['--build', directory])
+
+  const library = fs.readdirSync(directory).find(name => /^libtree-sitter-latex\.(so|dylib)$/.test(name))
+  const corpusBenchmark = path.join(directory, 'corpus-benchmark')
+
+  if (library) profile.libraryBytes = fs.statSync(path.join(directory, library)).size
+
+  if (fs.existsSync(corpusBenchmark)) {
+    const output = run(corpusBenchmark, ['-n', '10'].concat(benchmarkInputs))
+
+    profile.throughput = parseFloat(/MB\/s: ([0-9.]+)/.exec(output)[1])
+    profile.load = parseFloat(/Load: ([0-9.e+-]+)/.exec(output)[1])
+  }
+}
+
+const column = (value, digits) => (value === undefined ? '-' : value.toFixed(digits)).padStart(12)
+
+console.log('profile'.padEnd(10) + 'states'.padStart(8) + 'symbols'.padStart(9) +
+  'table KB'.padStart(12) + 'parser.c KB'.padStart(12) + 'library KB'.padStart(12) +
+  'load ms'.padStart(12) + 'MB/s'.padStart(12))
+
+for (const profile of profiles) {
+  console.log(profile.name.padEnd(10) + String(profile.states).padStart(8) +
+    String(profile.symbols).padStart(9) + column(profile.tableBytes / 1024, 0) +
+    column(profile.sourceBytes / 1024, 0) +
+    column(profile.libraryBytes && profile.libraryBytes / 1024, 0) +
+    column(profile.load, 2) + column(profile.throughput, 2))
+}
+
+if (cmake && profiles.some(profile => profile.throughput === undefined)) {
+  console.warn('No tree-sitter runtime was found, see TREE_SITTER_DIR in CMakeLists.txt.')
+}
@@ -0,0 +1,139 @@
+// Measures how long keeping the structural index of a document current takes
+// per edit with a LaTeX::IncrementalIndex, compared to extracting the
+// records of the whole tree again, e.g. on a 2 MB document written by
+// script/generate-document.js. The edits are seeded random insertions and
+// deletions of a few bytes as made while typing. The incremental reparse
+// that precedes each update is reported as well.
+//
+// Usage: index-benchmark [-n <edits>] <file>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "histogram.hh"
+#include "index.hh"
+
+using namespace LaTeX;
+
+extern "C" const TSLanguage *tree_sitter_latex();
+
+const char *const TYPED[] = {"x", " ", "\n", "{", "}", "\\", "\\label{x}",
+                             "\\section{Typed}\n"};
+
+TSPoint point_at(const std::string &source, uint32_t offset) {
+  TSPoint point = {0, 0};
+
+  for (uint32_t i = 0; i < offset; i++) {
+    if (source[i] == '\n') {
+      point.row++;
+      point.column = 0;
+    } else {
+      point.column++;
+    }
+  }
+
+  return point;
+}
+
+uint64_t elapsed_micros(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+void print(const char *name, const LatencyHistogram &histogram) {
+  std::cerr << name << ": p50 " << histogram.percentile(0.5) << " us, p90 "
+            << histogram.percentile(0.9) << " us, p99 "
+            << histogram.percentile(0.99) << " us, max " << histogram.max()
+            << " us" << std::endl;
+}
+
+int main(int argc, char **argv) {
+  unsigned edits = 500;
+  int first = 1;
+
+  if (argc > 2 && std::strcmp(argv[1], "-n") == 0) {
+    edits = std::atoi(argv[2]);
+    first = 3;
+  }
+
+  if (first + 1 != argc) {
+    std::cerr << "Usage: index-benchmark [-n <edits>] <file>" << std::endl;
+    return 1;
+  }
+
+  std::ifstream file(argv[first], std::ios::binary);
+  std::stringstream contents;
+  contents << file.rdbuf();
+
+  std::string source = contents.str();
+  const TSLanguage *language = tree_sitter_latex();
+  TSParser *parser = ts_parser_new();
+  IncrementalIndex index(language);
+  Indexer indexer(language);
+  std::vector<IndexEntry> entries;
+  LatencyHistogram parse, incremental, full;
+  std::mt19937 random(1);
+
+  ts_parser_set_language(parser, language);
+
+  TSTree *tree =
+      ts_parser_parse_string(parser, nullptr, source.data(), source.size());
+
+  index.reset(tree, source.data(), source.size());
+
+  for (unsigned i = 0; i < edits; i++) {
+    uint32_t start = random() % (source.size() + 1);
+    uint32_t removed = (random() % 4 == 0 && start < source.size()) ? 1 : 0;
+    std::string text = removed ? "" : TYPED[random() % 8];
+    TSInputEdit edit;
+
+    edit.start_byte = start;
+    edit.old_end_byte = start + removed;
+    edit.new_end_byte = start + text.size();
+    edit.start_point = point_at(source, start);
+    edit.old_end_point = point_at(source, start + removed);
+    source.replace(start, removed, text);
+    edit.new_end_point = point_at(source, start + text.size());
+
+    ts_tree_edit(tree, &edit);
+
+    auto parse_start = std::chrono::steady_clock::now();
+    TSTree *new_tree =
+        ts_parser_parse_string(parser, tree, source.data(), source.size());
+
+    parse.add(elapsed_micros(parse_start));
+
+    auto update_start = std::chrono::steady_clock::now();
+
+    index.update(tree, new_tree, edit, source.data());
+    incremental.add(elapsed_micros(update_start));
+
+    auto extract_start = std::chrono::steady_clock::now();
+
+    entries.clear();
+    indexer.extract(entries, ts_tree_root_node(new_tree), source.data());
+    full.add(elapsed_micros(extract_start));
+
+    ts_tree_delete(tree);
+    tree = new_tree;
+  }
+
+  ts_tree_delete(tree);
+  ts_parser_delete(parser);
+
+  std::cerr << "Bytes: " << source.size() << " Records: " << index.size()
+            << " Edits: " << edits << std::endl;
+  print("Reparse", parse);
+  print("Incremental index", incremental);
+  print("Full index", full);
+
+  return 0;
+}
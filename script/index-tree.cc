@@ -0,0 +1,120 @@
+// Builds the structural index of every LaTeX file below a set of directories
+// as the nightly batch job does. Parse results are kept in a ParseCache so
+// that files that have not changed since the last run are not parsed again.
+//
+// Usage: index-tree [-c <cache>] <directory ...>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <ftw.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cache.hh"
+#include "index.hh"
+
+using namespace LaTeX;
+
+extern "C" const TSLanguage *tree_sitter_latex();
+
+const char *const EXTENSIONS[] = {".cls", ".dtx", ".ltx", ".sty", ".tex"};
+
+std::vector<std::string> paths;
+
+int collect(const char *path, const struct stat *, int type, struct FTW *) {
+  if (type != FTW_F) {
+    return 0;
+  }
+
+  const char *extension = std::strrchr(path, '.');
+
+  for (const char *e : EXTENSIONS) {
+    if (extension && std::strcmp(extension, e) == 0) {
+      paths.push_back(path);
+      break;
+    }
+  }
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  std::string cache_path = "index-tree.cache";
+  int first = 1;
+
+  if (argc > 2 && std::strcmp(argv[1], "-c") == 0) {
+    cache_path = argv[2];
+    first = 3;
+  }
+
+  if (first >= argc) {
+    std::cerr << "Usage: index-tree [-c <cache>] <directory ...>" << std::endl;
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = first; i < argc; i++) {
+    nftw(argv[i], collect, 64, FTW_PHYS);
+  }
+
+  const TSLanguage *language = tree_sitter_latex();
+  ParseCache cache(cache_path, ParseCache::stamp(language));
+  Indexer indexer(language);
+  TSParser *parser = ts_parser_new();
+  std::vector<IndexEntry> entries;
+  size_t bytes = 0, records = 0, errors = 0;
+
+  ts_parser_set_language(parser, language);
+
+  if (!cache.valid()) {
+    std::cerr << "Unable to open cache " << cache_path << std::endl;
+  }
+
+  for (const std::string &path : paths) {
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+
+    std::string source = contents.str();
+    bool has_error = false;
+
+    entries.clear();
+
+    if (!cache.lookup(source.data(), source.length(), entries, has_error)) {
+      TSTree *tree = ts_parser_parse_string(parser, nullptr, source.data(),
+                                            source.length());
+      TSNode root = ts_tree_root_node(tree);
+
+      indexer.extract(entries, root, source.data());
+      has_error = ts_node_has_error(root);
+      cache.store(source.data(), source.length(), entries, has_error);
+      ts_tree_delete(tree);
+    }
+
+    bytes += source.length();
+    records += entries.size();
+    errors += has_error;
+  }
+
+  ts_parser_delete(parser);
+
+  double duration = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  uint64_t lookups = cache.hits() + cache.misses();
+
+  std::cerr << "Files: " << paths.size() << " Bytes: " << bytes
+            << " Records: " << records << " With errors: " << errors
+            << std::endl
+            << "Hits: " << cache.hits() << " Misses: " << cache.misses()
+            << " Hit rate: "
+            << (lookups ? 100.0 * cache.hits() / lookups : 0.0) << "%"
+            << std::endl
+            << "Time: " << duration << " ms" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,366 @@
+// Reports how much memory the trees of a set of inputs take: the number of
+// nodes and the histogram of their types, the bytes of the scanner states
+// the parser serializes and the bytes the runtime allocates. Allocations are
+// counted by replacing malloc and its relatives with wrappers around those of
+// glibc, so they are not counted with other C libraries. While parsing the
+// only allocations are those of the runtime and the scanner. Each external
+// token the parser scans
+// is serialized, including those it discards, so the serialized states are
+// an upper bound on those the trees keep. Each argument is a file or a
+// directory that is searched for LaTeX and corpus files, and is reported as
+// a whole. Every test case in a corpus file is parsed as a document.
+// With -c runs of comment lines are merged into comment_lines tokens, so
+// that the two reports show what the merging saves.
+//
+// Usage: memory-report [-c] [-t <types>] <file|directory ...>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <ftw.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <atomic>
+#include <malloc.h>
+#endif
+
+#include "tree_sitter/api.h"
+
+#include "corpus.hh"
+
+extern "C" const TSLanguage *tree_sitter_latex();
+extern "C" void tree_sitter_latex_record_serialized_lengths(bool enabled);
+extern "C" const uint64_t *
+tree_sitter_latex_serialized_lengths(unsigned *count);
+extern "C" void tree_sitter_latex_set_merge_comments(bool enabled);
+
+const char *const EXTENSIONS[] = {".cls", ".dtx", ".ltx", ".sty", ".tex"};
+
+// Tree-sitter keeps a scanner state of up to this many bytes in the token
+// itself and allocates longer ones separately.
+const unsigned INLINE_STATE_LENGTH = 24;
+
+struct Report {
+  size_t inputs = 0, bytes = 0, nodes = 0, tree_bytes = 0;
+  size_t serializations = 0, serialized_bytes = 0, long_serializations = 0,
+         long_serialized_bytes = 0;
+  unsigned longest_serialized = 0;
+  // The most the runtime had allocated during a parse, beyond what it held
+  // before, and the size of that input.
+  size_t peak = 0, peak_input = 0;
+  std::vector<size_t> types;
+};
+
+std::vector<std::string> inputs;
+
+#ifdef __GLIBC__
+
+const bool COUNTING_ALLOCATIONS = true;
+
+std::atomic<size_t> allocated(0), peak(0);
+
+void track(void *pointer) {
+  if (!pointer) {
+    return;
+  }
+
+  size_t size = malloc_usable_size(pointer);
+  size_t now = allocated.fetch_add(size) + size;
+  size_t highest = peak.load();
+
+  // A failed exchange reloads the highest value seen.
+  while (now > highest && !peak.compare_exchange_weak(highest, now)) {
+  }
+}
+
+void untrack(void *pointer) {
+  if (pointer) {
+    allocated -= malloc_usable_size(pointer);
+  }
+}
+
+// The allocation functions of glibc that the wrappers below call. Every
+// function that returns a block free accepts is wrapped, so that the count
+// stays balanced.
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *pointer);
+
+void *malloc(size_t size) {
+  void *pointer = __libc_malloc(size);
+  track(pointer);
+  return pointer;
+}
+
+void *calloc(size_t count, size_t size) {
+  void *pointer = __libc_calloc(count, size);
+  track(pointer);
+  return pointer;
+}
+
+void *realloc(void *pointer, size_t size) {
+  size_t old_size = pointer ? malloc_usable_size(pointer) : 0;
+  void *moved = __libc_realloc(pointer, size);
+
+  // A failed realloc keeps the old block, except for a size of zero, which
+  // frees it.
+  if (moved || size == 0) {
+    allocated -= old_size;
+    track(moved);
+  }
+
+  return moved;
+}
+
+void *memalign(size_t alignment, size_t size) {
+  void *pointer = __libc_memalign(alignment, size);
+  track(pointer);
+  return pointer;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+  return memalign(alignment, size);
+}
+
+int posix_memalign(void **result, size_t alignment, size_t size) {
+  if (alignment % sizeof(void *) != 0 ||
+      (alignment & (alignment - 1)) != 0) {
+    return EINVAL;
+  }
+
+  void *pointer = memalign(alignment, size);
+
+  if (!pointer) {
+    return ENOMEM;
+  }
+
+  *result = pointer;
+  return 0;
+}
+
+void free(void *pointer) {
+  untrack(pointer);
+  __libc_free(pointer);
+}
+
+} // extern "C"
+
+#else
+
+const bool COUNTING_ALLOCATIONS = false;
+
+size_t allocated = 0, peak = 0;
+
+#endif
+
+void add_file(const char *path) {
+  const char *extension = std::strrchr(path, '.');
+
+  if (!extension) {
+    return;
+  }
+
+  if (std::strcmp(extension, ".txtt") == 0) {
+    LaTeX::read_corpus_cases(path, inputs);
+    return;
+  }
+
+  for (const char *e : EXTENSIONS) {
+    if (std::strcmp(extension, e) == 0) {
+      std::ifstream file(path, std::ios::binary);
+      std::stringstream contents;
+      contents << file.rdbuf();
+      inputs.push_back(contents.str());
+      break;
+    }
+  }
+}
+
+int collect(const char *path, const struct stat *, int type, struct FTW *) {
+  if (type == FTW_F) {
+    add_file(path);
+  }
+
+  return 0;
+}
+
+void count_nodes(TSTree *tree, Report &report) {
+  TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+
+  for (;;) {
+    report.types[ts_node_symbol(ts_tree_cursor_current_node(&cursor))]++;
+    report.nodes++;
+
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+      continue;
+    }
+
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        ts_tree_cursor_delete(&cursor);
+        return;
+      }
+    }
+  }
+}
+
+void count_serializations(Report &report) {
+  unsigned count;
+  const uint64_t *lengths = tree_sitter_latex_serialized_lengths(&count);
+
+  for (unsigned length = 0; length < count; length++) {
+    report.serializations += lengths[length];
+    report.serialized_bytes += lengths[length] * length;
+
+    if (length > INLINE_STATE_LENGTH) {
+      report.long_serializations += lengths[length];
+      report.long_serialized_bytes += lengths[length] * length;
+    }
+
+    if (lengths[length] > 0) {
+      report.longest_serialized = length;
+    }
+  }
+}
+
+void parse(TSParser *parser, const std::string &source, Report &report) {
+  size_t before = allocated;
+
+  peak = before;
+  tree_sitter_latex_record_serialized_lengths(true);
+
+  TSTree *tree = ts_parser_parse_string(parser, nullptr, source.data(),
+                                        source.length());
+
+  count_serializations(report);
+  tree_sitter_latex_record_serialized_lengths(false);
+
+  if (peak - before > report.peak) {
+    report.peak = peak - before;
+    report.peak_input = source.length();
+  }
+
+  count_nodes(tree, report);
+
+  // Only the tree is freed between the two counts.
+  size_t with_tree = allocated;
+
+  ts_tree_delete(tree);
+
+  report.inputs++;
+  report.bytes += source.length();
+  report.tree_bytes += with_tree - allocated;
+}
+
+double per(double value, double total) { return total ? value / total : 0; }
+
+void print(const char *name, const Report &report, unsigned type_count) {
+  const TSLanguage *language = tree_sitter_latex();
+  std::vector<TSSymbol> symbols;
+
+  for (TSSymbol symbol = 0; symbol < report.types.size(); symbol++) {
+    if (report.types[symbol] > 0) {
+      symbols.push_back(symbol);
+    }
+  }
+
+  std::sort(symbols.begin(), symbols.end(), [&](TSSymbol a, TSSymbol b) {
+    return report.types[a] > report.types[b];
+  });
+
+  std::cout << std::fixed << std::setprecision(2) << name << std::endl
+            << "  Inputs: " << report.inputs << " Bytes: " << report.bytes
+            << std::endl
+            << "  Nodes: " << report.nodes << " ("
+            << per(report.nodes * 1024.0, report.bytes) << " per KB)"
+            << std::endl
+            << "  Tree: " << report.tree_bytes << " bytes ("
+            << per(report.tree_bytes, report.bytes) << " per input byte, "
+            << per(report.tree_bytes, report.nodes) << " per node)"
+            << std::endl
+            << "  Serialized scanner states: " << report.serializations
+            << " calls, " << report.serialized_bytes << " bytes ("
+            << per(report.serialized_bytes, report.bytes)
+            << " per input byte), longest " << report.longest_serialized
+            << std::endl
+            << "    Longer than " << INLINE_STATE_LENGTH
+            << " bytes and allocated: " << report.long_serializations
+            << " calls, " << report.long_serialized_bytes << " bytes"
+            << std::endl
+            << "  Peak allocated: " << report.peak
+            << " bytes while parsing " << report.peak_input << " bytes ("
+            << per(report.peak, report.peak_input) << " per input byte)"
+            << std::endl
+            << "  Node types:" << std::endl;
+
+  for (size_t i = 0; i < symbols.size() && i < type_count; i++) {
+    TSSymbol symbol = symbols[i];
+
+    std::cout << "    " << std::left << std::setw(28)
+              << ts_language_symbol_name(language, symbol) << std::right
+              << std::setw(10) << report.types[symbol] << std::setw(8)
+              << per(100.0 * report.types[symbol], report.nodes) << "%"
+              << std::endl;
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned type_count = 20;
+  int first = 1;
+
+  if (first < argc && std::strcmp(argv[first], "-c") == 0) {
+    tree_sitter_latex_set_merge_comments(true);
+    first++;
+  }
+
+  if (first + 1 < argc && std::strcmp(argv[first], "-t") == 0) {
+    type_count = std::atoi(argv[first + 1]);
+    first += 2;
+  }
+
+  if (first >= argc) {
+    std::cerr << "Usage: memory-report [-c] [-t <types>] <file|directory ...>"
+              << std::endl;
+    return 1;
+  }
+
+  if (!COUNTING_ALLOCATIONS) {
+    std::cerr << "Allocations are only counted with glibc, so the tree and "
+                 "peak sizes are zero"
+              << std::endl;
+  }
+
+  const TSLanguage *language = tree_sitter_latex();
+  TSParser *parser = ts_parser_new();
+
+  ts_parser_set_language(parser, language);
+
+  for (int i = first; i < argc; i++) {
+    Report report;
+
+    report.types.resize(ts_language_symbol_count(language));
+    inputs.clear();
+    nftw(argv[i], collect, 64, FTW_PHYS);
+
+    for (const std::string &source : inputs) {
+      parse(parser, source, report);
+    }
+
+    print(argv[i], report, type_count);
+  }
+
+  ts_parser_delete(parser);
+
+  return 0;
+}
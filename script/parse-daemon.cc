@@ -0,0 +1,110 @@
+// Keeps LaTeX documents parsed between edits for editor integrations, see
+// LaTeX::ParseDaemon in src/daemon.hh for the protocol. Requests are read
+// from stdin unless a socket is given, in which case each connection is
+// served on its own thread and documents are shared between connections.
+// With -t a parse that takes longer than the given number of milliseconds
+// is abandoned. With -c the trees of opened documents are cached, up to an
+// estimated size of the given number of megabytes.
+//
+// Usage: parse-daemon [-t <milliseconds>] [-c <megabytes>] [-s <socket>]
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+#include "daemon.hh"
+
+using namespace LaTeX;
+
+extern "C" const TSLanguage *tree_sitter_latex();
+
+int listen_on(const char *path) {
+  struct sockaddr_un address;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (fd < 0 || std::strlen(path) >= sizeof(address.sun_path)) {
+    return -1;
+  }
+
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, path);
+  unlink(path);
+
+  if (bind(fd, reinterpret_cast<struct sockaddr *>(&address),
+           sizeof(address)) < 0 ||
+      listen(fd, 16) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+int main(int argc, char **argv) {
+  const char *socket_path = nullptr;
+  uint64_t budget_micros = 0;
+  size_t cache_bytes = 0;
+  int i = 1;
+
+  for (; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "-s") == 0) {
+      socket_path = argv[i + 1];
+    } else if (std::strcmp(argv[i], "-t") == 0) {
+      budget_micros = std::strtoull(argv[i + 1], nullptr, 10) * 1000;
+    } else if (std::strcmp(argv[i], "-c") == 0) {
+      cache_bytes = std::strtoull(argv[i + 1], nullptr, 10) << 20;
+    } else {
+      break;
+    }
+  }
+
+  if (i != argc) {
+    std::cerr << "Usage: parse-daemon [-t <milliseconds>] [-c <megabytes>] "
+                 "[-s <socket>]"
+              << std::endl;
+    return 1;
+  }
+
+  ParseDaemon daemon(tree_sitter_latex(), budget_micros, cache_bytes);
+
+  if (!socket_path) {
+    return daemon.serve(STDIN_FILENO, STDOUT_FILENO) ? 0 : 1;
+  }
+
+  // A client that goes away while a reply is written must not end the
+  // daemon.
+  std::signal(SIGPIPE, SIG_IGN);
+
+  int server = listen_on(socket_path);
+
+  if (server < 0) {
+    std::cerr << "Unable to listen on " << socket_path << std::endl;
+    return 1;
+  }
+
+  for (;;) {
+    int client = accept(server, nullptr, nullptr);
+
+    if (client < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+
+      std::cerr << "Unable to accept connections on " << socket_path
+                << std::endl;
+      return 1;
+    }
+
+    std::thread([&daemon, client]() {
+      daemon.serve(client, client);
+      close(client);
+    }).detach();
+  }
+}
@@ -0,0 +1,59 @@
+// Parses a file once and reports the time it took and the peak memory of the
+// process, which script/scaling-benchmark.js plots against the size of
+// generated documents.
+//
+// Usage: parse-file <file>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+
+#include "tree_sitter/api.h"
+
+extern "C" const TSLanguage *tree_sitter_latex();
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: parse-file <file>" << std::endl;
+    return 1;
+  }
+
+  std::string source;
+
+  {
+    std::ifstream file(argv[1], std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    source = contents.str();
+  }
+
+  TSParser *parser = ts_parser_new();
+
+  ts_parser_set_language(parser, tree_sitter_latex());
+
+  auto start = std::chrono::steady_clock::now();
+  TSTree *tree = ts_parser_parse_string(parser, nullptr, source.data(),
+                                        source.length());
+  double duration = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  bool has_error = ts_node_has_error(ts_tree_root_node(tree));
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  ts_tree_delete(tree);
+  ts_parser_delete(parser);
+
+  std::cerr << "Parse:" << std::endl
+            << "Bytes: " << source.length()
+            << " With errors: " << (has_error ? "yes" : "no") << std::endl
+            << "Time: " << duration << std::endl
+            << "MB/s: " << source.length() / duration / 1000.0 << std::endl
+            << "Peak RSS: " << usage.ru_maxrss << " KB" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,111 @@
+// Measures requests per second when every request parses a file with a new
+// parser and when it checks one out of a LaTeX::ParserPool, at 1 to 64
+// threads. Each configuration runs for a fixed time.
+//
+// Usage: parser-pool-benchmark <file> [<milliseconds>]
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "parser_pool.hh"
+
+using namespace LaTeX;
+
+extern "C" const TSLanguage *tree_sitter_latex();
+
+const unsigned THREAD_COUNTS[] = {1, 2, 4, 8, 16, 32, 64};
+
+template <typename Request>
+double run(unsigned thread_count, int milliseconds, Request request) {
+  std::atomic<bool> stop(false);
+  std::atomic<uint64_t> total(0);
+  std::vector<std::thread> threads;
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (unsigned i = 0; i < thread_count; i++) {
+    threads.emplace_back([&]() {
+      uint64_t count = 0;
+
+      while (!stop.load(std::memory_order_relaxed)) {
+        request();
+        count++;
+      }
+
+      total += count;
+    });
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+  stop = true;
+
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
+
+  return total / seconds.count();
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 3) {
+    std::cerr << "Usage: parser-pool-benchmark <file> [<milliseconds>]"
+              << std::endl;
+    return 1;
+  }
+
+  std::ifstream file(argv[1], std::ios::binary);
+  std::stringstream contents;
+  contents << file.rdbuf();
+
+  const std::string source = contents.str();
+  const TSLanguage *language = tree_sitter_latex();
+  int milliseconds = (argc == 3) ? std::atoi(argv[2]) : 1000;
+
+  auto parse = [&](TSParser *parser) {
+    TSTree *tree = ts_parser_parse_string(parser, nullptr, source.data(),
+                                          source.length());
+    ts_tree_delete(tree);
+  };
+
+  std::cout << std::setw(7) << "threads" << std::setw(14) << "new/s"
+            << std::setw(14) << "pooled/s" << std::setw(8) << "speedup"
+            << std::setw(10) << "misses" << std::setw(12) << "p50 ns"
+            << std::setw(12) << "p99 ns" << std::endl;
+
+  for (unsigned thread_count : THREAD_COUNTS) {
+    double fresh = run(thread_count, milliseconds, [&]() {
+      TSParser *parser = ts_parser_new();
+      ts_parser_set_language(parser, language);
+      parse(parser);
+      ts_parser_delete(parser);
+    });
+
+    ParserPool pool(language, thread_count, thread_count);
+    double pooled = run(thread_count, milliseconds, [&]() {
+      PooledParser parser = pool.checkout();
+      parse(parser);
+    });
+    ParserPoolStats stats = pool.stats();
+
+    std::cout << std::fixed << std::setprecision(0) << std::setw(7)
+              << thread_count << std::setw(14) << fresh << std::setw(14)
+              << pooled << std::setprecision(2) << std::setw(8)
+              << pooled / fresh << std::setw(10) << stats.misses
+              << std::setw(12) << stats.checkout_nanos.percentile(0.5)
+              << std::setw(12) << stats.checkout_nanos.percentile(0.99)
+              << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,221 @@
+#!/usr/bin/env node
+
+// Replays a recorded editing session against parse-daemon and reports the
+// latency from sending each request to receiving its reply, i.e. from a
+// keystroke to the reparsed tree. A session has one JSON request per line:
+//
+//   {"open": "main.tex", "file": "main.tex"}
+//   {"open": "main.tex", "text": "\\documentclass{article}\n"}
+//   {"edit": "main.tex", "start": 24, "end": 24, "text": "x"}
+//   {"close": "main.tex"}
+//
+// Offsets are in bytes and files are relative to the session. With
+// --synthesize a session is written instead that opens the file with a
+// passage removed from its middle and then types the passage back one
+// character at a time, deleting and retyping every twentieth character.
+//
+// Usage: script/replay-session.js [--daemon <path> | --socket <path>]
+//          [--budget <ms>] [--repeat <count>] [--max-p99 <ms>] <session>
+//        script/replay-session.js --synthesize <file> [<length>]
+
+const childProcess = require('child_process')
+const fs = require('fs')
+const net = require('net')
+const path = require('path')
+
+const PERCENTILES = [0.5, 0.9, 0.99]
+
+const args = process.argv.slice(2)
+const options = { daemon: 'build/test/parse-daemon', repeat: 1 }
+
+while (args.length > 1 && args[0].startsWith('--')) {
+  const name = args.shift().slice(2)
+  options[name.replace(/-(.)/g, (m, c) => c.toUpperCase())] = args.shift()
+}
+
+if (options.synthesize) {
+  synthesize(options.synthesize, parseInt(args[0] || '2000'))
+} else if (args.length === 1) {
+  replay(args[0]).catch(error => {
+    console.warn(error.message)
+    process.exit(1)
+  })
+} else {
+  console.warn('Usage: script/replay-session.js [--daemon <path> | --socket <path>]')
+  console.warn('         [--budget <ms>] [--repeat <count>] [--max-p99 <ms>] <session>')
+  console.warn('       script/replay-session.js --synthesize <file> [<length>]')
+  process.exit(1)
+}
+
+function synthesize (fileName, length) {
+  const source = fs.readFileSync(fileName)
+  const start = source.indexOf('\n', Math.floor(source.length / 2)) + 1
+  let end = Math.min(source.length, start + length)
+
+  // Cut at character boundaries.
+  while (end < source.length && (source[end] & 0xc0) === 0x80) end++
+
+  const passage = source.slice(start, end).toString('utf8')
+  const write = request => process.stdout.write(JSON.stringify(request) + '\n')
+  const id = path.basename(fileName)
+  let offset = start
+  let count = 0
+
+  write({
+    open: id,
+    text: Buffer.concat([source.slice(0, start), source.slice(end)]).toString('utf8')
+  })
+
+  for (const ch of passage) {
+    const size = Buffer.byteLength(ch)
+
+    write({ edit: id, start: offset, end: offset, text: ch })
+
+    if (++count % 20 === 0) {
+      write({ edit: id, start: offset, end: offset + size, text: '' })
+      write({ edit: id, start: offset, end: offset, text: ch })
+    }
+
+    offset += size
+  }
+
+  write({ close: id })
+}
+
+async function replay (sessionName) {
+  const directory = path.dirname(sessionName)
+  const requests = fs.readFileSync(sessionName, 'utf8').split('\n')
+    .filter(line => line.trim())
+    .map(line => JSON.parse(line))
+  const connection = await connect()
+  const latencies = { open: [], edit: [], close: [] }
+  let errors = 0
+  let exceeded = 0
+
+  for (let i = 0; i < options.repeat; i++) {
+    for (const request of requests) {
+      const type = Object.keys(latencies).find(key => key in request)
+      const startTime = process.hrtime()
+      const reply = await connection.send(encode(request, directory))
+      const time = process.hrtime(startTime)
+
+      latencies[type].push(time[0] * 1e3 + time[1] / 1e6)
+      if (reply.error) {
+        console.warn(reply.error)
+        errors++
+      } else if (reply.budget_exceeded) {
+        exceeded++
+      }
+    }
+  }
+
+  const stats = await connection.send('stats\n')
+
+  connection.end()
+
+  for (const type of Object.keys(latencies)) {
+    const values = latencies[type].sort((a, b) => a - b)
+
+    if (values.length === 0) continue
+
+    console.log(type + ': ' + values.length + ' requests, ' +
+      PERCENTILES.map(p => 'p' + (p * 100) + ' ' +
+        values[Math.min(values.length - 1, Math.floor(p * values.length))].toFixed(3) + ' ms')
+        .join(', ') + ', max ' + values[values.length - 1].toFixed(3) + ' ms')
+    console.log('  daemon: p50 ' + stats[type].p50 + ' us, p99 ' +
+      stats[type].p99 + ' us, max ' + stats[type].max + ' us')
+  }
+
+  const edits = latencies.edit
+  const p99 = edits.length ? edits[Math.min(edits.length - 1, Math.floor(0.99 * edits.length))] : 0
+
+  if (exceeded > 0) {
+    console.log(exceeded + ' parses exceeded the budget')
+  }
+
+  if (errors > 0) {
+    console.warn(errors + ' requests failed')
+    process.exit(1)
+  }
+
+  if (options.maxP99 && p99 > parseFloat(options.maxP99)) {
+    console.warn('edit p99 of ' + p99.toFixed(3) + ' ms exceeds ' + options.maxP99 + ' ms')
+    process.exit(1)
+  }
+}
+
+function encode (request, directory) {
+  if ('open' in request) {
+    const text = ('file' in request)
+      ? fs.readFileSync(path.resolve(directory, request.file))
+      : Buffer.from(request.text)
+
+    return Buffer.concat([
+      Buffer.from('open ' + request.open + ' ' + text.length + '\n'), text])
+  }
+
+  if ('edit' in request) {
+    const text = Buffer.from(request.text)
+
+    return Buffer.concat([
+      Buffer.from('edit ' + request.edit + ' ' + request.start + ' ' +
+        request.end + ' ' + text.length + '\n'), text])
+  }
+
+  return 'close ' + request.close + '\n'
+}
+
+// Sends one request at a time and resolves with its reply.
+function connect () {
+  return new Promise((resolve, reject) => {
+    let input, output
+
+    if (options.socket) {
+      input = output = net.connect(options.socket, ready)
+    } else {
+      const child = childProcess.spawn(options.daemon,
+        options.budget ? ['-t', options.budget] : [],
+        { stdio: ['pipe', 'pipe', 'inherit'] })
+
+      input = child.stdout
+      output = child.stdin
+      child.on('error', fail)
+      process.nextTick(ready)
+    }
+
+    let pending = null
+    let buffer = ''
+
+    input.setEncoding('utf8')
+    input.on('data', data => {
+      buffer += data
+
+      let newline
+      while ((newline = buffer.indexOf('\n')) >= 0 && pending) {
+        const line = buffer.slice(0, newline)
+        buffer = buffer.slice(newline + 1)
+        pending.resolve(JSON.parse(line))
+        pending = null
+      }
+    })
+    input.on('error', fail)
+    output.on('error', fail)
+    input.on('end', () => fail(new Error('parse-daemon closed the connection')))
+
+    function fail (error) {
+      if (pending) pending.reject(error)
+      pending = null
+      reject(error)
+    }
+
+    function ready () {
+      resolve({
+        send: data => new Promise((resolve, reject) => {
+          pending = { resolve, reject }
+          output.write(data)
+        }),
+        end: () => output.end()
+      })
+    }
+  })
+}
@@ -0,0 +1,149 @@
+#!/usr/bin/env node
+
+// Measures how the time and peak memory of scanning and parsing grow with the
+// size of the input. Documents of each size are made with
+// script/generate-document.js and kept in the build directory, then
+// scanner-benchmark tokenizes them and parse-file parses them if it was
+// built, see CMakeLists.txt. The build directory is build/cmake unless given
+// otherwise, since node-gyp uses build itself. For each tool the exponent of
+// a power law fitted to the curves is reported, which is 1 if the cost grows
+// linearly with the size. Options other than the ones below are passed to
+// the generator.
+//
+// Usage: script/scaling-benchmark.js [--build <dir>] [--sizes <MB,...>]
+//          [--csv <file>] [--max-exponent <x>] [<generator options>]
+
+const childProcess = require('child_process')
+const crypto = require('crypto')
+const fs = require('fs')
+const path = require('path')
+const generate = require('./generate-document')
+
+const ROOT = path.resolve(__dirname, '..')
+const TOOLS = [
+  { name: 'tokens', program: 'scanner-benchmark', args: ['-n', '1', 'tokens'] },
+  { name: 'parse', program: 'parse-file', args: [] }
+]
+
+const args = process.argv.slice(2)
+const options = { build: path.join(ROOT, 'build', 'cmake'), sizes: '10,20,50,100,200,500' }
+const generatorOptions = {}
+
+while (args.length > 1 && args[0].startsWith('--')) {
+  const name = args.shift().slice(2).replace(/-(.)/g, (m, c) => c.toUpperCase())
+  const value = args.shift()
+
+  if (name in options || name === 'csv' || name === 'maxExponent') {
+    options[name] = value
+  } else {
+    generatorOptions[name] = parseFloat(value)
+  }
+}
+
+if (args.length !== 0) {
+  console.warn('Usage: script/scaling-benchmark.js [--build <dir>] [--sizes <MB,...>]')
+  console.warn('         [--csv <file>] [--max-exponent <x>] [<generator options>]')
+  process.exit(1)
+}
+
+const sizes = options.sizes.split(',').map(parseFloat)
+const tools = TOOLS.filter(tool => fs.existsSync(path.join(options.build, tool.program)))
+const directory = path.join(options.build, 'scaling')
+// The documents depend on the generator options, so they are part of the
+// name of each file.
+const key = crypto.createHash('md5').update(JSON.stringify(generatorOptions))
+  .digest('hex').slice(0, 8)
+const rows = []
+
+if (tools.length === 0) {
+  console.warn('Neither scanner-benchmark nor parse-file was found in ' + options.build)
+  process.exit(1)
+}
+
+fs.mkdirSync(directory, { recursive: true })
+
+console.log('tool'.padEnd(8) + 'MB'.padStart(8) + 'ms'.padStart(12) +
+  'MB/s'.padStart(10) + 'peak MB'.padStart(10))
+
+for (const size of sizes) {
+  const fileName = path.join(directory, key + '-' + size + '.tex')
+
+  if (!fs.existsSync(fileName)) {
+    const fd = fs.openSync(fileName, 'w')
+
+    generate(fd, Object.assign({}, generatorOptions, { size }))
+    fs.closeSync(fd)
+  }
+
+  const bytes = fs.statSync(fileName).size
+
+  for (const tool of tools) {
+    const output = run(path.join(options.build, tool.program), tool.args.concat(fileName))
+    const milliseconds = parseFloat(/(?:Average|Time): ([0-9.e+-]+)/.exec(output)[1])
+    const peak = parseInt(/Peak RSS: ([0-9]+)/.exec(output)[1]) / 1024
+
+    rows.push({ tool: tool.name, bytes, milliseconds, peak })
+    console.log(tool.name.padEnd(8) + (bytes / 1e6).toFixed(1).padStart(8) +
+      milliseconds.toFixed(1).padStart(12) +
+      (bytes / milliseconds / 1000).toFixed(2).padStart(10) +
+      peak.toFixed(1).padStart(10))
+  }
+}
+
+if (options.csv) {
+  fs.writeFileSync(options.csv, 'tool,bytes,milliseconds,peak_mb\n' +
+    rows.map(row => [row.tool, row.bytes, row.milliseconds, row.peak].join(',') + '\n').join(''))
+}
+
+let superLinear = false
+
+for (const tool of tools) {
+  const points = rows.filter(row => row.tool === tool.name)
+
+  if (points.length < 2) continue
+
+  const time = exponent(points.map(row => [row.bytes, row.milliseconds]))
+  const memory = exponent(points.map(row => [row.bytes, row.peak]))
+
+  console.log(tool.name + ': time ~ size^' + time.toFixed(2) +
+    ', memory ~ size^' + memory.toFixed(2))
+
+  if (options.maxExponent && Math.max(time, memory) > parseFloat(options.maxExponent)) {
+    superLinear = true
+  }
+}
+
+if (superLinear) {
+  console.warn('Growth exceeds size^' + options.maxExponent)
+  process.exit(1)
+}
+
+function run (command, args) {
+  const result = childProcess.spawnSync(command, args, { encoding: 'utf8' })
+
+  if (result.status !== 0) {
+    console.warn(result.stdout + result.stderr)
+    console.warn(command + ' ' + args.join(' ') + ' failed')
+    process.exit(1)
+  }
+
+  return result.stderr
+}
+
+// The slope of the least squares line through the points on a log-log scale.
+function exponent (points) {
+  const xs = points.map(point => Math.log(point[0]))
+  const ys = points.map(point => Math.log(point[1]))
+  const mean = values => values.reduce((sum, value) => sum + value, 0) / values.length
+  const mx = mean(xs)
+  const my = mean(ys)
+  let numerator = 0
+  let denominator = 0
+
+  for (let i = 0; i < xs.length; i++) {
+    numerator += (xs[i] - mx) * (ys[i] - my)
+    denominator += (xs[i] - mx) * (xs[i] - mx)
+  }
+
+  return numerator / denominator
+}
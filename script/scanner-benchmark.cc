@@ -0,0 +1,186 @@
+// Drives LaTeX::Scanner directly over an in-memory buffer without the parser
+// so that the cost of reading characters can be measured in isolation from
+// the parse table. The input is decoded to UTF-32 before timing starts.
+//
+// Usage: scanner-benchmark [-n <iterations>] <text|rest|tokens> <file>
+//
+//   text    Scan the file as document text, i.e. text, spaces, comments,
+//           control sequences and groups.
+//   rest    Scan the whole file as the ignored rest after \endinput.
+//   tokens  Run LaTeX::Tokenizer over the UTF-8 contents of the file.
+
+#include <algorithm>
+#include <chrono>
+#include <codecvt>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <locale>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+#include "scanner.hh"
+#include "tokenizer.hh"
+
+using namespace LaTeX;
+
+const int DEFAULT_ITERATION_COUNT = 100;
+const int SYMBOL_COUNT = verbatim_text + 1;
+
+struct BufferLexer {
+  TSLexer lexer;
+  const char32_t *begin, *position, *end, *marked;
+
+  static void advance(TSLexer *lexer, bool) {
+    BufferLexer *self = reinterpret_cast<BufferLexer *>(lexer);
+
+    if (self->position < self->end) {
+      self->position++;
+    }
+
+    lexer->lookahead = (self->position < self->end) ? *self->position : 0;
+  }
+
+  static void mark_end(TSLexer *lexer) {
+    BufferLexer *self = reinterpret_cast<BufferLexer *>(lexer);
+    self->marked = self->position;
+  }
+
+  BufferLexer(const std::u32string &text) {
+    lexer.advance = advance;
+    lexer.mark_end = mark_end;
+    begin = text.data();
+    end = begin + text.length();
+    reset(begin);
+  }
+
+  void reset(const char32_t *p) {
+    position = marked = p;
+    lexer.lookahead = (position < end) ? *position : 0;
+  }
+};
+
+void text_symbols(bool *valid_symbols) {
+  std::fill(valid_symbols, valid_symbols + SYMBOL_COUNT, false);
+  std::fill(valid_symbols + cs_addvspace, valid_symbols + cs + 1, true);
+  valid_symbols[cs_make_verb_delim] = false;
+  valid_symbols[cs_delete_verb_delim] = false;
+
+  for (SymbolType symbol :
+       {_space, active_char, alignment_tab, comment, comment_arara,
+        comment_bib, comment_tag, comment_tex, display_math_shift, ignored, l,
+        math_shift, par_eol, parameter_ref, r, subscript, superscript, text}) {
+    valid_symbols[symbol] = true;
+  }
+}
+
+size_t scan(const std::u32string &text, const bool *valid_symbols) {
+  Scanner scanner;
+  BufferLexer lexer(text);
+  char state[TREE_SITTER_SERIALIZATION_BUFFER_SIZE];
+  unsigned length = 0;
+  size_t count = 0;
+
+  while (lexer.position < lexer.end) {
+    const char32_t *start = lexer.position;
+
+    // Tree-sitter restores the scanner state before every external token.
+    scanner.deserialize(state, length);
+
+    bool found = scanner.scan(&lexer.lexer, valid_symbols);
+
+    // Skip anything the scanner does not consume as the parser would.
+    lexer.reset((found && lexer.marked > start) ? lexer.marked : start + 1);
+
+    length = scanner.serialize(state);
+    count++;
+  }
+
+  return count;
+}
+
+size_t tokenize(const std::string &source) {
+  Tokenizer tokenizer(source.data(), source.length());
+  Token token;
+  size_t count = 0;
+
+  while (tokenizer.next(token)) {
+    count++;
+  }
+
+  return count;
+}
+
+int main(int argc, char **argv) {
+  int iteration_count = DEFAULT_ITERATION_COUNT;
+
+  if (argc > 2 && std::strcmp(argv[1], "-n") == 0) {
+    iteration_count = std::max(1, std::atoi(argv[2]));
+    argc -= 2;
+    argv += 2;
+  }
+
+  if (argc < 3) {
+    std::cerr << "Usage: scanner-benchmark [-n <iterations>] "
+                 "<text|rest|tokens> <file>"
+              << std::endl;
+    return 1;
+  }
+
+  std::string mode(argv[1]);
+  bool valid_symbols[SYMBOL_COUNT];
+
+  if (mode == "text") {
+    text_symbols(valid_symbols);
+  } else if (mode == "rest") {
+    std::fill(valid_symbols, valid_symbols + SYMBOL_COUNT, false);
+    valid_symbols[ignored_rest] = true;
+  } else if (mode != "tokens") {
+    std::cerr << "Unknown mode " << mode << std::endl;
+    return 1;
+  }
+
+  std::ifstream file(argv[2], std::ios::binary);
+  std::stringstream contents;
+  contents << file.rdbuf();
+
+  std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> convert;
+  std::string source = contents.str();
+  // The tokenizer reads UTF-8, so a large file is not held twice.
+  std::u32string text =
+      (mode == "tokens") ? std::u32string() : convert.from_bytes(source);
+  std::vector<double> durations;
+  size_t tokens = 0;
+
+  for (int i = 0; i < iteration_count; i++) {
+    auto start = std::chrono::steady_clock::now();
+    tokens = (mode == "tokens") ? tokenize(source) : scan(text, valid_symbols);
+    auto end = std::chrono::steady_clock::now();
+    durations.push_back(
+        std::chrono::duration<double, std::milli>(end - start).count());
+  }
+
+  std::sort(durations.begin(), durations.end());
+
+  double average = 0;
+  for (double duration : durations) {
+    average += duration;
+  }
+  average /= iteration_count;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  std::cerr << "Scanner (" << mode << "):" << std::endl
+            << "Tokens: " << tokens << " Bytes: " << source.length()
+            << std::endl
+            << "Average: " << average << " Min: " << durations.front()
+            << " Max: " << durations.back() << std::endl
+            << "MB/s: " << source.length() / average / 1000.0 << std::endl
+            << "Peak RSS: " << usage.ru_maxrss << " KB" << std::endl;
+
+  return 0;
+}
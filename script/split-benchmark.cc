@@ -0,0 +1,115 @@
+// Measures how long LaTeX::SplitDocument takes to parse a large document,
+// e.g. one written by script/generate-document.js, on 1, 2, 4 and so on up to
+// the number of cores, compared to parsing it at once. The prescan is timed
+// on its own as well. Each measurement is the median of a few runs.
+//
+// Usage: split-benchmark [-n <runs>] [-c <chunk kilobytes>] <file>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "split.hh"
+
+using namespace LaTeX;
+
+extern "C" const TSLanguage *tree_sitter_latex();
+
+template <typename Function>
+double median_millis(unsigned runs, Function run) {
+  std::vector<double> durations;
+
+  for (unsigned i = 0; i < runs; i++) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    std::chrono::duration<double, std::milli> duration =
+        std::chrono::steady_clock::now() - start;
+    durations.push_back(duration.count());
+  }
+
+  std::sort(durations.begin(), durations.end());
+
+  return durations[durations.size() / 2];
+}
+
+int main(int argc, char **argv) {
+  unsigned runs = 5;
+  uint32_t chunk_size = 1 << 20;
+  int i = 1;
+
+  for (; i + 2 < argc; i += 2) {
+    if (std::strcmp(argv[i], "-n") == 0) {
+      runs = std::max(1, std::atoi(argv[i + 1]));
+    } else if (std::strcmp(argv[i], "-c") == 0) {
+      chunk_size = std::max(1, std::atoi(argv[i + 1])) << 10;
+    } else {
+      break;
+    }
+  }
+
+  if (i + 1 != argc) {
+    std::cerr << "Usage: split-benchmark [-n <runs>] [-c <chunk kilobytes>] "
+                 "<file>"
+              << std::endl;
+    return 1;
+  }
+
+  std::ifstream file(argv[i], std::ios::binary);
+  std::stringstream contents;
+  contents << file.rdbuf();
+
+  std::string source = contents.str();
+  uint32_t length = static_cast<uint32_t>(source.size());
+  const TSLanguage *language = tree_sitter_latex();
+  TSParser *parser = ts_parser_new();
+  SplitPlan plan;
+
+  ts_parser_set_language(parser, language);
+
+  double prescan_millis = median_millis(
+      runs, [&]() { plan = prescan(source.data(), length); });
+  double whole_millis = median_millis(runs, [&]() {
+    ts_tree_delete(
+        ts_parser_parse_string(parser, nullptr, source.data(), length));
+  });
+
+  ts_parser_delete(parser);
+
+  std::cout << std::fixed << std::setprecision(1) << "Bytes: " << length
+            << " Boundaries: " << plan.boundaries.size() << std::endl
+            << "Prescan: " << prescan_millis << " ms" << std::endl
+            << "Whole document: " << whole_millis << " ms" << std::endl;
+
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+  for (unsigned thread_count = 1;; thread_count *= 2) {
+    thread_count = std::min(thread_count, cores);
+
+    size_t chunks = 0;
+    double millis = median_millis(runs, [&]() {
+      SplitDocument document;
+
+      document.parse(language, source.data(), length, thread_count,
+                     chunk_size);
+      chunks = document.chunks().size();
+    });
+
+    std::cout << thread_count << " threads: " << millis << " ms, " << chunks
+              << " chunks, " << std::setprecision(2) << whole_millis / millis
+              << "x" << std::setprecision(1) << std::endl;
+
+    if (thread_count == cores) {
+      break;
+    }
+  }
+
+  return 0;
+}
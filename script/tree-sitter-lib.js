@@ -0,0 +1,27 @@
+#!/usr/bin/env node
+
+// Prints the directory of the tree-sitter runtime that binding.gyp compiles
+// into the binding, i.e. vendor/tree-sitter/lib of the tree-sitter module.
+// The module is a peer dependency, so the install has to provide it.
+
+const fs = require('fs')
+const path = require('path')
+
+let lib
+
+try {
+  const directory = path.dirname(require.resolve('tree-sitter/package.json'))
+  lib = path.join(directory, 'vendor', 'tree-sitter', 'lib')
+} catch (error) {
+  console.error('The tree-sitter module was not found. It is a peer ' +
+    'dependency of the binding, install it with `npm install tree-sitter`.')
+  process.exit(1)
+}
+
+if (!fs.existsSync(path.join(lib, 'src', 'lib.c'))) {
+  console.error(`The tree-sitter module has no runtime in ${lib}. The ` +
+    'binding needs the one shipped with tree-sitter 0.15.')
+  process.exit(1)
+}
+
+console.log(lib)
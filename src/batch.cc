@@ -0,0 +1,88 @@
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+#include "batch.hh"
+
+namespace LaTeX {
+
+FileBatch::FileBatch(const TSLanguage *language, ParserPool &pool,
+                     const std::vector<std::string> &paths,
+                     const BatchOptions &options)
+    : language(language), pool(pool), options(options),
+      summaries(paths.size()), next(0) {
+  for (size_t i = 0; i < paths.size(); i++) {
+    summaries[i].path = paths[i];
+  }
+}
+
+void FileBatch::parse_file(FileSummary &summary, TSParser *parser,
+                           Indexer *indexer) {
+  std::ifstream stream(summary.path, std::ios::binary);
+
+  if (!stream) {
+    summary.error = "Unable to read " + summary.path;
+    return;
+  }
+
+  std::stringstream contents;
+  contents << stream.rdbuf();
+
+  const std::string source = contents.str();
+
+  if (source.length() > UINT32_MAX) {
+    summary.error = "Too large to parse " + summary.path;
+    return;
+  }
+
+  summary.bytes = static_cast<uint32_t>(source.length());
+
+  BudgetedParse result = parse_with_budget(
+      parser, nullptr, source.data(), summary.bytes,
+      (options.budget_micros == 0)
+          ? std::chrono::steady_clock::time_point::max()
+          : std::chrono::steady_clock::now() +
+                std::chrono::microseconds(options.budget_micros));
+
+  summary.outcome = result.outcome;
+  summary.offset = result.offset;
+  summary.micros = result.micros;
+
+  if (!result.tree) {
+    return;
+  }
+
+  TSNode root = ts_tree_root_node(result.tree);
+
+  summary.has_error = ts_node_has_error(root);
+
+  if (indexer) {
+    indexer->extract(summary.entries, root, source.data());
+
+    if (options.keys) {
+      summary.keys.reserve(summary.entries.size());
+
+      for (const IndexEntry &entry : summary.entries) {
+        summary.keys.emplace_back(source, entry.key_start,
+                                  entry.key_end - entry.key_start);
+      }
+    }
+  }
+
+  ts_tree_delete(result.tree);
+}
+
+void FileBatch::work() {
+  PooledParser parser = pool.checkout();
+  std::unique_ptr<Indexer> indexer;
+
+  if (options.records) {
+    indexer.reset(new Indexer(language));
+  }
+
+  for (size_t i; (i = next.fetch_add(1)) < summaries.size();) {
+    parse_file(summaries[i], parser, indexer.get());
+  }
+}
+
+} // namespace LaTeX
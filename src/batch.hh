@@ -0,0 +1,75 @@
+#ifndef BATCH_HH_
+#define BATCH_HH_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tree_sitter/api.h"
+
+#include "budget.hh"
+#include "index.hh"
+#include "parser_pool.hh"
+
+namespace LaTeX {
+
+struct BatchOptions {
+  // Extract the structural records of each file.
+  bool records = true;
+  // Copy the key of each record out of the source.
+  bool keys = false;
+  // Gives up on a file whose parse takes longer than this. Zero means no
+  // limit.
+  uint64_t budget_micros = 0;
+};
+
+// What is kept of a parsed file instead of its tree.
+struct FileSummary {
+  std::string path;
+  // Why the file could not be read, empty if it was.
+  std::string error;
+  uint32_t bytes = 0;
+  // Whether the tree has ERROR or missing nodes.
+  bool has_error = false;
+  ParseOutcome outcome = PARSE_COMPLETE;
+  // How far the parse got, see BudgetedParse.
+  uint32_t offset = 0;
+  uint64_t micros = 0;
+  std::vector<IndexEntry> entries;
+  std::vector<std::string> keys;
+};
+
+// Parses a list of files on any number of threads that each call work. The
+// files are taken from a shared counter, so a thread that is done early
+// takes over files from the others. The trees are deleted as soon as the
+// summary of a file is made.
+class FileBatch {
+  const TSLanguage *language;
+  ParserPool &pool;
+  BatchOptions options;
+  std::vector<FileSummary> summaries;
+  std::atomic<size_t> next;
+
+  void parse_file(FileSummary &summary, TSParser *parser, Indexer *indexer);
+
+public:
+  FileBatch(const TSLanguage *language, ParserPool &pool,
+            const std::vector<std::string> &paths,
+            const BatchOptions &options = BatchOptions());
+
+  FileBatch(const FileBatch &) = delete;
+
+  FileBatch &operator=(const FileBatch &) = delete;
+
+  // Parses files until none are left.
+  void work();
+
+  // The summaries in the order of the paths, once every call to work has
+  // returned.
+  const std::vector<FileSummary> &results() const { return summaries; }
+};
+
+} // namespace LaTeX
+
+#endif
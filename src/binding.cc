@@ -0,0 +1,222 @@
+#include <cstdlib>
+#include <memory>
+#include <node.h>
+#include <string>
+#include <vector>
+
+#include "nan.h"
+
+#include "batch.hh"
+
+using namespace v8;
+using namespace LaTeX;
+
+extern "C" TSLanguage *tree_sitter_latex();
+
+namespace {
+
+// The fields of a record in the records of a file, see IndexEntry.
+const int RECORD_FIELDS = 7;
+
+// The number of threads in the libuv pool unless UV_THREADPOOL_SIZE says
+// otherwise.
+const unsigned DEFAULT_THREADPOOL_SIZE = 4;
+
+// The parsers are shared by all batches, so that a batch does not pay for
+// creating them. There are never more than UV_THREADPOOL_SIZE in use.
+ParserPool &parser_pool() {
+  static ParserPool pool(tree_sitter_latex(), 128);
+  return pool;
+}
+
+unsigned threadpool_size() {
+  const char *value = std::getenv("UV_THREADPOOL_SIZE");
+  int size = value ? std::atoi(value) : 0;
+
+  if (size <= 0) {
+    return DEFAULT_THREADPOOL_SIZE;
+  }
+
+  return (size > 1024) ? 1024 : static_cast<unsigned>(size);
+}
+
+struct BatchJob {
+  FileBatch batch;
+  // The workers that have not finished yet.
+  unsigned remaining;
+  Nan::Callback callback;
+
+  BatchJob(const std::vector<std::string> &paths, const BatchOptions &options,
+           Local<Function> callback)
+      : batch(tree_sitter_latex(), parser_pool(), paths, options),
+        remaining(0), callback(callback) {}
+};
+
+Local<Object> summary_object(const FileSummary &summary,
+                             const BatchOptions &options) {
+  Local<Object> result = Nan::New<Object>();
+
+  Nan::Set(result, Nan::New("path").ToLocalChecked(),
+           Nan::New(summary.path).ToLocalChecked());
+
+  if (!summary.error.empty()) {
+    Nan::Set(result, Nan::New("error").ToLocalChecked(),
+             Nan::New(summary.error).ToLocalChecked());
+    return result;
+  }
+
+  Nan::Set(result, Nan::New("bytes").ToLocalChecked(),
+           Nan::New<Number>(summary.bytes));
+  Nan::Set(result, Nan::New("parseMicros").ToLocalChecked(),
+           Nan::New<Number>(static_cast<double>(summary.micros)));
+
+  if (summary.outcome != PARSE_COMPLETE) {
+    Nan::Set(result, Nan::New("budgetExceeded").ToLocalChecked(),
+             Nan::True());
+    Nan::Set(result, Nan::New("offset").ToLocalChecked(),
+             Nan::New<Number>(summary.offset));
+    return result;
+  }
+
+  Nan::Set(result, Nan::New("hasError").ToLocalChecked(),
+           Nan::New(summary.has_error));
+
+  if (options.records) {
+    size_t count = summary.entries.size() * RECORD_FIELDS;
+    Local<ArrayBuffer> buffer =
+        ArrayBuffer::New(Isolate::GetCurrent(), count * sizeof(int32_t));
+    Local<Int32Array> records = Int32Array::New(buffer, 0, count);
+    Nan::TypedArrayContents<int32_t> contents(records);
+    int32_t *data = *contents;
+
+    for (const IndexEntry &entry : summary.entries) {
+      *data++ = entry.kind;
+      *data++ = entry.level;
+      *data++ = entry.section;
+      *data++ = static_cast<int32_t>(entry.start_byte);
+      *data++ = static_cast<int32_t>(entry.end_byte);
+      *data++ = static_cast<int32_t>(entry.key_start);
+      *data++ = static_cast<int32_t>(entry.key_end);
+    }
+
+    Nan::Set(result, Nan::New("records").ToLocalChecked(), records);
+  }
+
+  if (options.keys) {
+    Local<Array> keys = Nan::New<Array>(summary.keys.size());
+
+    for (uint32_t i = 0; i < summary.keys.size(); i++) {
+      Nan::Set(keys, i, Nan::New(summary.keys[i]).ToLocalChecked());
+    }
+
+    Nan::Set(result, Nan::New("keys").ToLocalChecked(), keys);
+  }
+
+  return result;
+}
+
+// Parses files from a batch on a thread of the libuv pool. The last worker
+// of a batch to finish calls back with the results of every file.
+class BatchWorker : public Nan::AsyncWorker {
+  std::shared_ptr<BatchJob> job;
+  BatchOptions options;
+
+public:
+  BatchWorker(std::shared_ptr<BatchJob> job, const BatchOptions &options)
+      : Nan::AsyncWorker(nullptr, "tree-sitter-latex:parseFiles"), job(job),
+        options(options) {}
+
+  void Execute() override { job->batch.work(); }
+
+  void HandleOKCallback() override {
+    if (--job->remaining != 0) {
+      return;
+    }
+
+    const std::vector<FileSummary> &summaries = job->batch.results();
+    Local<Array> results = Nan::New<Array>(summaries.size());
+
+    for (uint32_t i = 0; i < summaries.size(); i++) {
+      Nan::Set(results, i, summary_object(summaries[i], options));
+    }
+
+    Local<Value> argv[] = {Nan::Null(), results};
+    job->callback.Call(2, argv, async_resource);
+  }
+};
+
+bool boolean_option(Local<Object> options, const char *name, bool value) {
+  Local<Value> option =
+      Nan::Get(options, Nan::New(name).ToLocalChecked()).ToLocalChecked();
+
+  return option->IsUndefined() ? value : Nan::To<bool>(option).FromJust();
+}
+
+// parseFiles(paths, options, callback) reads and parses files on the libuv
+// thread pool and calls back with a summary of each file in the order of
+// the paths. The options are records and keys, which select what is
+// extracted, and budget, the time in milliseconds after which the parse of
+// a file is abandoned.
+NAN_METHOD(ParseFiles) {
+  if (info.Length() < 3 || !info[0]->IsArray() || !info[2]->IsFunction()) {
+    return Nan::ThrowTypeError("Expected paths, options and a callback");
+  }
+
+  Local<Array> list = info[0].As<Array>();
+  std::vector<std::string> paths;
+  BatchOptions options;
+
+  for (uint32_t i = 0; i < list->Length(); i++) {
+    Nan::Utf8String path(Nan::Get(list, i).ToLocalChecked());
+    paths.emplace_back(*path, path.length());
+  }
+
+  if (info[1]->IsObject()) {
+    Local<Object> object = info[1].As<Object>();
+    Local<Value> budget =
+        Nan::Get(object, Nan::New("budget").ToLocalChecked()).ToLocalChecked();
+
+    options.records = boolean_option(object, "records", options.records);
+    options.keys = boolean_option(object, "keys", options.keys);
+
+    if (budget->IsNumber() && Nan::To<double>(budget).FromJust() > 0) {
+      options.budget_micros =
+          static_cast<uint64_t>(Nan::To<double>(budget).FromJust() * 1000);
+    }
+  }
+
+  auto job = std::make_shared<BatchJob>(paths, options,
+                                        info[2].As<Function>());
+  unsigned count = threadpool_size();
+
+  if (count > paths.size()) {
+    count = paths.empty() ? 1 : static_cast<unsigned>(paths.size());
+  }
+
+  job->remaining = count;
+
+  for (unsigned i = 0; i < count; i++) {
+    Nan::AsyncQueueWorker(new BatchWorker(job, options));
+  }
+}
+
+NAN_METHOD(New) {}
+
+void Init(Local<Object> exports, Local<Object> module) {
+  Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+  tpl->SetClassName(Nan::New("Language").ToLocalChecked());
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+  Local<Function> constructor = Nan::GetFunction(tpl).ToLocalChecked();
+  Local<Object> instance = Nan::NewInstance(constructor).ToLocalChecked();
+  Nan::SetInternalFieldPointer(instance, 0, tree_sitter_latex());
+
+  Nan::Set(instance, Nan::New("name").ToLocalChecked(),
+           Nan::New("latex").ToLocalChecked());
+  Nan::SetMethod(instance, "parseFiles", ParseFiles);
+  Nan::Set(module, Nan::New("exports").ToLocalChecked(), instance);
+}
+
+NODE_MODULE(tree_sitter_latex_binding, Init)
+
+} // namespace
@@ -0,0 +1,48 @@
+#ifndef BITS_HH_
+#define BITS_HH_
+
+#include <cstdint>
+
+namespace LaTeX {
+
+// The index of the lowest set bit of a bitmap that is not zero.
+inline unsigned lowest_bit(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(bits);
+#else
+  unsigned count = 0;
+  for (; !(bits & 1); bits >>= 1) {
+    count++;
+  }
+  return count;
+#endif
+}
+
+// The index of the highest set bit of a bitmap that is not zero.
+inline unsigned highest_bit(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+  return 63 - __builtin_clzll(bits);
+#else
+  unsigned index = 0;
+  while (bits >>= 1) {
+    index++;
+  }
+  return index;
+#endif
+}
+
+inline unsigned count_bits(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(bits);
+#else
+  unsigned count = 0;
+  for (; bits; bits &= bits - 1) {
+    count++;
+  }
+  return count;
+#endif
+}
+
+} // namespace LaTeX
+
+#endif
@@ -0,0 +1,110 @@
+#include <algorithm>
+
+#include "budget.hh"
+
+extern "C" void tree_sitter_latex_set_scan_budget(
+    uint64_t timeout_micros, const size_t *cancellation_flag);
+
+extern "C" bool tree_sitter_latex_scan_budget_exhausted();
+
+namespace LaTeX {
+
+namespace {
+
+// Handing the source to the parser in chunks shows how far it got, since
+// the lexer asks for the chunk that holds each position it moves to.
+const uint32_t READ_CHUNK_SIZE = 1 << 12;
+
+struct BudgetInput {
+  const char *source;
+  uint32_t length, offset;
+
+  static const char *read(void *payload, uint32_t byte_index, TSPoint,
+                          uint32_t *bytes_read) {
+    BudgetInput *self = static_cast<BudgetInput *>(payload);
+
+    if (byte_index >= self->length) {
+      *bytes_read = 0;
+      return "";
+    }
+
+    self->offset = std::max(self->offset, byte_index);
+    *bytes_read = std::min(READ_CHUNK_SIZE, self->length - byte_index);
+    return self->source + byte_index;
+  }
+};
+
+uint64_t elapsed_micros(std::chrono::steady_clock::time_point start) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+}
+
+} // namespace
+
+BudgetedParse parse_with_budget(TSParser *parser, const TSTree *old_tree,
+                                const char *source, uint32_t length,
+                                std::chrono::steady_clock::time_point deadline,
+                                const size_t *cancellation_flag) {
+  auto start = std::chrono::steady_clock::now();
+  bool limited = deadline != std::chrono::steady_clock::time_point::max();
+  BudgetedParse result = {PARSE_COMPLETE, nullptr, 0, 0};
+
+  if (cancellation_flag && *cancellation_flag) {
+    result.outcome = PARSE_CANCELLED;
+    return result;
+  }
+
+  if (limited && deadline <= start) {
+    result.outcome = PARSE_TIMED_OUT;
+    return result;
+  }
+
+  // A timeout of zero means no timeout to the parser, so at least one
+  // microsecond is left.
+  uint64_t timeout_micros =
+      limited ? std::max<uint64_t>(
+                    1, std::chrono::duration_cast<std::chrono::microseconds>(
+                           deadline - start)
+                           .count())
+              : 0;
+  uint64_t previous_timeout = ts_parser_timeout_micros(parser);
+  const size_t *previous_flag = ts_parser_cancellation_flag(parser);
+  BudgetInput reader = {source, length, 0};
+  TSInput input = {&reader, BudgetInput::read, TSInputEncodingUTF8};
+
+  ts_parser_set_timeout_micros(parser, timeout_micros);
+  ts_parser_set_cancellation_flag(parser, cancellation_flag);
+  tree_sitter_latex_set_scan_budget(timeout_micros, cancellation_flag);
+
+  result.tree = ts_parser_parse(parser, old_tree, input);
+
+  bool exhausted = tree_sitter_latex_scan_budget_exhausted();
+
+  tree_sitter_latex_set_scan_budget(0, nullptr);
+  ts_parser_set_timeout_micros(parser, previous_timeout);
+  ts_parser_set_cancellation_flag(parser, previous_flag);
+
+  // The scanner may run out of budget on the last token before the parser
+  // notices, in which case the tree is not the tree of the source.
+  if (result.tree && exhausted) {
+    ts_tree_delete(result.tree);
+    result.tree = nullptr;
+  }
+
+  if (result.tree) {
+    result.offset = length;
+  } else {
+    ts_parser_reset(parser);
+    result.outcome = (cancellation_flag && *cancellation_flag)
+                         ? PARSE_CANCELLED
+                         : PARSE_TIMED_OUT;
+    result.offset = reader.offset;
+  }
+
+  result.micros = elapsed_micros(start);
+  return result;
+}
+
+} // namespace LaTeX
@@ -0,0 +1,40 @@
+#ifndef BUDGET_HH_
+#define BUDGET_HH_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "tree_sitter/api.h"
+
+namespace LaTeX {
+
+enum ParseOutcome { PARSE_COMPLETE, PARSE_TIMED_OUT, PARSE_CANCELLED };
+
+struct BudgetedParse {
+  ParseOutcome outcome;
+  // The tree of a complete parse, which the caller owns, or null.
+  TSTree *tree;
+  // The furthest byte the parse read from, to within a few kilobytes, or the
+  // length of the source if the parse is complete.
+  uint32_t offset;
+  uint64_t micros;
+};
+
+// Parses a document unless the deadline passes or the cancellation flag is
+// set to a nonzero value first, e.g. by another thread. Both are passed to
+// the parser with ts_parser_set_timeout_micros and
+// ts_parser_set_cancellation_flag and to the scanner as its ScanBudget, so
+// the parse also stops in the middle of a long token. A parse that stops is
+// not resumed by the next call, since a token that was cut short would end
+// up in its tree. The parser's own timeout and flag are restored afterwards.
+BudgetedParse parse_with_budget(
+    TSParser *parser, const TSTree *old_tree, const char *source,
+    uint32_t length,
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::time_point::max(),
+    const size_t *cancellation_flag = nullptr);
+
+} // namespace LaTeX
+
+#endif
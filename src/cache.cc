@@ -0,0 +1,478 @@
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.hh"
+#include "sha256.hh"
+
+namespace LaTeX {
+
+namespace {
+
+const uint64_t CACHE_MAGIC = 0x32484341434c5354; // "TSLCACH2"
+const uint64_t FNV_OFFSET = 0xcbf29ce484222325;
+const uint64_t FNV_PRIME = 0x100000001b3;
+
+// Records are aligned so that the slot offsets and the entries in them can be
+// read in place.
+const size_t RECORD_ALIGNMENT = 8;
+
+// How often opening the cache is retried when another process replaces the
+// file in the meantime.
+const int OPEN_ATTEMPTS = 8;
+
+inline size_t align(size_t size) {
+  return (size + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+}
+
+} // namespace
+
+struct CacheHeader {
+  uint64_t magic;
+  uint64_t stamp;
+  uint64_t slot_count;
+  std::atomic<uint64_t> tail;
+};
+
+// A key of zero marks an empty slot and an offset of zero a record that is
+// still being written. The key is the start of the digest of the source.
+struct CacheSlot {
+  std::atomic<uint64_t> key;
+  std::atomic<uint64_t> offset;
+};
+
+struct CacheRecord {
+  uint8_t digest[SHA256_SIZE];
+  uint64_t length;
+  uint32_t has_error;
+  uint32_t count;
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "the cache needs lock free 64 bit atomics");
+
+namespace {
+
+inline size_t table_size(uint64_t slot_count) {
+  return align(sizeof(CacheHeader) + slot_count * sizeof(CacheSlot));
+}
+
+inline uint64_t digest_key(const uint8_t *digest) {
+  uint64_t key;
+
+  std::memcpy(&key, digest, sizeof(key));
+
+  // Zero marks an empty slot.
+  return key ? key : 1;
+}
+
+} // namespace
+
+ParseCache::ParseCache(const std::string &path, uint64_t stamp,
+                       size_t capacity)
+    : hit_count(0), miss_count(0) {
+  for (int attempt = 0; attempt < OPEN_ATTEMPTS; attempt++) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+
+    if (fd < 0) {
+      return;
+    }
+
+    struct stat status, current;
+
+    if (flock(fd, LOCK_EX) != 0 || fstat(fd, &status) != 0 ||
+        ::stat(path.c_str(), &current) != 0) {
+      ::close(fd);
+      return;
+    }
+
+    // The file was replaced while this process waited for the lock.
+    if (status.st_dev != current.st_dev || status.st_ino != current.st_ino) {
+      ::close(fd);
+      continue;
+    }
+
+    if (!attach(fd, status.st_size, stamp)) {
+      create(path, stamp, capacity);
+    }
+
+    // The mapping keeps the open file and with it the lock alive, so it is
+    // released explicitly.
+    flock(fd, LOCK_UN);
+    ::close(fd);
+    return;
+  }
+}
+
+ParseCache::~ParseCache() {
+  if (data) {
+    munmap(data, capacity);
+  }
+}
+
+bool ParseCache::attach(int fd, size_t size, uint64_t stamp) {
+  if (size < sizeof(CacheHeader)) {
+    return false;
+  }
+
+  void *address =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  if (address == MAP_FAILED) {
+    return false;
+  }
+
+  const CacheHeader *mapped = static_cast<const CacheHeader *>(address);
+  uint64_t count = mapped->slot_count;
+
+  if (mapped->magic != CACHE_MAGIC || mapped->stamp != stamp || count == 0 ||
+      count > size / sizeof(CacheSlot) || table_size(count) >= size) {
+    munmap(address, size);
+    return false;
+  }
+
+  data = static_cast<char *>(address);
+  capacity = size;
+  slot_count = count;
+  records_start = table_size(count);
+  header = reinterpret_cast<CacheHeader *>(data);
+  slots = reinterpret_cast<CacheSlot *>(data + sizeof(CacheHeader));
+
+  return true;
+}
+
+bool ParseCache::create(const std::string &path, uint64_t stamp,
+                        size_t capacity) {
+  // One slot for every 4 KiB keeps the table sparse for typical records.
+  uint64_t count = capacity / 4096;
+
+  if (count == 0 || table_size(count) >= capacity) {
+    return false;
+  }
+
+  std::string temporary = path + "." + std::to_string(getpid());
+  int fd = ::open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+  if (fd < 0) {
+    return false;
+  }
+
+  void *address = MAP_FAILED;
+
+  if (ftruncate(fd, capacity) == 0) {
+    address =
+        mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+
+  ::close(fd);
+
+  if (address == MAP_FAILED) {
+    ::unlink(temporary.c_str());
+    return false;
+  }
+
+  data = static_cast<char *>(address);
+  this->capacity = capacity;
+  header = reinterpret_cast<CacheHeader *>(data);
+  slots = reinterpret_cast<CacheSlot *>(data + sizeof(CacheHeader));
+  initialize(stamp, count);
+
+  if (::rename(temporary.c_str(), path.c_str()) != 0) {
+    ::unlink(temporary.c_str());
+    munmap(data, capacity);
+    data = nullptr;
+    return false;
+  }
+
+  return true;
+}
+
+// Only called on a new file that no other process has seen yet.
+void ParseCache::initialize(uint64_t stamp, uint64_t slot_count) {
+  this->slot_count = slot_count;
+  records_start = table_size(slot_count);
+
+  header->magic = 0;
+  std::memset(data + sizeof(CacheHeader), 0,
+              records_start - sizeof(CacheHeader));
+  header->stamp = stamp;
+  header->slot_count = slot_count;
+  header->tail = records_start;
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = CACHE_MAGIC;
+}
+
+uint64_t ParseCache::hash(const char *source, size_t length, uint64_t seed) {
+  uint64_t value = FNV_OFFSET ^ seed;
+
+  for (size_t i = 0; i < length; i++) {
+    value = (value ^ static_cast<unsigned char>(source[i])) * FNV_PRIME;
+  }
+
+  // Zero marks an empty slot.
+  return value ? value : 1;
+}
+
+uint64_t ParseCache::stamp(const TSLanguage *language, uint64_t seed) {
+  uint64_t value = hash(reinterpret_cast<const char *>(&CACHE_MAGIC),
+                        sizeof(CACHE_MAGIC), seed);
+  uint32_t version = ts_language_version(language);
+  uint32_t count = ts_language_symbol_count(language);
+
+  value = hash(reinterpret_cast<const char *>(&version), sizeof(version),
+               value);
+
+  for (TSSymbol symbol = 0; symbol < count; symbol++) {
+    const char *name = ts_language_symbol_name(language, symbol);
+
+    if (name) {
+      value = hash(name, std::strlen(name) + 1, value);
+    }
+  }
+
+  return value;
+}
+
+const CacheRecord *ParseCache::record_at(uint64_t offset) const {
+  if (offset < records_start || offset % RECORD_ALIGNMENT != 0 ||
+      offset > capacity - sizeof(CacheRecord)) {
+    return nullptr;
+  }
+
+  const CacheRecord *record =
+      reinterpret_cast<const CacheRecord *>(data + offset);
+
+  // The count is read from a file that any process can write to.
+  if (record->count >
+      (capacity - offset - sizeof(CacheRecord)) / sizeof(IndexEntry)) {
+    return nullptr;
+  }
+
+  return record;
+}
+
+uint64_t ParseCache::append(const uint8_t *digest, size_t length,
+                            const std::vector<IndexEntry> &entries,
+                            bool has_error) {
+  size_t size =
+      align(sizeof(CacheRecord) + entries.size() * sizeof(IndexEntry));
+  uint64_t offset = header->tail.load();
+
+  // The tail only moves when the record fits, so that a smaller one can
+  // still be stored after a large one did not.
+  do {
+    if (offset < records_start || offset > capacity ||
+        size > capacity - offset) {
+      return 0;
+    }
+  } while (!header->tail.compare_exchange_weak(offset, offset + size));
+
+  CacheRecord *record = reinterpret_cast<CacheRecord *>(data + offset);
+
+  std::memcpy(record->digest, digest, SHA256_SIZE);
+  record->length = length;
+  record->has_error = has_error;
+  record->count = entries.size();
+
+  if (!entries.empty()) {
+    std::memcpy(record + 1, entries.data(),
+                entries.size() * sizeof(IndexEntry));
+  }
+
+  return offset;
+}
+
+bool ParseCache::lookup(const char *source, size_t length,
+                        std::vector<IndexEntry> &entries, bool &has_error) {
+  if (!data) {
+    return false;
+  }
+
+  uint8_t digest[SHA256_SIZE];
+
+  sha256(source, length, digest);
+
+  uint64_t key = digest_key(digest);
+
+  for (uint64_t i = 0; i < slot_count; i++) {
+    CacheSlot &slot = slots[(key + i) % slot_count];
+    uint64_t slot_key = slot.key.load(std::memory_order_acquire);
+
+    if (slot_key == 0) {
+      break;
+    }
+
+    if (slot_key != key) {
+      continue;
+    }
+
+    // An unpublished slot or a record with the same key for another source
+    // may come before the record for this one.
+    const CacheRecord *record =
+        record_at(slot.offset.load(std::memory_order_acquire));
+
+    if (!record || record->length != length ||
+        std::memcmp(record->digest, digest, SHA256_SIZE) != 0) {
+      continue;
+    }
+
+    const IndexEntry *first =
+        reinterpret_cast<const IndexEntry *>(record + 1);
+
+    entries.assign(first, first + record->count);
+    has_error = record->has_error != 0;
+    hit_count++;
+
+    return true;
+  }
+
+  miss_count++;
+
+  return false;
+}
+
+bool ParseCache::store(const char *source, size_t length,
+                       const std::vector<IndexEntry> &entries,
+                       bool has_error) {
+  if (!data) {
+    return false;
+  }
+
+  uint8_t digest[SHA256_SIZE];
+
+  sha256(source, length, digest);
+
+  uint64_t key = digest_key(digest);
+  uint64_t written = 0;
+
+  for (uint64_t i = 0; i < slot_count; i++) {
+    CacheSlot &slot = slots[(key + i) % slot_count];
+    uint64_t expected = 0;
+
+    if (!slot.key.compare_exchange_strong(expected, key,
+                                          std::memory_order_acq_rel) &&
+        expected != key) {
+      continue;
+    }
+
+    uint64_t offset = slot.offset.load(std::memory_order_acquire);
+
+    // The slot was just claimed, by this store or another one, or was left
+    // unpublished. Whichever record is published first takes it.
+    if (offset == 0) {
+      if (!written) {
+        written = append(digest, length, entries, has_error);
+      }
+
+      if (!written) {
+        return false;
+      }
+
+      if (slot.offset.compare_exchange_strong(offset, written,
+                                              std::memory_order_acq_rel)) {
+        return true;
+      }
+    }
+
+    // Another store published a record in the slot, which may be for a
+    // different source with the same key.
+    const CacheRecord *record = record_at(offset);
+
+    if (record && record->length == length &&
+        std::memcmp(record->digest, digest, SHA256_SIZE) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+TreeCache::~TreeCache() { clear(); }
+
+std::string TreeCache::key(const char *source, size_t length) {
+  uint8_t digest[SHA256_SIZE];
+
+  sha256(source, length, digest);
+  return std::string(reinterpret_cast<const char *>(digest), SHA256_SIZE);
+}
+
+TSTree *TreeCache::lookup(const char *source, size_t length) {
+  if (budget == 0) {
+    return nullptr;
+  }
+
+  // Hashing does not need the lock.
+  std::string digest = key(source, length);
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = table.find(digest);
+
+  if (it == table.end()) {
+    miss_count++;
+    return nullptr;
+  }
+
+  entries.splice(entries.begin(), entries, it->second);
+  hit_count++;
+
+  return ts_tree_copy(it->second->tree);
+}
+
+void TreeCache::store(const char *source, size_t length, const TSTree *tree) {
+  size_t bytes = length * BYTES_PER_SOURCE_BYTE;
+
+  if (budget == 0 || bytes > budget) {
+    return;
+  }
+
+  std::string digest = key(source, length);
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = table.find(digest);
+
+  if (it != table.end()) {
+    entries.splice(entries.begin(), entries, it->second);
+    return;
+  }
+
+  evict(bytes);
+  entries.push_front({digest, ts_tree_copy(tree), bytes});
+  table[digest] = entries.begin();
+  used += bytes;
+}
+
+void TreeCache::evict(size_t bytes) {
+  while (!entries.empty() && used + bytes > budget) {
+    Entry &entry = entries.back();
+
+    used -= entry.bytes;
+    table.erase(entry.key);
+    ts_tree_delete(entry.tree);
+    entries.pop_back();
+  }
+}
+
+void TreeCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (Entry &entry : entries) {
+    ts_tree_delete(entry.tree);
+  }
+
+  entries.clear();
+  table.clear();
+  used = 0;
+}
+
+size_t TreeCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.size();
+}
+
+size_t TreeCache::bytes() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return used;
+}
+
+} // namespace LaTeX
@@ -0,0 +1,157 @@
+#ifndef CACHE_HH_
+#define CACHE_HH_
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "index.hh"
+
+namespace LaTeX {
+
+struct CacheHeader;
+struct CacheRecord;
+struct CacheSlot;
+
+// A content addressed cache of index records and error status that lives in
+// a memory mapped file. Sources are keyed by their SHA-256 digest, which is
+// stored with each record and compared on a lookup. Records are only ever
+// appended so readers never see a record change. Each record is published by
+// a compare and swap on a slot in an open addressed table so that lookups do
+// not take a lock, including from other processes mapping the same file.
+//
+// The file is only set up under an exclusive flock and never truncated or
+// reset in place, since other processes may have it mapped. A file with
+// another stamp, e.g. after the grammar or the scanner changes, or one that
+// does not hold a valid table is replaced by a new file, which processes
+// that still map the old one see the next time they open the cache. An
+// existing file is used at its own size whatever capacity is asked for.
+class ParseCache {
+  char *data = nullptr;
+  size_t capacity = 0;
+  uint64_t slot_count = 0;
+  // The offset of the first record, just past the table.
+  size_t records_start = 0;
+  CacheHeader *header = nullptr;
+  CacheSlot *slots = nullptr;
+  std::atomic<uint64_t> hit_count, miss_count;
+
+  // Maps a cache file if it holds a table for stamp.
+  bool attach(int fd, size_t size, uint64_t stamp);
+
+  // Writes a new cache file, maps it and renames it to path.
+  bool create(const std::string &path, uint64_t stamp, size_t capacity);
+
+  void initialize(uint64_t stamp, uint64_t slot_count);
+
+  // The record at offset or nullptr if it does not fit in the file.
+  const CacheRecord *record_at(uint64_t offset) const;
+
+  // Appends a record and returns its offset or 0 if the file is full.
+  uint64_t append(const uint8_t *digest, size_t length,
+                  const std::vector<IndexEntry> &entries, bool has_error);
+
+public:
+  // Opens or creates the cache at path. capacity is the size of a new file
+  // in bytes and limits the number of records that can be stored. The
+  // default holds around a hundred thousand typical files.
+  ParseCache(const std::string &path, uint64_t stamp,
+             size_t capacity = size_t(1) << 28);
+
+  ~ParseCache();
+
+  ParseCache(const ParseCache &) = delete;
+
+  ParseCache &operator=(const ParseCache &) = delete;
+
+  bool valid() const { return data != nullptr; }
+
+  // A stamp for a language from its ABI version and symbol names. Changes to
+  // the scanner that do not change the symbols have to be mixed in by the
+  // caller.
+  static uint64_t stamp(const TSLanguage *language, uint64_t seed = 0);
+
+  // A fast 64 bit FNV-1a hash, which is not collision resistant.
+  static uint64_t hash(const char *source, size_t length, uint64_t seed = 0);
+
+  // Looks up the records for source. Returns false on a miss.
+  bool lookup(const char *source, size_t length,
+              std::vector<IndexEntry> &entries, bool &has_error);
+
+  // Stores the records for source. Returns false if the cache is full.
+  // Storing a source that is already present does nothing. A slot that was
+  // claimed but never published, e.g. by a process that died or found the
+  // file full, is taken over.
+  bool store(const char *source, size_t length,
+             const std::vector<IndexEntry> &entries, bool has_error);
+
+  uint64_t hits() const { return hit_count; }
+
+  uint64_t misses() const { return miss_count; }
+};
+
+// An in-memory LRU cache of syntax trees keyed by the SHA-256 digest of
+// their source that can be shared by any number of sessions and threads.
+// Trees are handed out and taken in with ts_tree_copy, which only bumps a
+// reference count, so callers own what they get and a tree stays valid after
+// it is evicted. The budget is counted in an estimate of the bytes each tree
+// holds from the length of its source, the sources themselves are not kept.
+class TreeCache {
+  struct Entry {
+    std::string key;
+    TSTree *tree;
+    size_t bytes;
+  };
+
+  // Most recently used first.
+  std::list<Entry> entries;
+  std::unordered_map<std::string, std::list<Entry>::iterator> table;
+  size_t budget, used = 0;
+  mutable std::mutex mutex;
+  std::atomic<uint64_t> hit_count, miss_count;
+
+  static std::string key(const char *source, size_t length);
+
+  void evict(size_t bytes);
+
+public:
+  // The estimated size of a tree for each byte of its source. memory-report
+  // reports the measured tree bytes per input byte to calibrate it against.
+  static const size_t BYTES_PER_SOURCE_BYTE = 16;
+
+  // A cache with a budget of zero stores nothing and counts no misses.
+  TreeCache(size_t budget) : budget(budget), hit_count(0), miss_count(0) {}
+
+  ~TreeCache();
+
+  TreeCache(const TreeCache &) = delete;
+
+  TreeCache &operator=(const TreeCache &) = delete;
+
+  // Returns a copy of the tree for source that the caller has to delete or
+  // nullptr on a miss.
+  TSTree *lookup(const char *source, size_t length);
+
+  // Stores a copy of the tree for source unless its estimated size is larger
+  // than the whole budget. Evicts the least recently used trees to make room
+  // for it.
+  void store(const char *source, size_t length, const TSTree *tree);
+
+  void clear();
+
+  size_t size() const;
+
+  size_t bytes() const;
+
+  uint64_t hits() const { return hit_count; }
+
+  uint64_t misses() const { return miss_count; }
+};
+
+} // namespace LaTeX
+
+#endif
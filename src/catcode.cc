@@ -1,109 +1,366 @@
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
 
 #include "catcode.hh"
 
 namespace LaTeX {
 
-using std::map;
 using std::pair;
-using std::vector;
 
-// Category& CatCodeTable::operator[](const char32_t key) {
-//   return codes[key][level];
-// }
+namespace {
 
-void CatCodeTable::assign(const char32_t key, Category code, bool global) {
-  codes[key][(global) ? 1 : level] = code;
+const unsigned CHUNK_BITS = 8;
+const unsigned CHUNK_SIZE = 1 << CHUNK_BITS;
+const unsigned CHUNK_COUNT =
+    (PRIVATE_REGIME_BASE + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+// Regimes are never freed so the ids stored in the serialized scanner state
+// stay valid for the life of the process. Lookups by id are lock free, only
+// interning a new regime takes the lock.
+class RegimeRegistry {
+  std::atomic<CatCodeRegime *> chunks[CHUNK_COUNT];
+  std::mutex mutex;
+  std::unordered_map<std::string, RegimeId> ids;
+  std::atomic<unsigned> count;
+
+public:
+  RegimeRegistry() : count(0) {
+    for (auto &chunk : chunks) {
+      chunk.store(nullptr, std::memory_order_relaxed);
+    }
+
+    CatCodeRegime regime;
+    std::fill(regime.codes, regime.codes + REGIME_SIZE, OTHER_CATEGORY);
+
+    for (const CatCodeInterval &interval : {
+             CatCodeInterval{' ', ' ', SPACE_CATEGORY},
+             CatCodeInterval{'_', '_', SUBSCRIPT_CATEGORY},
+             CatCodeInterval{'{', '{', BEGIN_CATEGORY},
+             CatCodeInterval{'}', '}', END_CATEGORY},
+             CatCodeInterval{'\\', '\\', ESCAPE_CATEGORY},
+             // NUL is technically ignored, but tree sitter seems to use it to
+             // indicate EOF.
+             // {'\0',   '\0',   IGNORED_CATEGORY},
+             // SOH is subscript in plain.tex but not in latex.ltx
+             // {'\1', '\1', SUBSCRIPT_CATEGORY},
+             // FF is active character for \par in latex.ltx
+             CatCodeInterval{'\f', '\f', ACTIVE_CHAR_CATEGORY},
+             CatCodeInterval{'\n', '\n', EOL_CATEGORY},
+             CatCodeInterval{'\t', '\t', SPACE_CATEGORY},
+             // VT superscript in plain.tex but not in latex.ltx
+             // {'\v', '\v', SUPERSCRIPT_CATEGORY},
+             CatCodeInterval{'\x7f', '\x7f', INVALID_CATEGORY},
+             CatCodeInterval{'&', '&', ALIGNMENT_TAB_CATEGORY},
+             CatCodeInterval{'#', '#', PARAMETER_CATEGORY},
+             CatCodeInterval{'%', '%', COMMENT_CATEGORY},
+             CatCodeInterval{'^', '^', SUPERSCRIPT_CATEGORY},
+             CatCodeInterval{'~', '~', ACTIVE_CHAR_CATEGORY},
+             CatCodeInterval{'$', '$', MATH_SHIFT_CATEGORY},
+             CatCodeInterval{'a', 'z', LETTER_CATEGORY},
+             CatCodeInterval{'A', 'Z', LETTER_CATEGORY},
+         }) {
+      std::fill(regime.codes + interval.begin, regime.codes + interval.end + 1,
+                interval.category);
+    }
+
+    intern(regime);
+  }
+
+  // Whether id has been interned, e.g. when it is read back from a state.
+  bool contains(RegimeId id) const {
+    return id < count.load(std::memory_order_acquire);
+  }
+
+  const CatCodeRegime *get(RegimeId id) const {
+    return chunks[id >> CHUNK_BITS].load(std::memory_order_acquire) +
+           (id & (CHUNK_SIZE - 1));
+  }
+
+  RegimeId intern(const CatCodeRegime &regime) {
+    std::string key(reinterpret_cast<const char *>(regime.codes), REGIME_SIZE);
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = ids.find(key);
+    if (it != ids.end()) {
+      return it->second;
+    }
+
+    unsigned id = count.load(std::memory_order_relaxed);
+
+    if (id >= PRIVATE_REGIME_BASE) {
+      return NO_REGIME;
+    }
+
+    CatCodeRegime *chunk =
+        chunks[id >> CHUNK_BITS].load(std::memory_order_relaxed);
+    if (!chunk) {
+      chunk = new CatCodeRegime[CHUNK_SIZE];
+      chunks[id >> CHUNK_BITS].store(chunk, std::memory_order_release);
+    }
+
+    chunk[id & (CHUNK_SIZE - 1)] = regime;
+    ids.emplace(key, id);
+    count.store(id + 1, std::memory_order_release);
+
+    return id;
+  }
+};
+
+RegimeRegistry &registry() {
+  static RegimeRegistry instance;
+  return instance;
 }
 
-void CatCodeTable::erase(const char32_t key, bool global) {
-  codes[key].erase((global) ? 1 : level);
+} // namespace
+
+CatCodeTable::CatCodeTable()
+    : levels(1, DEFAULT_REGIME), current(registry().get(DEFAULT_REGIME)) {}
+
+RegimeId
+CatCodeTable::compile(std::initializer_list<CatCodeInterval> intervals) {
+  CatCodeRegime delta;
+  std::fill(delta.codes, delta.codes + REGIME_SIZE, CATEGORY_COUNT);
+
+  for (const CatCodeInterval &interval : intervals) {
+    for (char32_t ch = interval.begin; ch <= interval.end && ch < REGIME_SIZE;
+         ch++) {
+      delta.codes[ch] = interval.category;
+    }
+  }
+
+  return registry().intern(delta);
 }
 
-Category CatCodeTable::operator[](const char32_t key) const {
-  auto it = codes.find(key);
+RegimeId CatCodeTable::compile(const char32_t key, Category code) {
+  return compile({{key, key, code}});
+}
 
-  // OTHER is the default category.
-  return (it == codes.cend() || it->second.empty())
-             ? OTHER_CATEGORY
-             : it->second.crbegin()->second;
+const CatCodeRegime *CatCodeTable::regime(RegimeId id) const {
+  return (id < PRIVATE_REGIME_BASE)
+             ? registry().get(id)
+             : private_regimes[id - PRIVATE_REGIME_BASE].get();
 }
 
-void CatCodeTable::reset() {
-  level = 1;
-
-  for (auto it = codes.begin(), it_end = codes.end(); it != it_end;) {
-    for (auto lit = it->second.begin(), lit_end = it->second.end();
-         lit != lit_end;) {
-      if (lit->first != 0) {
-        lit = it->second.erase(lit);
-      } else {
-        lit++;
-      }
+RegimeId CatCodeTable::make_private(const CatCodeRegime &codes) {
+  std::vector<bool> used(private_regimes.size());
+
+  for (RegimeId id : levels) {
+    if (id >= PRIVATE_REGIME_BASE) {
+      used[id - PRIVATE_REGIME_BASE] = true;
     }
+  }
 
-    if (it->second.empty()) {
-      it = codes.erase(it);
-    } else {
-      it++;
+  size_t slot = std::find(used.begin(), used.end(), false) - used.begin();
+
+  if (slot == private_regimes.size()) {
+    if (PRIVATE_REGIME_BASE + slot >= NO_REGIME) {
+      return NO_REGIME;
     }
+
+    private_regimes.emplace_back();
   }
+
+  private_regimes[slot] = std::make_shared<const CatCodeRegime>(codes);
+
+  return static_cast<RegimeId>(PRIVATE_REGIME_BASE + slot);
 }
 
-void CatCodeTable::assign(const vector<CatCodeInterval> &intervals,
-                          bool global) {
-  uint8_t _level = (global) ? 1 : level;
+RegimeId CatCodeTable::transition(RegimeId id, const CatCodeRegime &delta,
+                                  RegimeId delta_id) {
+  bool shared = id < PRIVATE_REGIME_BASE && delta_id != NO_REGIME;
+  uint32_t key = (static_cast<uint32_t>(id) << 16) | delta_id;
 
-  for (const CatCodeInterval &interval : intervals) {
-    for (char32_t ch = interval.begin; ch <= interval.end; ch++) {
-      codes[ch][_level] = interval.category;
+  if (shared) {
+    auto it = transitions.find(key);
+    if (it != transitions.end()) {
+      return it->second;
+    }
+  }
+
+  const CatCodeRegime *base = regime(id);
+  CatCodeRegime result;
+
+  for (char32_t ch = 0; ch < REGIME_SIZE; ch++) {
+    result.codes[ch] = (delta.codes[ch] == CATEGORY_COUNT)
+                           ? base->codes[ch]
+                           : delta.codes[ch];
+  }
+
+  RegimeId next = registry().intern(result);
+
+  if (next == NO_REGIME) {
+    next = make_private(result);
+
+    // Only a table nested thousands of levels deep with a different regime
+    // on each runs out of private regimes, and then the change is dropped.
+    return (next == NO_REGIME) ? id : next;
+  }
+
+  if (shared) {
+    transitions.emplace(key, next);
+  }
+
+  return next;
+}
+
+void CatCodeTable::apply(const CatCodeRegime &delta, RegimeId delta_id,
+                         bool global) {
+  if (global) {
+    for (RegimeId &id : levels) {
+      id = transition(id, delta, delta_id);
     }
+  } else {
+    levels.back() = transition(levels.back(), delta, delta_id);
   }
+
+  current = regime(levels.back());
 }
 
-void CatCodeTable::push() { level++; }
+void CatCodeTable::apply(RegimeId delta, bool global) {
+  if (delta != NO_REGIME) {
+    apply(*registry().get(delta), delta, global);
+  }
+}
 
-void CatCodeTable::pop() {
-  if (level > 1) {
-    for (auto it = codes.begin(); it != codes.end();) {
-      it->second.erase(level);
-      if (it->second.empty()) {
-        it = codes.erase(it);
-      } else {
-        it++;
+void CatCodeTable::change(const char32_t key, Category code, bool global) {
+  RegimeId delta_id = compile(key, code);
+
+  if (delta_id != NO_REGIME) {
+    apply(delta_id, global);
+    return;
+  }
+
+  // The registry is full, so the delta is not interned either.
+  CatCodeRegime delta;
+  std::fill(delta.codes, delta.codes + REGIME_SIZE, CATEGORY_COUNT);
+  delta.codes[key] = code;
+  apply(delta, NO_REGIME, global);
+}
+
+void CatCodeTable::assign(const char32_t key, Category code, bool global) {
+  if (key < REGIME_SIZE) {
+    change(key, code, global);
+  } else {
+    wide_codes[key] = code;
+  }
+}
+
+void CatCodeTable::erase(const char32_t key, bool global) {
+  if (key >= REGIME_SIZE) {
+    wide_codes.erase(key);
+  } else if (!global) {
+    // Restore the category from the enclosing scope.
+    RegimeId outer = (levels.size() < 2) ? DEFAULT_REGIME : levels.rbegin()[1];
+    change(key, regime(outer)->codes[key], false);
+  } else {
+    // Only the global assignment is removed. The scopes that inherited it
+    // follow, but a local assignment and the scopes inside it are kept.
+    Category inherited = regime(levels.front())->codes[key];
+    CatCodeRegime delta;
+
+    std::fill(delta.codes, delta.codes + REGIME_SIZE, CATEGORY_COUNT);
+    delta.codes[key] = registry().get(DEFAULT_REGIME)->codes[key];
+
+    RegimeId delta_id = registry().intern(delta);
+
+    for (RegimeId &id : levels) {
+      if (regime(id)->codes[key] != inherited) {
+        break;
       }
+
+      id = transition(id, delta, delta_id);
     }
 
-    level--;
+    current = regime(levels.back());
+  }
+}
+
+Category CatCodeTable::wide_category(const char32_t key) const {
+  auto it = wide_codes.find(key);
+
+  // OTHER is the default category.
+  return (it == wide_codes.cend()) ? OTHER_CATEGORY : it->second;
+}
+
+void CatCodeTable::reset() {
+  levels.assign(1, DEFAULT_REGIME);
+  current = registry().get(DEFAULT_REGIME);
+  wide_codes.clear();
+  private_regimes.clear();
+}
+
+void CatCodeTable::push() { levels.push_back(levels.back()); }
+
+void CatCodeTable::pop() {
+  if (levels.size() > 1) {
+    levels.pop_back();
+    current = regime(levels.back());
   }
 }
 
 SerializationBuffer &operator<<(SerializationBuffer &buffer,
                                 const CatCodeTable &table) {
-  // Count the characters that have non-zero level.
-  unsigned ch_count =
-      count_if(table.codes.cbegin(), table.codes.cend(),
-               [](const pair<char32_t, map<uint8_t, Category>> &p) {
-                 return any_of(p.second.cbegin(), p.second.cend(),
-                               [](const pair<uint8_t, Category> &p2) {
-                                 return p2.first;
-                               });
-               });
-
-  buffer << table.level << ch_count;
-
-  for (auto it = table.codes.cbegin(); it != table.codes.cend(); it++) {
-    uint8_t level_count =
-        count_if(it->second.cbegin(), it->second.cend(),
-                 [](const pair<uint8_t, Category> &p) { return p.first; });
-
-    if (level_count > 0) {
-      buffer << it->first << level_count;
-
-      for (auto lit = it->second.cbegin(); lit != it->second.cend(); lit++) {
-        if (lit->first != 0) {
-          buffer << lit->first << lit->second;
-        }
+  // The levels are run length encoded since nested groups rarely change the
+  // regime.
+  uint16_t run_count = 0, run_length = 0;
+
+  for (size_t i = 0; i < table.levels.size(); i++) {
+    if (i == 0 || table.levels[i] != table.levels[i - 1] ||
+        run_length == UINT16_MAX) {
+      run_count++;
+      run_length = 0;
+    }
+    run_length++;
+  }
+
+  buffer << run_count;
+
+  for (size_t i = 0; i < table.levels.size(); i += run_length) {
+    run_length = 1;
+    while (i + run_length < table.levels.size() &&
+           table.levels[i + run_length] == table.levels[i] &&
+           run_length < UINT16_MAX) {
+      run_length++;
+    }
+
+    buffer << table.levels[i] << run_length;
+  }
+
+  buffer << static_cast<unsigned>(table.wide_codes.size());
+
+  for (const pair<const char32_t, Category> &p : table.wide_codes) {
+    buffer << p.first << p.second;
+  }
+
+  // Private regimes are written as the characters that differ from the
+  // default regime, which are few.
+  const CatCodeRegime *initial = registry().get(DEFAULT_REGIME);
+  std::vector<RegimeId> used;
+
+  for (RegimeId id : table.levels) {
+    if (id >= PRIVATE_REGIME_BASE &&
+        std::find(used.begin(), used.end(), id) == used.end()) {
+      used.push_back(id);
+    }
+  }
+
+  buffer << static_cast<uint16_t>(used.size());
+
+  for (RegimeId id : used) {
+    const CatCodeRegime *regime = table.regime(id);
+    uint16_t count = 0;
+
+    for (char32_t ch = 0; ch < REGIME_SIZE; ch++) {
+      count += regime->codes[ch] != initial->codes[ch];
+    }
+
+    buffer << id << count;
+
+    for (char32_t ch = 0; ch < REGIME_SIZE; ch++) {
+      if (regime->codes[ch] != initial->codes[ch]) {
+        buffer << static_cast<uint8_t>(ch) << regime->codes[ch];
       }
     }
   }
@@ -116,20 +373,82 @@ DeserializationBuffer &operator>>(DeserializationBuffer &buffer,
   table.reset();
 
   if (buffer.length != 0) {
-    char32_t ch;
+    uint16_t run_count, run_length;
+    RegimeId id;
     unsigned ch_count;
-    uint8_t level, level_count;
+    char32_t ch;
     Category cat;
 
-    buffer >> table.level >> ch_count;
+    buffer >> run_count;
+
+    // There is always a global scope, so a state without one is not ours.
+    if (run_count == 0) {
+      return buffer;
+    }
+
+    uint16_t private_count, count;
+    uint8_t code;
+
+    table.levels.clear();
+
+    for (; run_count > 0; run_count--) {
+      buffer >> id >> run_length;
+      table.levels.insert(table.levels.end(), run_length, id);
+    }
+
+    buffer >> ch_count;
 
     for (; ch_count > 0; ch_count--) {
-      buffer >> ch >> level_count;
-      for (; level_count > 0; level_count--) {
-        buffer >> level >> cat;
-        table.codes[ch][level] = cat;
+      buffer >> ch >> cat;
+      table.wide_codes[ch] = cat;
+    }
+
+    buffer >> private_count;
+
+    for (; private_count > 0; private_count--) {
+      CatCodeRegime regime = *registry().get(DEFAULT_REGIME);
+
+      buffer >> id >> count;
+
+      for (; count > 0; count--) {
+        buffer >> code >> cat;
+        regime.codes[code] = (cat < CATEGORY_COUNT) ? cat : OTHER_CATEGORY;
       }
+
+      if (id >= PRIVATE_REGIME_BASE && id != NO_REGIME) {
+        size_t slot = id - PRIVATE_REGIME_BASE;
+
+        if (table.private_regimes.size() <= slot) {
+          table.private_regimes.resize(slot + 1);
+        }
+
+        table.private_regimes[slot] =
+            std::make_shared<const CatCodeRegime>(regime);
+      }
+    }
+
+    // A state with an id that is neither interned nor private to it is not
+    // ours, e.g. one from another process, and is not used.
+    for (RegimeId level : table.levels) {
+      size_t slot = level - PRIVATE_REGIME_BASE;
+      bool valid = (level < PRIVATE_REGIME_BASE)
+                       ? registry().contains(level)
+                       : level != NO_REGIME &&
+                             slot < table.private_regimes.size() &&
+                             table.private_regimes[slot];
+
+      if (!valid) {
+        table.reset();
+        return buffer;
+      }
+    }
+
+    if (table.levels.empty()) {
+      table.reset();
+      return buffer;
     }
+
+    table.current = table.regime(table.levels.back());
   }
 
   return buffer;
@@ -3,6 +3,7 @@
 
 #include <bitset>
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -59,31 +60,78 @@ struct CatCodeInterval {
   Category category;
 };
 
+// A regime is a complete catcode assignment for the characters below
+// REGIME_SIZE. Regimes are interned in a process wide registry so that the
+// same table always has the same id. When a regime is used as a delta then
+// entries equal to CATEGORY_COUNT leave the existing category unchanged.
+//
+// The registry holds the ids below PRIVATE_REGIME_BASE. Once it is full, a
+// table keeps the regimes it needs in addition as private regimes, whose
+// ids from PRIVATE_REGIME_BASE up only mean something to that table.
+typedef uint16_t RegimeId;
+
+const char32_t REGIME_SIZE = 256;
+const RegimeId DEFAULT_REGIME = 0;
+const RegimeId PRIVATE_REGIME_BASE = 0xf000;
+const RegimeId NO_REGIME = 0xffff;
+
+struct CatCodeRegime {
+  Category codes[REGIME_SIZE];
+};
+
 class CatCodeTable {
 protected:
-  uint8_t level; // 0 is the default catcode table, 1 is the global scope, 2-255
-                 // are the group scopes.
-  std::unordered_map<char32_t, std::map<uint8_t, Category>> codes;
+  // The regime in effect for each scope level. The first entry is the global
+  // scope, the rest are the group scopes.
+  std::vector<RegimeId> levels;
+  const CatCodeRegime *current;
+  // Characters outside of the regimes only support global assignments.
+  std::map<char32_t, Category> wide_codes;
+  // Memoized regime transitions keyed by the current regime and the delta.
+  // Only transitions between regimes of the registry are memoized.
+  std::unordered_map<uint32_t, RegimeId> transitions;
+  // Indexed by the id less PRIVATE_REGIME_BASE. Regimes are shared between
+  // copies of the table and a slot is reused once no level refers to it.
+  std::vector<std::shared_ptr<const CatCodeRegime>> private_regimes;
+
+  const CatCodeRegime *regime(RegimeId id) const;
+
+  // The id of a private regime that holds the codes or NO_REGIME if there
+  // is no free slot.
+  RegimeId make_private(const CatCodeRegime &codes);
+
+  // The regime id changed by delta, whose id is delta_id or NO_REGIME if it
+  // is not interned.
+  RegimeId transition(RegimeId id, const CatCodeRegime &delta,
+                      RegimeId delta_id);
+
+  void apply(const CatCodeRegime &delta, RegimeId delta_id, bool global);
+
+  // Assigns a category to a character below REGIME_SIZE.
+  void change(const char32_t key, Category code, bool global);
+
+  Category wide_category(const char32_t key) const;
 
 public:
-  CatCodeTable(std::initializer_list<CatCodeInterval> init) {
-    level = 0;
-    assign(init);
-    level = 1;
-  }
+  CatCodeTable();
+
+  // Intern a delta built from the intervals. Used to precompile the catcode
+  // changes of control sequences, environments and names at startup.
+  static RegimeId compile(std::initializer_list<CatCodeInterval> intervals);
+
+  static RegimeId compile(const char32_t key, Category code);
 
   void reset();
 
-  void assign(const char32_t key, Category code, bool global = false);
+  void apply(RegimeId delta, bool global = false);
 
-  void assign(const std::vector<CatCodeInterval> &intervals,
-              bool global = false);
+  void assign(const char32_t key, Category code, bool global = false);
 
   void erase(const char32_t key, bool global = false);
 
-  // Category& operator[](const char32_t key);
-
-  Category operator[](const char32_t key) const;
+  inline Category operator[](const char32_t key) const {
+    return (key < REGIME_SIZE) ? current->codes[key] : wide_category(key);
+  }
 
   void push();
 
@@ -0,0 +1,199 @@
+#include <cstring>
+
+#include "catcode_bitmap.hh"
+
+#if (defined(__GNUC__) || defined(__clang__)) &&                             \
+    (defined(__x86_64__) || defined(__i386__))
+#define LATEX_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace LaTeX {
+
+namespace {
+
+const Category BITMAP_CATEGORIES[6] = {
+    ESCAPE_CATEGORY,  BEGIN_CATEGORY, END_CATEGORY,
+    COMMENT_CATEGORY, EOL_CATEGORY,   MATH_SHIFT_CATEGORY};
+
+uint64_t CatCodeBitmaps::*const BITMAP_FIELDS[6] = {
+    &CatCodeBitmaps::escape,  &CatCodeBitmaps::begin, &CatCodeBitmaps::end,
+    &CatCodeBitmaps::comment, &CatCodeBitmaps::eol,
+    &CatCodeBitmaps::math_shift};
+
+} // namespace
+
+struct Kernels {
+  // Compares eight bytes at a time within a 64 bit word. The comparison is
+  // exact, i.e. without the false positives of the usual zero byte test.
+  static void scalar(const CatCodeClassifier &classifier, const char *block,
+                     CatCodeBitmaps &bitmaps) {
+    const uint64_t LOW = 0x7f7f7f7f7f7f7f7full;
+    uint64_t words[8];
+
+    std::memcpy(words, block, sizeof(words));
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (uint64_t &word : words) {
+      word = __builtin_bswap64(word);
+    }
+#endif
+
+    for (int i = 0; i < 6; i++) {
+      uint64_t bits = 0;
+
+      for (char ch : classifier.characters[i]) {
+        uint64_t pattern = 0x0101010101010101ull * static_cast<uint8_t>(ch);
+
+        for (int j = 0; j < 8; j++) {
+          uint64_t difference = words[j] ^ pattern;
+          uint64_t zero = ~(((difference & LOW) + LOW) | difference | LOW);
+          // Gathers the high bit of each byte into the top byte.
+          bits |= ((zero >> 7) * 0x0102040810204080ull >> 56) << (8 * j);
+        }
+      }
+
+      bitmaps.*BITMAP_FIELDS[i] = bits;
+    }
+  }
+
+#ifdef LATEX_X86_KERNELS
+  __attribute__((target("sse2"))) static void
+  sse2(const CatCodeClassifier &classifier, const char *block,
+       CatCodeBitmaps &bitmaps) {
+    __m128i chunks[4];
+
+    for (int j = 0; j < 4; j++) {
+      chunks[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block) + j);
+    }
+
+    for (int i = 0; i < 6; i++) {
+      uint64_t bits = 0;
+
+      for (char ch : classifier.characters[i]) {
+        __m128i pattern = _mm_set1_epi8(ch);
+
+        for (int j = 0; j < 4; j++) {
+          uint32_t mask = static_cast<uint32_t>(
+              _mm_movemask_epi8(_mm_cmpeq_epi8(chunks[j], pattern)));
+          bits |= static_cast<uint64_t>(mask) << (16 * j);
+        }
+      }
+
+      bitmaps.*BITMAP_FIELDS[i] = bits;
+    }
+  }
+
+  __attribute__((target("avx2"))) static void
+  avx2(const CatCodeClassifier &classifier, const char *block,
+       CatCodeBitmaps &bitmaps) {
+    __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+    __m256i high =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block) + 1);
+
+    for (int i = 0; i < 6; i++) {
+      uint64_t bits = 0;
+
+      for (char ch : classifier.characters[i]) {
+        __m256i pattern = _mm256_set1_epi8(ch);
+        uint32_t low_mask = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(low, pattern)));
+        uint32_t high_mask = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(high, pattern)));
+        bits |= static_cast<uint64_t>(high_mask) << 32 | low_mask;
+      }
+
+      bitmaps.*BITMAP_FIELDS[i] = bits;
+    }
+  }
+#endif
+};
+
+CatCodeClassifier::CatCodeClassifier(const CatCodeTable &table,
+                                     CatCodeKernel id) {
+  for (char32_t ch = 0; ch < 0x80; ch++) {
+    for (int i = 0; i < 6; i++) {
+      if (table[ch] == BITMAP_CATEGORIES[i]) {
+        characters[i].push_back(static_cast<char>(ch));
+      }
+    }
+  }
+
+  if (id == AUTO_KERNEL) {
+    id = supported(AVX2_KERNEL)   ? AVX2_KERNEL
+         : supported(SSE2_KERNEL) ? SSE2_KERNEL
+                                  : SCALAR_KERNEL;
+  } else if (!supported(id)) {
+    id = SCALAR_KERNEL;
+  }
+
+  kernel_id = id;
+
+  switch (id) {
+#ifdef LATEX_X86_KERNELS
+  case AVX2_KERNEL:
+    kernel = Kernels::avx2;
+    break;
+  case SSE2_KERNEL:
+    kernel = Kernels::sse2;
+    break;
+#endif
+  default:
+    kernel = Kernels::scalar;
+    break;
+  }
+}
+
+bool CatCodeClassifier::supported(CatCodeKernel id) {
+  switch (id) {
+  case AUTO_KERNEL:
+  case SCALAR_KERNEL:
+    return true;
+#ifdef LATEX_X86_KERNELS
+  case SSE2_KERNEL:
+    return __builtin_cpu_supports("sse2");
+  case AVX2_KERNEL:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+void CatCodeClassifier::classify(const char *block, size_t length,
+                                 CatCodeBitmaps &bitmaps) const {
+  if (length >= BITMAP_BLOCK_SIZE) {
+    kernel(*this, block, bitmaps);
+    return;
+  }
+
+  // NUL is not in any of the categories unless a regime makes it so, in
+  // which case the padding is masked off.
+  char padded[BITMAP_BLOCK_SIZE] = {0};
+  uint64_t mask = (static_cast<uint64_t>(1) << length) - 1;
+
+  std::memcpy(padded, block, length);
+  kernel(*this, padded, bitmaps);
+
+  for (int i = 0; i < 6; i++) {
+    bitmaps.*BITMAP_FIELDS[i] &= mask;
+  }
+}
+
+void CatCodeClassifier::classify(const char *data, size_t length,
+                                 std::vector<CatCodeBitmaps> &bitmaps) const {
+  size_t count = (length + BITMAP_BLOCK_SIZE - 1) / BITMAP_BLOCK_SIZE;
+
+  bitmaps.resize(count);
+
+  for (size_t i = 0; i + 1 < count; i++) {
+    kernel(*this, data + i * BITMAP_BLOCK_SIZE, bitmaps[i]);
+  }
+
+  if (count > 0) {
+    classify(data + (count - 1) * BITMAP_BLOCK_SIZE,
+             length - (count - 1) * BITMAP_BLOCK_SIZE, bitmaps[count - 1]);
+  }
+}
+
+} // namespace LaTeX
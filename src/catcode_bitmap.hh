@@ -0,0 +1,66 @@
+#ifndef CATCODE_BITMAP_HH_
+#define CATCODE_BITMAP_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "catcode.hh"
+
+namespace LaTeX {
+
+const size_t BITMAP_BLOCK_SIZE = 64;
+
+// The bytes of a block of BITMAP_BLOCK_SIZE bytes that have one of the
+// categories the structure of a document depends on. Bit i is set if byte i
+// of the block has the category.
+struct CatCodeBitmaps {
+  uint64_t escape, begin, end, comment, eol, math_shift;
+};
+
+enum CatCodeKernel { AUTO_KERNEL, SCALAR_KERNEL, SSE2_KERNEL, AVX2_KERNEL };
+
+// Classifies blocks of bytes with the categories a catcode table gives the
+// characters below 0x80. Bytes of 0x80 and above are in none of the
+// categories. The vector kernels compare 16 or 32 bytes at a time against
+// each character of a category and are picked at run time from what the CPU
+// supports.
+class CatCodeClassifier {
+  typedef void (*Kernel)(const CatCodeClassifier &classifier,
+                         const char *block, CatCodeBitmaps &bitmaps);
+
+  // The characters of each category in the order of CatCodeBitmaps.
+  std::string characters[6];
+  Kernel kernel;
+  CatCodeKernel kernel_id;
+
+  friend struct Kernels;
+
+public:
+  // Uses the categories of the current level of table, by default those of
+  // the default regime.
+  explicit CatCodeClassifier(const CatCodeTable &table = CatCodeTable(),
+                             CatCodeKernel id = AUTO_KERNEL);
+
+  static bool supported(CatCodeKernel id);
+
+  CatCodeKernel kernel_used() const { return kernel_id; }
+
+  // Classifies BITMAP_BLOCK_SIZE bytes.
+  void classify(const char *block, CatCodeBitmaps &bitmaps) const {
+    kernel(*this, block, bitmaps);
+  }
+
+  // Classifies a block that may be shorter than BITMAP_BLOCK_SIZE bytes.
+  void classify(const char *block, size_t length,
+                CatCodeBitmaps &bitmaps) const;
+
+  // Classifies a whole buffer, one entry per block.
+  void classify(const char *data, size_t length,
+                std::vector<CatCodeBitmaps> &bitmaps) const;
+};
+
+} // namespace LaTeX
+
+#endif
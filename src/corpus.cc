@@ -0,0 +1,89 @@
+#include <fstream>
+#include <utility>
+
+#include "corpus.hh"
+
+namespace LaTeX {
+
+namespace {
+
+// A line of at least three = or - characters, which starts the name or the
+// expected output of a case.
+bool is_rule(const std::string &line, char ch) {
+  return line.length() >= 3 &&
+         line.find_first_not_of(ch) == std::string::npos;
+}
+
+void trim_newlines(std::string &text) {
+  while (!text.empty() && text.back() == '\n') {
+    text.pop_back();
+  }
+}
+
+} // namespace
+
+bool read_corpus_cases(const std::string &path,
+                       std::vector<CorpusCase> &cases) {
+  std::ifstream file(path, std::ios::binary);
+  std::string line;
+  CorpusCase current;
+  enum { OUTSIDE, NAME, INPUT, EXPECTED } state = OUTSIDE;
+
+  if (!file) {
+    return false;
+  }
+
+  while (std::getline(file, line)) {
+    if (state == INPUT && is_rule(line, '-')) {
+      // The newline before the rule is not part of the input.
+      if (!current.input.empty()) {
+        current.input.pop_back();
+      }
+
+      state = EXPECTED;
+    } else if (state == INPUT) {
+      current.input += line;
+      current.input += '\n';
+    } else if (is_rule(line, '=')) {
+      if (state == EXPECTED) {
+        trim_newlines(current.expected);
+        cases.push_back(current);
+      }
+
+      state = (state == NAME) ? INPUT : NAME;
+
+      if (state == NAME) {
+        current = CorpusCase();
+      }
+    } else if (state == NAME) {
+      current.name = line;
+    } else if (state == EXPECTED) {
+      current.expected += line;
+      current.expected += '\n';
+    }
+  }
+
+  if (state == EXPECTED) {
+    trim_newlines(current.expected);
+    cases.push_back(current);
+  }
+
+  return true;
+}
+
+bool read_corpus_cases(const std::string &path,
+                       std::vector<std::string> &cases) {
+  std::vector<CorpusCase> corpus_cases;
+
+  if (!read_corpus_cases(path, corpus_cases)) {
+    return false;
+  }
+
+  for (CorpusCase &corpus_case : corpus_cases) {
+    cases.push_back(std::move(corpus_case.input));
+  }
+
+  return true;
+}
+
+} // namespace LaTeX
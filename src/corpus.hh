@@ -0,0 +1,26 @@
+#ifndef CORPUS_HH_
+#define CORPUS_HH_
+
+#include <string>
+#include <vector>
+
+namespace LaTeX {
+
+struct CorpusCase {
+  std::string name, input, expected;
+};
+
+// Appends each test case in a corpus file. The input is the text between the
+// rule under the name of a case and the rule above its expected output, which
+// runs up to the next case. Trailing newlines are not part of either. Returns
+// false if the file cannot be read.
+bool read_corpus_cases(const std::string &path,
+                       std::vector<CorpusCase> &cases);
+
+// Appends only the input of each test case in a corpus file.
+bool read_corpus_cases(const std::string &path,
+                       std::vector<std::string> &cases);
+
+} // namespace LaTeX
+
+#endif
@@ -0,0 +1,545 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include "budget.hh"
+#include "daemon.hh"
+
+namespace LaTeX {
+
+namespace {
+
+const TSSymbol ERROR_SYMBOL = static_cast<TSSymbol>(-1);
+
+const char *const REQUEST_NAMES[DAEMON_REQUEST_COUNT] = {
+    "open", "edit", "close", "sections", "stats"};
+
+// Buffers reads from a file descriptor so that request lines can be split
+// without a system call per byte.
+class Channel {
+  int input, output;
+  char buffer[1 << 16];
+  size_t position = 0, size = 0;
+
+  bool fill() {
+    ssize_t count;
+
+    do {
+      count = ::read(input, buffer, sizeof(buffer));
+    } while (count < 0 && errno == EINTR);
+
+    if (count <= 0) {
+      return false;
+    }
+
+    position = 0;
+    size = static_cast<size_t>(count);
+    return true;
+  }
+
+public:
+  Channel(int input, int output) : input(input), output(output) {}
+
+  bool read_line(std::string &line) {
+    line.clear();
+
+    while (position < size || fill()) {
+      const char *start = buffer + position;
+      const char *end =
+          static_cast<const char *>(std::memchr(start, '\n', size - position));
+
+      if (end) {
+        line.append(start, end);
+        position = end - buffer + 1;
+        return true;
+      }
+
+      line.append(start, size - position);
+      position = size;
+    }
+
+    return false;
+  }
+
+  bool read_bytes(size_t length, std::string &text) {
+    text.clear();
+    text.reserve(length);
+
+    while (text.size() < length && (position < size || fill())) {
+      size_t count = std::min(length - text.size(), size - position);
+      text.append(buffer + position, count);
+      position += count;
+    }
+
+    return text.size() == length;
+  }
+
+  bool write(const std::string &data) {
+    for (size_t offset = 0; offset < data.size();) {
+      ssize_t count =
+          ::write(output, data.data() + offset, data.size() - offset);
+
+      if (count < 0 && errno != EINTR) {
+        return false;
+      }
+
+      offset += std::max<ssize_t>(count, 0);
+    }
+
+    return true;
+  }
+};
+
+std::vector<std::string> split_fields(const std::string &line) {
+  std::vector<std::string> fields;
+
+  for (size_t start = 0; start < line.size();) {
+    size_t end = line.find(' ', start);
+
+    if (end == std::string::npos) {
+      end = line.size();
+    }
+
+    if (end > start) {
+      fields.push_back(line.substr(start, end - start));
+    }
+
+    start = end + 1;
+  }
+
+  return fields;
+}
+
+bool parse_offset(const std::string &field, uint32_t &value) {
+  char *end;
+  errno = 0;
+  unsigned long long number = std::strtoull(field.c_str(), &end, 10);
+
+  if (field.empty() || field[0] == '-' || *end || errno ||
+      number > UINT32_MAX) {
+    return false;
+  }
+
+  value = static_cast<uint32_t>(number);
+  return true;
+}
+
+// Moves a point over the text from begin to end.
+TSPoint advance_point(TSPoint point, const char *begin, const char *end) {
+  for (const char *newline;
+       (newline = static_cast<const char *>(
+            std::memchr(begin, '\n', end - begin)));) {
+    point.row++;
+    point.column = 0;
+    begin = newline + 1;
+  }
+
+  point.column += static_cast<uint32_t>(end - begin);
+  return point;
+}
+
+uint64_t elapsed_micros(std::chrono::steady_clock::time_point start) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+}
+
+void append_string(std::string &out, const std::string &value) {
+  out += '"';
+
+  for (char ch : value) {
+    switch (ch) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(ch) < 0x20) {
+        const char *const DIGITS = "0123456789abcdef";
+        out += "\\u00";
+        out += DIGITS[ch >> 4];
+        out += DIGITS[ch & 0xf];
+      } else {
+        out += ch;
+      }
+      break;
+    }
+  }
+
+  out += '"';
+}
+
+void append_error(std::string &reply, const std::string &message) {
+  reply += "{\"error\":";
+  append_string(reply, message);
+  reply += '}';
+}
+
+} // namespace
+
+DaemonDocument::DaemonDocument(const TSLanguage *language)
+    : parser(ts_parser_new()), index(language) {
+  ts_parser_set_language(parser, language);
+}
+
+DaemonDocument::~DaemonDocument() {
+  if (tree) {
+    ts_tree_delete(tree);
+  }
+
+  ts_parser_delete(parser);
+}
+
+TSPoint DaemonDocument::point(uint32_t offset) const {
+  return advance_point({0, 0}, source.data(), source.data() + offset);
+}
+
+void ParseDaemon::reparse(const std::string &id, DaemonDocument &document,
+                          std::string &reply) {
+  const std::string &source = document.source;
+  auto deadline = (budget_micros == 0)
+                      ? std::chrono::steady_clock::time_point::max()
+                      : std::chrono::steady_clock::now() +
+                            std::chrono::microseconds(budget_micros);
+  // Only a document without a tree is parsed from scratch, so only then can
+  // the tree of another document with the same source be used.
+  TSTree *cached =
+      document.tree ? nullptr : trees.lookup(source.data(), source.size());
+  BudgetedParse result =
+      cached ? BudgetedParse{PARSE_COMPLETE, cached,
+                             static_cast<uint32_t>(source.size()), 0}
+             : parse_with_budget(document.parser, document.tree,
+                                 source.data(),
+                                 static_cast<uint32_t>(source.size()),
+                                 deadline);
+
+  if (!document.tree && !cached && result.tree) {
+    trees.store(source.data(), source.size(), result.tree);
+  }
+
+  // The edited tree is kept so the next edit can still reuse it.
+  if (!result.tree) {
+    reply += "{\"id\":";
+    append_string(reply, id);
+    reply += ",\"version\":" + std::to_string(document.version) +
+             ",\"parse_micros\":" + std::to_string(result.micros) +
+             ",\"budget_exceeded\":true,\"offset\":" +
+             std::to_string(result.offset) + '}';
+    return;
+  }
+
+  auto index_start = std::chrono::steady_clock::now();
+
+  if (document.tree && document.pending_edits == 1) {
+    document.index.update(document.tree, result.tree, document.pending_edit,
+                          source.data());
+  } else {
+    document.index.reset(result.tree, source.data(),
+                         static_cast<uint32_t>(source.size()));
+  }
+
+  uint64_t index_micros = elapsed_micros(index_start);
+  uint32_t count = 1;
+  TSRange whole, *ranges = &whole;
+
+  document.pending_edits = 0;
+
+  if (document.tree) {
+    ranges = ts_tree_get_changed_ranges(document.tree, result.tree, &count);
+    ts_tree_delete(document.tree);
+  } else {
+    whole.start_point = {0, 0};
+    whole.end_point = document.point(source.size());
+    whole.start_byte = 0;
+    whole.end_byte = source.size();
+  }
+
+  document.tree = result.tree;
+
+  describe(id, document, ranges, count, result.micros, index_micros, reply);
+
+  if (ranges != &whole) {
+    std::free(ranges);
+  }
+}
+
+void ParseDaemon::open(const std::string &id, std::string &&text,
+                       std::string &reply) {
+  std::unique_ptr<DaemonDocument> &document = documents[id];
+
+  document.reset(new DaemonDocument(language));
+  document->source = std::move(text);
+
+  reparse(id, *document, reply);
+}
+
+void ParseDaemon::edit(const std::string &id, uint32_t start_byte,
+                       uint32_t old_end_byte, const std::string &text,
+                       std::string &reply) {
+  auto it = documents.find(id);
+
+  if (it == documents.end()) {
+    append_error(reply, "unknown document " + id);
+    return;
+  }
+
+  DaemonDocument &document = *it->second;
+  std::string &source = document.source;
+
+  if (start_byte > old_end_byte || old_end_byte > source.size() ||
+      source.size() - (old_end_byte - start_byte) + text.size() > UINT32_MAX) {
+    append_error(reply, "edit out of range in " + id);
+    return;
+  }
+
+  TSInputEdit edit;
+  edit.start_byte = start_byte;
+  edit.old_end_byte = old_end_byte;
+  edit.new_end_byte = start_byte + static_cast<uint32_t>(text.size());
+  edit.start_point = document.point(start_byte);
+  edit.old_end_point =
+      advance_point(edit.start_point, source.data() + start_byte,
+                    source.data() + old_end_byte);
+  edit.new_end_point = advance_point(edit.start_point, text.data(),
+                                     text.data() + text.size());
+
+  source.replace(start_byte, old_end_byte - start_byte, text);
+  document.version++;
+  document.pending_edit = edit;
+  document.pending_edits++;
+
+  if (document.tree) {
+    ts_tree_edit(document.tree, &edit);
+  }
+
+  reparse(id, document, reply);
+}
+
+void ParseDaemon::close(const std::string &id, std::string &reply) {
+  if (documents.erase(id) == 0) {
+    append_error(reply, "unknown document " + id);
+    return;
+  }
+
+  reply += "{\"id\":";
+  append_string(reply, id);
+  reply += ",\"closed\":true}";
+}
+
+void ParseDaemon::sections(const std::string &id, uint32_t offset,
+                           std::string &reply) {
+  auto it = documents.find(id);
+
+  if (it == documents.end()) {
+    append_error(reply, "unknown document " + id);
+    return;
+  }
+
+  const DaemonDocument &document = *it->second;
+
+  // The index only follows the source once the last edit has been parsed.
+  if (!document.tree || document.pending_edits > 0) {
+    append_error(reply, "document " + id + " is not parsed");
+    return;
+  }
+
+  reply += "{\"id\":";
+  append_string(reply, id);
+  reply += ",\"offset\":" + std::to_string(offset) + ",\"sections\":[";
+
+  for (size_t index : document.index.section_path_at(offset)) {
+    IndexEntry entry = document.index[index];
+
+    if (reply.back() == '}') {
+      reply += ',';
+    }
+
+    reply += "{\"level\":" + std::to_string(entry.level) +
+             ",\"start_byte\":" + std::to_string(entry.start_byte) +
+             ",\"end_byte\":" + std::to_string(entry.end_byte) +
+             ",\"title\":";
+    append_string(reply, document.source.substr(
+                             entry.key_start, entry.key_end - entry.key_start));
+    reply += '}';
+  }
+
+  reply += "]}";
+}
+
+void ParseDaemon::stats(std::string &reply) const {
+  reply += "{\"documents\":" + std::to_string(documents.size());
+
+  for (int i = 0; i < DAEMON_REQUEST_COUNT; i++) {
+    const LatencyHistogram &histogram = histograms[i];
+
+    reply += ",\"";
+    reply += REQUEST_NAMES[i];
+    reply += "\":{\"count\":" + std::to_string(histogram.size()) +
+             ",\"mean\":" + std::to_string(histogram.mean()) +
+             ",\"p50\":" + std::to_string(histogram.percentile(0.5)) +
+             ",\"p90\":" + std::to_string(histogram.percentile(0.9)) +
+             ",\"p99\":" + std::to_string(histogram.percentile(0.99)) +
+             ",\"max\":" + std::to_string(histogram.max()) + '}';
+  }
+
+  reply += ",\"tree_cache\":{\"trees\":" + std::to_string(trees.size()) +
+           ",\"bytes\":" + std::to_string(trees.bytes()) +
+           ",\"hits\":" + std::to_string(trees.hits()) +
+           ",\"misses\":" + std::to_string(trees.misses()) + "}}";
+}
+
+void ParseDaemon::describe(const std::string &id,
+                           const DaemonDocument &document,
+                           const TSRange *ranges, uint32_t count,
+                           uint64_t parse_micros, uint64_t index_micros,
+                           std::string &reply) {
+  reply += "{\"id\":";
+  append_string(reply, id);
+  reply += ",\"version\":" + std::to_string(document.version) +
+           ",\"parse_micros\":" + std::to_string(parse_micros) +
+           ",\"index_micros\":" + std::to_string(index_micros) +
+           ",\"records\":" + std::to_string(document.index.size()) +
+           ",\"changed\":[";
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (i > 0) {
+      reply += ',';
+    }
+
+    reply += '[' + std::to_string(ranges[i].start_byte) + ',' +
+             std::to_string(ranges[i].end_byte) + ']';
+  }
+
+  reply += ']';
+
+  // Only subtrees that contain an error are entered. The children of an
+  // ERROR node are not listed on their own.
+  std::string errors;
+  uint32_t error_count = 0;
+  TSNode root = ts_tree_root_node(document.tree);
+  TSTreeCursor cursor = ts_tree_cursor_new(root);
+
+  for (bool done = false; !done;) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    bool missing = ts_node_is_missing(node);
+
+    if (missing || ts_node_symbol(node) == ERROR_SYMBOL) {
+      if (error_count++ < MAX_ERRORS) {
+        TSPoint start = ts_node_start_point(node);
+
+        errors += errors.empty() ? "{\"type\":" : ",{\"type\":";
+        append_string(errors, ts_node_type(node));
+        errors += ",\"missing\":";
+        errors += missing ? "true" : "false";
+        errors += ",\"start_byte\":" +
+                  std::to_string(ts_node_start_byte(node)) +
+                  ",\"end_byte\":" + std::to_string(ts_node_end_byte(node)) +
+                  ",\"row\":" + std::to_string(start.row) +
+                  ",\"column\":" + std::to_string(start.column) + '}';
+      }
+    } else if (ts_node_has_error(node) &&
+               ts_tree_cursor_goto_first_child(&cursor)) {
+      continue;
+    }
+
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        done = true;
+        break;
+      }
+    }
+  }
+
+  ts_tree_cursor_delete(&cursor);
+
+  reply += ",\"error_count\":" + std::to_string(error_count) + ",\"errors\":[" +
+           errors + "]}";
+}
+
+bool ParseDaemon::serve(int input, int output) {
+  Channel channel(input, output);
+  std::string line, text, reply;
+
+  while (channel.read_line(line)) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> fields = split_fields(line);
+    uint32_t start_byte, old_end_byte, length;
+    DaemonRequest request;
+
+    if (fields.empty()) {
+      continue;
+    }
+
+    reply.clear();
+
+    if (fields[0] == "open" && fields.size() == 3 &&
+        parse_offset(fields[2], length)) {
+      if (!channel.read_bytes(length, text)) {
+        return false;
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      request = OPEN_REQUEST;
+      open(fields[1], std::move(text), reply);
+    } else if (fields[0] == "edit" && fields.size() == 5 &&
+               parse_offset(fields[2], start_byte) &&
+               parse_offset(fields[3], old_end_byte) &&
+               parse_offset(fields[4], length)) {
+      if (!channel.read_bytes(length, text)) {
+        return false;
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      request = EDIT_REQUEST;
+      edit(fields[1], start_byte, old_end_byte, text, reply);
+    } else if (fields[0] == "close" && fields.size() == 2) {
+      std::lock_guard<std::mutex> lock(mutex);
+      request = CLOSE_REQUEST;
+      close(fields[1], reply);
+    } else if (fields[0] == "sections" && fields.size() == 3 &&
+               parse_offset(fields[2], start_byte)) {
+      std::lock_guard<std::mutex> lock(mutex);
+      request = SECTIONS_REQUEST;
+      sections(fields[1], start_byte, reply);
+    } else if (fields[0] == "stats" && fields.size() == 1) {
+      std::lock_guard<std::mutex> lock(mutex);
+      request = STATS_REQUEST;
+      stats(reply);
+    } else {
+      // The length of any text that follows is unknown, so the rest of the
+      // input cannot be read.
+      append_error(reply, "malformed request");
+      reply += '\n';
+      channel.write(reply);
+      return false;
+    }
+
+    reply += '\n';
+    bool written = channel.write(reply);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      histograms[request].add(elapsed_micros(start));
+    }
+
+    if (!written) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} // namespace LaTeX
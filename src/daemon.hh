@@ -0,0 +1,146 @@
+#ifndef DAEMON_HH_
+#define DAEMON_HH_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tree_sitter/api.h"
+
+#include "cache.hh"
+#include "histogram.hh"
+#include "index.hh"
+
+namespace LaTeX {
+
+enum DaemonRequest {
+  OPEN_REQUEST,
+  EDIT_REQUEST,
+  CLOSE_REQUEST,
+  SECTIONS_REQUEST,
+  STATS_REQUEST
+};
+
+const int DAEMON_REQUEST_COUNT = STATS_REQUEST + 1;
+
+// An open document with the parser, tree and index that are reused for each
+// edit. The edits since the last complete parse are counted, since the index
+// can only follow a single edit and is rebuilt after several.
+struct DaemonDocument {
+  std::string source;
+  TSParser *parser = nullptr;
+  TSTree *tree = nullptr;
+  uint32_t version = 0;
+  IncrementalIndex index;
+  TSInputEdit pending_edit;
+  uint32_t pending_edits = 0;
+
+  DaemonDocument(const TSLanguage *language);
+
+  ~DaemonDocument();
+
+  DaemonDocument(const DaemonDocument &) = delete;
+
+  DaemonDocument &operator=(const DaemonDocument &) = delete;
+
+  // The row and the byte column of an offset.
+  TSPoint point(uint32_t offset) const;
+};
+
+// Keeps documents open between requests and reparses them incrementally as
+// they are edited. Requests are read from a file descriptor, e.g. stdin or a
+// connected Unix socket, and each is answered with one line of JSON. A
+// request is a line of space separated fields, followed by the number of
+// bytes of text given in its last field:
+//
+//   open <id> <length>\n<text>
+//   edit <id> <start_byte> <old_end_byte> <length>\n<text>
+//   close <id>\n
+//   sections <id> <offset>\n
+//   stats\n
+//
+// An edit replaces the bytes from start_byte to old_end_byte with the text.
+// The reply to open and edit holds the ranges that changed in the tree, the
+// number of records in the structural index of the document, which is kept
+// current with an IncrementalIndex, and the ERROR and missing nodes of the
+// new tree:
+//
+//   {"id":"a.tex","version":2,"parse_micros":140,"index_micros":12,
+//    "records":31,"changed":[[10,24]],"error_count":1,"errors":[{"type":
+//    "ERROR","missing":false,"start_byte":12,"end_byte":14,"row":0,
+//    "column":12}]}
+//
+// The reply to sections lists the sections that enclose an offset from the
+// outermost in, e.g. for the breadcrumbs of an editor:
+//
+//   {"id":"a.tex","offset":420,"sections":[{"level":1,"start_byte":200,
+//    "end_byte":221,"title":"Introduction"}]}
+//
+// When a parse takes longer than the budget, the reply holds the offset the
+// parse reached instead, see parse_with_budget. The document keeps the edit
+// and is parsed again on the next one:
+//
+//   {"id":"a.tex","version":3,"parse_micros":20004,"budget_exceeded":true,
+//    "offset":40960}
+//
+// The reply to stats holds the latency histogram of each request type in
+// microseconds and the number of trees, bytes, hits and misses of the tree
+// cache. The latency of a request is the time from reading it to writing its
+// reply.
+//
+// A document that is opened with the source of another document opened
+// before shares its tree from a TreeCache instead of being parsed.
+//
+// Requests from several connections are handled one at a time.
+class ParseDaemon {
+  const TSLanguage *language;
+  uint64_t budget_micros;
+  std::unordered_map<std::string, std::unique_ptr<DaemonDocument>> documents;
+  LatencyHistogram histograms[DAEMON_REQUEST_COUNT];
+  TreeCache trees;
+  std::mutex mutex;
+
+  void reparse(const std::string &id, DaemonDocument &document,
+               std::string &reply);
+
+  void open(const std::string &id, std::string &&text, std::string &reply);
+
+  void edit(const std::string &id, uint32_t start_byte, uint32_t old_end_byte,
+            const std::string &text, std::string &reply);
+
+  void close(const std::string &id, std::string &reply);
+
+  void sections(const std::string &id, uint32_t offset, std::string &reply);
+
+  void stats(std::string &reply) const;
+
+  void describe(const std::string &id, const DaemonDocument &document,
+                const TSRange *ranges, uint32_t count, uint64_t parse_micros,
+                uint64_t index_micros, std::string &reply);
+
+public:
+  // The number of error nodes listed in a reply. The rest are only counted.
+  static const uint32_t MAX_ERRORS = 64;
+
+  // Parses without a time limit when budget_micros is zero. Trees of up to
+  // tree_cache_bytes in total are kept for documents opened again.
+  ParseDaemon(const TSLanguage *language, uint64_t budget_micros = 0,
+              size_t tree_cache_bytes = 0)
+      : language(language), budget_micros(budget_micros),
+        trees(tree_cache_bytes) {}
+
+  ParseDaemon(const ParseDaemon &) = delete;
+
+  ParseDaemon &operator=(const ParseDaemon &) = delete;
+
+  // Answers requests from input on output until input is closed or a
+  // request is malformed. Returns false in the latter case.
+  bool serve(int input, int output);
+};
+
+} // namespace LaTeX
+
+#endif
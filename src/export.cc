@@ -0,0 +1,172 @@
+#include <cstring>
+#include <vector>
+
+#include "export.hh"
+
+namespace LaTeX {
+
+namespace {
+
+const char EXPORT_MAGIC[8] = {'T', 'S', 'L', 'T', 'R', 'E', 'E', '1'};
+const TSSymbol ERROR_SYMBOL = static_cast<TSSymbol>(-1);
+
+template <class T>
+uint32_t append(std::string &output, const std::vector<T> &values) {
+  output.resize((output.size() + alignof(T) - 1) & ~(alignof(T) - 1));
+
+  uint32_t offset = output.size();
+
+  output.append(reinterpret_cast<const char *>(values.data()),
+                values.size() * sizeof(T));
+
+  return offset;
+}
+
+bool fits(const ExportHeader *header, uint32_t offset, uint32_t count,
+          size_t size, size_t alignment) {
+  return offset >= sizeof(ExportHeader) && offset % alignment == 0 &&
+         offset <= header->size && (header->size - offset) / size >= count;
+}
+
+} // namespace
+
+void export_tree(std::string &output, const TSTree *tree) {
+  const TSLanguage *language = ts_tree_language(tree);
+  uint32_t symbol_count = ts_language_symbol_count(language);
+  std::vector<uint32_t> start_bytes, end_bytes, child_counts, subtree_ends,
+      name_offsets, parents;
+  std::vector<uint16_t> symbols;
+  std::vector<uint8_t> flags;
+  std::vector<char> names;
+  TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+
+  while (true) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    TSSymbol symbol = ts_node_symbol(node);
+    uint32_t index = symbols.size();
+
+    symbols.push_back(symbol == ERROR_SYMBOL ? symbol_count : symbol);
+    start_bytes.push_back(ts_node_start_byte(node));
+    end_bytes.push_back(ts_node_end_byte(node));
+    child_counts.push_back(ts_node_child_count(node));
+    subtree_ends.push_back(0);
+    flags.push_back((ts_node_is_named(node) ? NAMED_FLAG : 0) |
+                    (ts_node_is_extra(node) ? EXTRA_FLAG : 0) |
+                    (ts_node_is_missing(node) ? MISSING_FLAG : 0) |
+                    (ts_node_has_error(node) ? HAS_ERROR_FLAG : 0));
+
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+      parents.push_back(index);
+      continue;
+    }
+
+    subtree_ends[index] = symbols.size();
+
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        break;
+      }
+
+      subtree_ends[parents.back()] = symbols.size();
+      parents.pop_back();
+    }
+
+    if (parents.empty()) {
+      break;
+    }
+  }
+
+  ts_tree_cursor_delete(&cursor);
+
+  for (uint32_t symbol = 0; symbol <= symbol_count; symbol++) {
+    const char *name = symbol < symbol_count
+                           ? ts_language_symbol_name(language, symbol)
+                           : "ERROR";
+
+    name_offsets.push_back(names.size());
+
+    if (name) {
+      names.insert(names.end(), name, name + std::strlen(name));
+    }
+
+    names.push_back('\0');
+  }
+
+  name_offsets.push_back(names.size());
+
+  ExportHeader header;
+
+  output.assign(sizeof(ExportHeader), '\0');
+  std::memcpy(header.magic, EXPORT_MAGIC, sizeof(EXPORT_MAGIC));
+  header.node_count = symbols.size();
+  header.symbol_count = symbol_count + 1;
+  header.start_bytes = append(output, start_bytes);
+  header.end_bytes = append(output, end_bytes);
+  header.child_counts = append(output, child_counts);
+  header.subtree_ends = append(output, subtree_ends);
+  header.name_offsets = append(output, name_offsets);
+  header.symbols = append(output, symbols);
+  header.flags = append(output, flags);
+  header.names = append(output, names);
+  header.size = output.size();
+  std::memcpy(&output[0], &header, sizeof(ExportHeader));
+}
+
+ExportedTree::ExportedTree(const void *data, size_t size)
+    : data(static_cast<const char *>(data)), header(nullptr) {
+  const ExportHeader *candidate = static_cast<const ExportHeader *>(data);
+
+  if (size < sizeof(ExportHeader) ||
+      reinterpret_cast<uintptr_t>(data) % alignof(ExportHeader) != 0 ||
+      std::memcmp(candidate->magic, EXPORT_MAGIC, sizeof(EXPORT_MAGIC)) !=
+          0 ||
+      candidate->size > size || candidate->symbol_count == 0 ||
+      candidate->symbol_count > 0x10000) {
+    return;
+  }
+
+  uint32_t nodes = candidate->node_count;
+  uint32_t symbols = candidate->symbol_count;
+
+  if (!fits(candidate, candidate->start_bytes, nodes, 4, 4) ||
+      !fits(candidate, candidate->end_bytes, nodes, 4, 4) ||
+      !fits(candidate, candidate->child_counts, nodes, 4, 4) ||
+      !fits(candidate, candidate->subtree_ends, nodes, 4, 4) ||
+      !fits(candidate, candidate->name_offsets, symbols + 1, 4, 4) ||
+      !fits(candidate, candidate->symbols, nodes, 2, 2) ||
+      !fits(candidate, candidate->flags, nodes, 1, 1) ||
+      !fits(candidate, candidate->names, 0, 1, 1)) {
+    return;
+  }
+
+  header = candidate;
+
+  // Check that names and traversals stay in bounds so that corrupt input
+  // cannot make a reader run off the end.
+  const char *names = column<char>(header->names);
+  const uint32_t *name_offsets = column<uint32_t>(header->name_offsets);
+
+  if (name_offsets[symbols] > header->size - header->names) {
+    header = nullptr;
+    return;
+  }
+
+  // Going backwards each offset is bounded by the one after it.
+  for (uint32_t symbol = symbols; symbol-- > 0;) {
+    if (name_offsets[symbol] >= name_offsets[symbol + 1] ||
+        names[name_offsets[symbol + 1] - 1] != '\0') {
+      header = nullptr;
+      return;
+    }
+  }
+
+  for (uint32_t node = 0; node < nodes; node++) {
+    if (subtree_end(node) <= node || subtree_end(node) > nodes ||
+        this->symbol(node) >= symbols) {
+      header = nullptr;
+      return;
+    }
+  }
+}
+
+} // namespace LaTeX
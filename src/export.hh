@@ -0,0 +1,105 @@
+#ifndef EXPORT_HH_
+#define EXPORT_HH_
+
+#include <cstdint>
+#include <string>
+
+#include "tree_sitter/api.h"
+
+namespace LaTeX {
+
+enum ExportFlag : uint8_t {
+  NAMED_FLAG = 1,
+  EXTRA_FLAG = 2,
+  MISSING_FLAG = 4,
+  HAS_ERROR_FLAG = 8
+};
+
+// The header of an exported tree. It is followed by the node columns, each
+// an array of node_count values, and then the symbol table. All offsets are
+// from the start of the header and every column is aligned to its element
+// size. Values are stored in the byte order of the writer.
+struct ExportHeader {
+  char magic[8];
+  uint32_t node_count;
+  uint32_t symbol_count;
+  // uint32_t columns
+  uint32_t start_bytes, end_bytes, child_counts, subtree_ends;
+  // uint16_t column
+  uint32_t symbols;
+  // uint8_t column of ExportFlag
+  uint32_t flags;
+  // symbol_count + 1 uint32_t offsets into the names, which are each null
+  // terminated and indexed by symbol.
+  uint32_t name_offsets, names;
+  uint32_t size;
+};
+
+// Replaces output with a tree written in preorder as a struct of arrays. The subtree end of a node
+// is the index just past its last descendant, so the children of node i are
+// visited with
+//
+//   for (uint32_t c = i + 1; c < subtree_end(i); c = subtree_end(c))
+//
+// The symbol table holds every symbol of the language so symbol ids can be
+// matched against node names without the grammar. Error nodes are given an
+// extra last symbol named ERROR.
+void export_tree(std::string &output, const TSTree *tree);
+
+// Reads an exported tree in place, e.g. from a memory mapped file, without
+// allocating.
+class ExportedTree {
+  const char *data;
+  const ExportHeader *header;
+
+  template <class T> const T *column(uint32_t offset) const {
+    return reinterpret_cast<const T *>(data + offset);
+  }
+
+public:
+  // data has to be aligned to 4 bytes. Check valid() before reading.
+  ExportedTree(const void *data, size_t size);
+
+  bool valid() const { return header != nullptr; }
+
+  uint32_t node_count() const { return header->node_count; }
+
+  uint32_t symbol_count() const { return header->symbol_count; }
+
+  const char *symbol_name(uint16_t symbol) const {
+    return column<char>(header->names) +
+           column<uint32_t>(header->name_offsets)[symbol];
+  }
+
+  uint16_t symbol(uint32_t node) const {
+    return column<uint16_t>(header->symbols)[node];
+  }
+
+  const char *type(uint32_t node) const { return symbol_name(symbol(node)); }
+
+  uint32_t start_byte(uint32_t node) const {
+    return column<uint32_t>(header->start_bytes)[node];
+  }
+
+  uint32_t end_byte(uint32_t node) const {
+    return column<uint32_t>(header->end_bytes)[node];
+  }
+
+  uint32_t child_count(uint32_t node) const {
+    return column<uint32_t>(header->child_counts)[node];
+  }
+
+  uint32_t subtree_end(uint32_t node) const {
+    return column<uint32_t>(header->subtree_ends)[node];
+  }
+
+  uint8_t flags(uint32_t node) const {
+    return column<uint8_t>(header->flags)[node];
+  }
+
+  bool is_named(uint32_t node) const { return flags(node) & NAMED_FLAG; }
+};
+
+} // namespace LaTeX
+
+#endif
@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <condition_variable>
+#include <deque>
+#include <dirent.h>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <sys/stat.h>
+#include <thread>
+#include <utility>
+
+#include "file_database.hh"
+
+namespace LaTeX {
+
+namespace {
+
+const char LS_R_HEADER[] =
+    "% ls-R -- filename database for kpathsea; do not change this line.";
+
+std::string parent_directory(const std::string &path) {
+  size_t slash = path.rfind('/');
+
+  if (slash == std::string::npos) {
+    return ".";
+  }
+
+  return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+// The files and subdirectories of a directory.
+struct Listing {
+  std::string directory;
+  std::vector<std::string> files, subdirectories;
+};
+
+// Lists directories taken from a shared queue. Symbolic links are followed
+// as kpathsea does, which is why visited directories are tracked by device
+// and inode.
+class Walker {
+  std::deque<std::string> queue;
+  std::set<std::pair<dev_t, ino_t>> visited;
+  size_t pending = 0;
+  std::mutex mutex;
+  std::condition_variable condition;
+
+  bool list(const std::string &directory, Listing &listing) const {
+    DIR *stream = opendir(directory.c_str());
+
+    if (!stream) {
+      return false;
+    }
+
+    listing.directory = directory;
+
+    while (struct dirent *entry = readdir(stream)) {
+      // Also skips . and .. as well as version control directories.
+      if (entry->d_name[0] == '.') {
+        continue;
+      }
+
+      std::string path = directory + "/" + entry->d_name;
+      bool is_directory = entry->d_type == DT_DIR;
+
+      if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+        struct stat status;
+        is_directory =
+            stat(path.c_str(), &status) == 0 && S_ISDIR(status.st_mode);
+      }
+
+      (is_directory ? listing.subdirectories : listing.files)
+          .push_back(entry->d_name);
+    }
+
+    closedir(stream);
+
+    return true;
+  }
+
+  bool visit(const std::string &directory) {
+    struct stat status;
+
+    return stat(directory.c_str(), &status) == 0 &&
+           visited.emplace(status.st_dev, status.st_ino).second;
+  }
+
+public:
+  std::vector<Listing> listings;
+
+  void work() {
+    std::vector<Listing> local;
+
+    while (true) {
+      std::string directory;
+
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        condition.wait(lock,
+                       [this] { return !queue.empty() || pending == 0; });
+
+        if (queue.empty()) {
+          break;
+        }
+
+        directory = std::move(queue.front());
+        queue.pop_front();
+      }
+
+      Listing listing;
+      bool listed = list(directory, listing);
+      std::lock_guard<std::mutex> lock(mutex);
+
+      if (listed) {
+        for (const std::string &subdirectory : listing.subdirectories) {
+          std::string path = directory + "/" + subdirectory;
+
+          if (visit(path)) {
+            queue.push_back(path);
+            pending++;
+            condition.notify_one();
+          }
+        }
+
+        local.push_back(std::move(listing));
+      }
+
+      if (--pending == 0) {
+        condition.notify_all();
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (Listing &listing : local) {
+      listings.push_back(std::move(listing));
+    }
+  }
+
+  void run(const std::string &root, unsigned thread_count) {
+    if (!visit(root)) {
+      return;
+    }
+
+    queue.push_back(root);
+    pending = 1;
+
+    std::vector<std::thread> threads;
+
+    for (unsigned i = 0; i < thread_count; i++) {
+      threads.emplace_back(&Walker::work, this);
+    }
+
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+
+    // Threads finish in any order so the listings are sorted to make the
+    // order in which names are found independent of scheduling.
+    std::sort(listings.begin(), listings.end(),
+              [](const Listing &a, const Listing &b) {
+                return a.directory < b.directory;
+              });
+  }
+};
+
+} // namespace
+
+uint32_t FileDatabase::add_directory(const std::string &directory) {
+  directories.push_back(directory);
+  return directories.size() - 1;
+}
+
+bool FileDatabase::load(const std::string &path) {
+  std::ifstream stream(path);
+  std::string line, base = parent_directory(path);
+  bool has_directory = false;
+  uint32_t directory = 0;
+
+  if (!stream) {
+    return false;
+  }
+
+  while (std::getline(stream, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+
+    if (line.empty() || line[0] == '%') {
+      continue;
+    }
+
+    // A directory starts with a line naming it followed by a colon.
+    if (line.back() == ':' && (line[0] == '/' || line[0] == '.')) {
+      line.pop_back();
+
+      while (line.size() > 1 && line.back() == '/') {
+        line.pop_back();
+      }
+
+      if (line[0] == '/') {
+        directory = add_directory(line);
+      } else if (line == ".") {
+        directory = add_directory(base);
+      } else {
+        directory = add_directory(base + line.substr(1));
+      }
+
+      has_directory = true;
+      continue;
+    }
+
+    // Names before the first directory are in the directory of the file.
+    if (!has_directory) {
+      directory = add_directory(base);
+      has_directory = true;
+    }
+
+    names[line].push_back(directory);
+  }
+
+  return true;
+}
+
+void FileDatabase::build(const std::string &root, unsigned thread_count) {
+  Walker walker;
+  char buffer[PATH_MAX];
+  // ls-R files only hold absolute directories and those relative to the
+  // file, so a relative root is made absolute.
+  std::string top = realpath(root.c_str(), buffer) ? buffer : root;
+
+  if (thread_count == 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  walker.run(top, thread_count);
+
+  for (const Listing &listing : walker.listings) {
+    uint32_t directory = add_directory(listing.directory);
+
+    // Subdirectories are listed as well, just like in ls-R files.
+    for (const std::string &name : listing.files) {
+      names[name].push_back(directory);
+    }
+
+    for (const std::string &name : listing.subdirectories) {
+      names[name].push_back(directory);
+    }
+  }
+}
+
+bool FileDatabase::write(const std::string &path) const {
+  std::ofstream stream(path);
+  std::string base = parent_directory(path);
+  std::vector<std::vector<const std::string *>> contents(directories.size());
+  std::vector<uint32_t> order(directories.size());
+
+  if (!stream) {
+    return false;
+  }
+
+  for (auto &name : names) {
+    for (uint32_t directory : name.second) {
+      contents[directory].push_back(&name.first);
+    }
+  }
+
+  for (uint32_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+
+  std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+    return directories[a] < directories[b];
+  });
+
+  stream << LS_R_HEADER << "\n";
+
+  for (uint32_t directory : order) {
+    const std::string &name = directories[directory];
+
+    std::sort(contents[directory].begin(), contents[directory].end(),
+              [](const std::string *a, const std::string *b) {
+                return *a < *b;
+              });
+
+    if (name == base) {
+      stream << "\n./:\n";
+    } else if (name.compare(0, base.size() + 1, base + "/") == 0) {
+      stream << "\n./" << name.substr(base.size() + 1) << ":\n";
+    } else {
+      stream << "\n" << name << ":\n";
+    }
+
+    for (const std::string *file : contents[directory]) {
+      stream << *file << "\n";
+    }
+  }
+
+  return static_cast<bool>(stream);
+}
+
+bool FileDatabase::find(const std::string &name, std::string &path) const {
+  size_t slash = name.rfind('/');
+  std::string base =
+      slash == std::string::npos ? name : name.substr(slash + 1);
+  auto it = names.find(base);
+
+  if (it == names.end()) {
+    return false;
+  }
+
+  for (uint32_t directory : it->second) {
+    const std::string &candidate = directories[directory];
+
+    // The directories of the name have to match whole components at the
+    // end of the directory.
+    if (slash != std::string::npos) {
+      std::string suffix = "/" + name.substr(0, slash);
+
+      if (candidate.size() < suffix.size() ||
+          candidate.compare(candidate.size() - suffix.size(), suffix.size(),
+                            suffix) != 0) {
+        continue;
+      }
+    }
+
+    path = candidate + "/" + base;
+
+    return true;
+  }
+
+  return false;
+}
+
+} // namespace LaTeX
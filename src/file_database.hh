@@ -0,0 +1,47 @@
+#ifndef FILE_DATABASE_HH_
+#define FILE_DATABASE_HH_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace LaTeX {
+
+// A filename database in the format of the ls-R files of kpathsea. It maps
+// each file name to the directories that contain it so that resolving a
+// name does not touch the file system. A database can be loaded from the
+// ls-R file of a texmf tree or built by walking the tree on a number of
+// threads and then written as an ls-R file that kpathsea can read.
+class FileDatabase {
+  std::vector<std::string> directories;
+  // The directories of each name in the order they were listed.
+  std::unordered_map<std::string, std::vector<uint32_t>> names;
+
+  uint32_t add_directory(const std::string &directory);
+
+public:
+  // Adds the contents of an ls-R file. Relative directories are taken to be
+  // relative to the directory of the file.
+  bool load(const std::string &path);
+
+  // Adds every file below root using thread_count threads, one thread per
+  // core if it is zero. The directories are absolute even for a relative
+  // root.
+  void build(const std::string &root, unsigned thread_count = 0);
+
+  // Writes the database as an ls-R file. Directories below the directory of
+  // the file are written relative to it as kpathsea expects.
+  bool write(const std::string &path) const;
+
+  // Looks up a name, e.g. amsmath.sty or chapters/intro.tex, where the
+  // directories of the name have to match the end of the directory it is
+  // found in. Returns the first match.
+  bool find(const std::string &name, std::string &path) const;
+
+  size_t size() const { return names.size(); }
+};
+
+} // namespace LaTeX
+
+#endif
@@ -0,0 +1,87 @@
+#include <algorithm>
+
+#include "bits.hh"
+#include "histogram.hh"
+
+namespace LaTeX {
+
+int LatencyHistogram::bucket(uint64_t value) {
+  if (value < (1u << SUB_BUCKET_BITS)) {
+    return static_cast<int>(value);
+  }
+
+  int exponent = static_cast<int>(highest_bit(value));
+  int sub_bucket = static_cast<int>(value >> (exponent - SUB_BUCKET_BITS)) &
+                   ((1 << SUB_BUCKET_BITS) - 1);
+
+  return (exponent - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS | sub_bucket;
+}
+
+uint64_t LatencyHistogram::upper_bound(int bucket) {
+  if (bucket < (1 << SUB_BUCKET_BITS)) {
+    return static_cast<uint64_t>(bucket);
+  }
+
+  int shift = (bucket >> SUB_BUCKET_BITS) - 1;
+  int sub_bucket = bucket & ((1 << SUB_BUCKET_BITS) - 1);
+  uint64_t lower = static_cast<uint64_t>((1 << SUB_BUCKET_BITS) | sub_bucket)
+                   << shift;
+
+  return lower + ((static_cast<uint64_t>(1) << shift) - 1);
+}
+
+void LatencyHistogram::add(uint64_t value) {
+  buckets[bucket(value)]++;
+  count++;
+  total += value;
+  maximum = std::max(maximum, value);
+}
+
+uint64_t LatencyHistogram::percentile(double quantile) const {
+  uint64_t rank = static_cast<uint64_t>(quantile * count + 0.5), seen = 0;
+
+  for (int i = 0; i < BUCKET_COUNT; i++) {
+    seen += buckets[i];
+
+    if (seen > 0 && seen >= rank) {
+      return std::min(upper_bound(i), maximum);
+    }
+  }
+
+  return maximum;
+}
+
+ConcurrentLatencyHistogram::ConcurrentLatencyHistogram()
+    : total(0), maximum(0) {
+  for (std::atomic<uint64_t> &bucket : buckets) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+void ConcurrentLatencyHistogram::add(uint64_t value) {
+  buckets[LatencyHistogram::bucket(value)].fetch_add(
+      1, std::memory_order_relaxed);
+  total.fetch_add(value, std::memory_order_relaxed);
+
+  uint64_t current = maximum.load(std::memory_order_relaxed);
+
+  while (current < value &&
+         !maximum.compare_exchange_weak(current, value,
+                                        std::memory_order_relaxed)) {
+  }
+}
+
+LatencyHistogram ConcurrentLatencyHistogram::snapshot() const {
+  LatencyHistogram histogram;
+
+  for (int i = 0; i < LatencyHistogram::BUCKET_COUNT; i++) {
+    histogram.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    histogram.count += histogram.buckets[i];
+  }
+
+  histogram.total = total.load(std::memory_order_relaxed);
+  histogram.maximum = maximum.load(std::memory_order_relaxed);
+  return histogram;
+}
+
+} // namespace LaTeX
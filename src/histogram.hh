@@ -0,0 +1,54 @@
+#ifndef HISTOGRAM_HH_
+#define HISTOGRAM_HH_
+
+#include <atomic>
+#include <cstdint>
+
+namespace LaTeX {
+
+// Counts latencies in any unit. Each power of two is split into eight
+// buckets, so a percentile is within 12.5% of the true value.
+class LatencyHistogram {
+  static const int SUB_BUCKET_BITS = 3;
+  static const int BUCKET_COUNT = 64 << SUB_BUCKET_BITS;
+
+  uint64_t buckets[BUCKET_COUNT] = {0};
+  uint64_t count = 0, total = 0, maximum = 0;
+
+  static int bucket(uint64_t value);
+
+  static uint64_t upper_bound(int bucket);
+
+public:
+  void add(uint64_t value);
+
+  uint64_t size() const { return count; }
+
+  uint64_t max() const { return maximum; }
+
+  uint64_t mean() const { return count ? total / count : 0; }
+
+  // The upper bound of the bucket that holds the quantile, e.g. 0.99 for
+  // the 99th percentile, which is never more than the maximum.
+  uint64_t percentile(double quantile) const;
+
+  friend class ConcurrentLatencyHistogram;
+};
+
+// A histogram that threads add to without a lock. A snapshot taken while
+// values are added may count a value in some totals but not in others.
+class ConcurrentLatencyHistogram {
+  std::atomic<uint64_t> buckets[LatencyHistogram::BUCKET_COUNT];
+  std::atomic<uint64_t> total, maximum;
+
+public:
+  ConcurrentLatencyHistogram();
+
+  void add(uint64_t value);
+
+  LatencyHistogram snapshot() const;
+};
+
+} // namespace LaTeX
+
+#endif
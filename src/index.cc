@@ -0,0 +1,560 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "index.hh"
+
+namespace LaTeX {
+
+namespace {
+
+struct IndexedType {
+  const char *name;
+  IndexKind kind;
+};
+
+const IndexedType indexed_types[] = {
+    {"bibitem", BIBITEM_KIND},
+    {"cite", CITE_KIND},
+    {"cites", CITE_KIND},
+    {"IfFileExists", INPUT_KIND},
+    {"input", INPUT_KIND},
+    {"label", LABEL_KIND},
+    {"newcommand", NEWCOMMAND_KIND},
+    {"newenvironment", NEWENVIRONMENT_KIND},
+    {"newglossaryentry", NEWGLOSSARYENTRY_KIND},
+    {"ref", REF_KIND},
+    {"refrange", REF_KIND},
+    {"section", SECTION_KIND},
+    {"use", PACKAGE_KIND},
+    {"use_209", CLASS_KIND},
+};
+
+// Node types whose contents are never tokenized as commands.
+const char *skipped_types[] = {"comment", "comment_block", "comment_lines",
+                               "ignored", "verbatim"};
+
+struct SectionLevel {
+  const char *name;
+  int8_t level;
+};
+
+const SectionLevel section_levels[] = {
+    {"chapter", 0},       {"paragraph", 4},  {"part", -1},
+    {"section", 1},       {"subparagraph", 5}, {"subsection", 2},
+    {"subsubsection", 3},
+};
+
+// Control sequences of the use command that load a class.
+const char *class_commands[] = {"documentclass", "LoadClass",
+                                "LoadClassWithOptions"};
+
+inline bool is_space(char ch) {
+  return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+} // namespace
+
+Indexer::Indexer(const TSLanguage *language) {
+  uint32_t count = ts_language_symbol_count(language);
+
+  kinds.assign(count, KIND_COUNT);
+  skipped.assign(count, false);
+  groups.assign(count, false);
+  optionals.assign(count, false);
+  rights.assign(count, false);
+
+  // Aliases have their own symbols so every symbol with a matching name is
+  // marked.
+  for (TSSymbol symbol = 0; symbol < count; symbol++) {
+    const char *name = ts_language_symbol_name(language, symbol);
+
+    if (!name ||
+        ts_language_symbol_type(language, symbol) != TSSymbolTypeRegular) {
+      continue;
+    }
+
+    for (const IndexedType &type : indexed_types) {
+      if (std::strcmp(name, type.name) == 0) {
+        kinds[symbol] = type.kind;
+      }
+    }
+
+    for (const char *type : skipped_types) {
+      if (std::strcmp(name, type) == 0) {
+        skipped[symbol] = true;
+      }
+    }
+
+    groups[symbol] = std::strcmp(name, "group") == 0;
+    optionals[symbol] = std::strcmp(name, "star") == 0 ||
+                        std::strcmp(name, "brack_group") == 0;
+    rights[symbol] = std::strcmp(name, "r") == 0;
+  }
+}
+
+int8_t Indexer::section_level(TSNode node, const char *source) const {
+  TSNode cs = ts_node_child(node, 0);
+  uint32_t start = ts_node_start_byte(cs) + 1, end = ts_node_end_byte(cs);
+
+  for (const SectionLevel &section : section_levels) {
+    if (std::strlen(section.name) == end - start &&
+        std::strncmp(source + start, section.name, end - start) == 0) {
+      return section.level;
+    }
+  }
+
+  return 1;
+}
+
+bool Indexer::is_class(TSNode node, const char *source) const {
+  TSNode cs = ts_node_child(node, 0);
+  uint32_t start = ts_node_start_byte(cs) + 1, end = ts_node_end_byte(cs);
+
+  for (const char *name : class_commands) {
+    if (std::strlen(name) == end - start &&
+        std::strncmp(source + start, name, end - start) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void Indexer::add_keys(std::vector<IndexEntry> &entries, IndexEntry entry,
+                       TSNode parameter, const char *source, bool list) const {
+  uint32_t start = ts_node_start_byte(parameter);
+  uint32_t end = ts_node_end_byte(parameter);
+  TSSymbol symbol = ts_node_symbol(parameter);
+
+  // Only the contents of a group are part of the key.
+  if (symbol < groups.size() && groups[symbol]) {
+    uint32_t count = ts_node_child_count(parameter);
+
+    if (count > 0) {
+      start = ts_node_end_byte(ts_node_child(parameter, 0));
+    }
+
+    if (count > 1) {
+      TSNode last = ts_node_child(parameter, count - 1);
+      TSSymbol last_symbol = ts_node_symbol(last);
+
+      if (last_symbol < rights.size() && rights[last_symbol]) {
+        end = ts_node_start_byte(last);
+      }
+    }
+  }
+
+  while (start < end) {
+    uint32_t next = end;
+
+    if (list) {
+      const void *comma = std::memchr(source + start, ',', end - start);
+      if (comma) {
+        next = static_cast<const char *>(comma) - source;
+      }
+    }
+
+    entry.key_start = start;
+    entry.key_end = next;
+
+    while (entry.key_start < entry.key_end &&
+           is_space(source[entry.key_start])) {
+      entry.key_start++;
+    }
+
+    while (entry.key_start < entry.key_end &&
+           is_space(source[entry.key_end - 1])) {
+      entry.key_end--;
+    }
+
+    if (entry.key_start < entry.key_end) {
+      entries.push_back(entry);
+    }
+
+    start = next + 1;
+  }
+}
+
+void Indexer::add_command(std::vector<IndexEntry> &entries, TSNode node,
+                          IndexKind kind, const char *source) {
+  IndexEntry entry;
+  size_t first = entries.size();
+  uint32_t count = ts_node_child_count(node);
+  bool list = kind == REF_KIND || kind == CITE_KIND || kind == PACKAGE_KIND;
+
+  if (kind == PACKAGE_KIND && is_class(node, source)) {
+    kind = CLASS_KIND;
+  }
+
+  entry.kind = kind;
+  entry.level = 0;
+  entry.start_byte = ts_node_start_byte(node);
+  entry.end_byte = ts_node_end_byte(node);
+  entry.key_start = entry.key_end = entry.end_byte;
+
+  if (kind == SECTION_KIND) {
+    entry.level = section_level(node, source);
+
+    while (!sections.empty() && sections.back().first >= entry.level) {
+      sections.pop_back();
+    }
+  }
+
+  entry.section = sections.empty() ? NO_SECTION : sections.back().second;
+
+  // The first child is the control sequence. Stars and optional parameters
+  // are skipped. Lists of references and citations take every mandatory
+  // parameter, e.g. \crefrange or \cites. Everything else only the first.
+  // The only mandatory parameter of \usepackage is the list of names.
+  for (uint32_t i = 1; i < count; i++) {
+    TSNode child = ts_node_child(node, i);
+    TSSymbol symbol = ts_node_symbol(child);
+
+    if (!ts_node_is_named(child) || ts_node_is_extra(child) ||
+        (symbol < optionals.size() && optionals[symbol])) {
+      continue;
+    }
+
+    add_keys(entries, entry, child, source, list);
+
+    if (!list) {
+      break;
+    }
+  }
+
+  if (kind == SECTION_KIND) {
+    // A section without a title still encloses what follows it.
+    if (entries.size() == first) {
+      entries.push_back(entry);
+    }
+
+    sections.emplace_back(entry.level, static_cast<int32_t>(first));
+  }
+}
+
+void Indexer::extract(std::vector<IndexEntry> &entries, TSNode root,
+                      const char *source, uint32_t start_byte,
+                      uint32_t end_byte) {
+  TSTreeCursor cursor = ts_tree_cursor_new(root);
+
+  sections.clear();
+
+  while (true) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    TSSymbol symbol = ts_node_symbol(node);
+    bool enter = true;
+
+    // Nodes are visited in order so nothing after this can be in range.
+    if (ts_node_start_byte(node) >= end_byte) {
+      break;
+    }
+
+    // Error nodes have a symbol outside of the language's symbol table.
+    if (symbol < kinds.size()) {
+      enter = !skipped[symbol];
+
+      if (kinds[symbol] != KIND_COUNT) {
+        if (ts_node_start_byte(node) >= start_byte) {
+          add_command(entries, node, kinds[symbol], source);
+        }
+        // Labels in section titles are indexed. Those inside the other
+        // commands, e.g. in a definition, are not real occurrences.
+        enter = kinds[symbol] == SECTION_KIND;
+      }
+    }
+
+    // Skip straight to the first child that reaches into the range.
+    if (enter &&
+        ts_tree_cursor_goto_first_child_for_byte(&cursor, start_byte) >= 0) {
+      continue;
+    }
+
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        ts_tree_cursor_delete(&cursor);
+        return;
+      }
+    }
+  }
+
+  ts_tree_cursor_delete(&cursor);
+}
+
+void Indexer::expand(TSNode root, uint32_t &start_byte,
+                     uint32_t &end_byte) const {
+  // An edit clips the nodes that reach into the replaced text so that they
+  // end at the start of the edit, hence the byte before the range.
+  uint32_t offsets[] = {(start_byte > 0) ? start_byte - 1 : 0,
+                        (end_byte > start_byte) ? end_byte - 1 : start_byte};
+
+  for (uint32_t offset : offsets) {
+    TSTreeCursor cursor = ts_tree_cursor_new(root);
+
+    while (ts_tree_cursor_goto_first_child_for_byte(&cursor, offset) >= 0) {
+      TSNode node = ts_tree_cursor_current_node(&cursor);
+      TSSymbol symbol = ts_node_symbol(node);
+
+      if (ts_node_start_byte(node) > offset) {
+        break;
+      }
+
+      if (symbol < kinds.size() && kinds[symbol] != KIND_COUNT) {
+        start_byte = std::min(start_byte, ts_node_start_byte(node));
+        end_byte = std::max(end_byte, ts_node_end_byte(node));
+      }
+    }
+
+    ts_tree_cursor_delete(&cursor);
+  }
+}
+
+uint32_t SectionOffsets::at(size_t index, uint32_t length) const {
+  return (index < gap_start) ? offsets[index]
+                             : length - offsets[index + gap_end - gap_start];
+}
+
+void SectionOffsets::clear() {
+  offsets.clear();
+  gap_start = gap_end = 0;
+}
+
+void SectionOffsets::erase(uint32_t start_byte, uint32_t end_byte,
+                           uint32_t length) {
+  while (gap_start > 0 && offsets[gap_start - 1] >= start_byte) {
+    offsets[--gap_end] = length - offsets[--gap_start];
+  }
+
+  while (gap_end < offsets.size() && length - offsets[gap_end] < start_byte) {
+    offsets[gap_start++] = length - offsets[gap_end++];
+  }
+
+  while (gap_end < offsets.size() && length - offsets[gap_end] < end_byte) {
+    gap_end++;
+  }
+}
+
+void SectionOffsets::insert(uint32_t offset) {
+  if (gap_start == gap_end) {
+    size_t tail = offsets.size() - gap_end;
+
+    offsets.resize(std::max<size_t>(16, 2 * offsets.size()));
+    std::move_backward(offsets.begin() + gap_end,
+                       offsets.begin() + gap_end + tail, offsets.end());
+    gap_end = offsets.size() - tail;
+  }
+
+  offsets[gap_start++] = offset;
+}
+
+uint32_t SectionOffsets::last_before(uint32_t offset, uint32_t length) const {
+  size_t first = 0, last = offsets.size() - (gap_end - gap_start);
+
+  while (first < last) {
+    size_t middle = first + (last - first) / 2;
+
+    if (at(middle, length) < offset) {
+      first = middle + 1;
+    } else {
+      last = middle;
+    }
+  }
+
+  return (first > 0) ? at(first - 1, length) : UINT32_MAX;
+}
+
+// Converts the offsets of an entry between absolute and relative to the end
+// of the document. The conversion is its own inverse.
+IndexEntry IncrementalIndex::flip(IndexEntry entry) const {
+  entry.start_byte = length - entry.start_byte;
+  entry.end_byte = length - entry.end_byte;
+  entry.key_start = length - entry.key_start;
+  entry.key_end = length - entry.key_end;
+
+  return entry;
+}
+
+void IncrementalIndex::move_gap(uint32_t offset) {
+  while (gap_start > 0 && entries[gap_start - 1].start_byte >= offset) {
+    entries[--gap_end] = flip(entries[--gap_start]);
+  }
+
+  while (gap_end < entries.size() &&
+         length - entries[gap_end].start_byte < offset) {
+    entries[gap_start++] = flip(entries[gap_end++]);
+  }
+}
+
+void IncrementalIndex::insert(const IndexEntry &entry) {
+  if (gap_start == gap_end) {
+    size_t tail = entries.size() - gap_end;
+
+    entries.resize(std::max<size_t>(16, 2 * entries.size()));
+    std::move_backward(entries.begin() + gap_end,
+                       entries.begin() + gap_end + tail, entries.end());
+    gap_end = entries.size() - tail;
+  }
+
+  entries[gap_start++] = entry;
+}
+
+uint32_t IncrementalIndex::erase(uint32_t start_byte, uint32_t end_byte) {
+  uint32_t tail = UINT32_MAX;
+
+  move_gap(start_byte);
+
+  while (gap_end < entries.size() &&
+         length - entries[gap_end].start_byte < end_byte) {
+    tail = std::min(tail, entries[gap_end].end_byte);
+    gap_end++;
+  }
+
+  for (SectionOffsets &offsets : sections) {
+    offsets.erase(start_byte, end_byte, length);
+  }
+
+  return tail;
+}
+
+void IncrementalIndex::replace(TSNode root, const char *source,
+                               uint32_t start_byte, uint32_t end_byte) {
+  erase(start_byte, end_byte);
+
+  extracted.clear();
+  indexer.extract(extracted, root, source, start_byte, end_byte);
+
+  for (IndexEntry &entry : extracted) {
+    if (entry.kind == SECTION_KIND) {
+      sections[entry.level - MIN_SECTION_LEVEL].insert(entry.start_byte);
+    }
+
+    entry.section = NO_SECTION;
+    insert(entry);
+  }
+}
+
+void IncrementalIndex::reset(const TSTree *tree, const char *source,
+                             uint32_t length) {
+  entries.clear();
+  gap_start = gap_end = 0;
+  this->length = length;
+
+  for (SectionOffsets &offsets : sections) {
+    offsets.clear();
+  }
+
+  replace(ts_tree_root_node(tree), source, 0, length);
+}
+
+void IncrementalIndex::update(const TSTree *old_tree, const TSTree *new_tree,
+                              const TSInputEdit &edit, const char *source) {
+  // Drop the entries that start in the replaced text. The end relative
+  // offsets after the gap then follow the change in length.
+  uint32_t tail = erase(edit.start_byte, edit.old_end_byte);
+
+  length = length - edit.old_end_byte + edit.new_end_byte;
+
+  uint32_t count = 0;
+  TSRange *changed = ts_tree_get_changed_ranges(old_tree, new_tree, &count);
+  std::vector<std::pair<uint32_t, uint32_t>> ranges;
+
+  // The text covered by the dropped entries has to be indexed again.
+  ranges.emplace_back(edit.start_byte,
+                      (tail == UINT32_MAX)
+                          ? edit.new_end_byte
+                          : std::max(edit.new_end_byte, length - tail));
+
+  for (uint32_t i = 0; i < count; i++) {
+    ranges.emplace_back(changed[i].start_byte, changed[i].end_byte);
+  }
+
+  std::free(changed);
+
+  // A command that overlaps a range in the old tree has an entry that has to
+  // be removed and one in the new tree has to be extracted again.
+  TSNode old_root = ts_tree_root_node(old_tree);
+  TSNode new_root = ts_tree_root_node(new_tree);
+
+  for (auto &range : ranges) {
+    indexer.expand(old_root, range.first, range.second);
+    indexer.expand(new_root, range.first, range.second);
+  }
+
+  std::sort(ranges.begin(), ranges.end());
+
+  for (size_t i = 0; i < ranges.size();) {
+    uint32_t start_byte = ranges[i].first, end_byte = ranges[i].second;
+
+    for (i++; i < ranges.size() && ranges[i].first <= end_byte; i++) {
+      end_byte = std::max(end_byte, ranges[i].second);
+    }
+
+    replace(new_root, source, start_byte, end_byte);
+  }
+}
+
+IndexEntry IncrementalIndex::operator[](size_t index) const {
+  return (index < gap_start) ? entries[index]
+                             : flip(entries[index + gap_end - gap_start]);
+}
+
+size_t IncrementalIndex::lower_bound(uint32_t offset) const {
+  size_t first = 0, last = size();
+
+  while (first < last) {
+    size_t middle = first + (last - first) / 2;
+
+    if ((*this)[middle].start_byte < offset) {
+      first = middle + 1;
+    } else {
+      last = middle;
+    }
+  }
+
+  return first;
+}
+
+std::vector<size_t> IncrementalIndex::enclosing_sections(uint32_t offset,
+                                                         int level) const {
+  std::vector<size_t> path;
+
+  // The enclosing section is the closest one before the offset with a lower
+  // level, which in turn is enclosed by the closest one before it with a
+  // lower level still.
+  while (level > 0) {
+    uint32_t closest = UINT32_MAX;
+    int closest_level = 0;
+
+    for (int i = 0; i < level; i++) {
+      uint32_t start = sections[i].last_before(offset, length);
+
+      if (start != UINT32_MAX && (closest == UINT32_MAX || start > closest)) {
+        closest = start;
+        closest_level = i;
+      }
+    }
+
+    if (closest == UINT32_MAX) {
+      break;
+    }
+
+    path.push_back(lower_bound(closest));
+    level = closest_level;
+    offset = closest;
+  }
+
+  std::reverse(path.begin(), path.end());
+
+  return path;
+}
+
+std::vector<size_t> IncrementalIndex::section_path(size_t index) const {
+  IndexEntry entry = (*this)[index];
+
+  return enclosing_sections(entry.start_byte,
+                            (entry.kind == SECTION_KIND)
+                                ? entry.level - MIN_SECTION_LEVEL
+                                : SECTION_LEVEL_COUNT);
+}
+
+} // namespace LaTeX
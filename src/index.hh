@@ -0,0 +1,175 @@
+#ifndef INDEX_HH_
+#define INDEX_HH_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "tree_sitter/api.h"
+
+namespace LaTeX {
+
+enum IndexKind : uint8_t {
+  LABEL_KIND,
+  REF_KIND,
+  CITE_KIND,
+  SECTION_KIND,
+  BIBITEM_KIND,
+  NEWCOMMAND_KIND,
+  NEWENVIRONMENT_KIND,
+  NEWGLOSSARYENTRY_KIND,
+  // Files read by \input, \include and \InputIfFileExists or tested by
+  // \IfFileExists.
+  INPUT_KIND,
+  // Packages and classes loaded by \usepackage, \documentclass and the
+  // like. Each name in a list produces a record.
+  PACKAGE_KIND,
+  CLASS_KIND,
+  KIND_COUNT
+};
+
+const int32_t NO_SECTION = -1;
+
+// A single record in the structural index. The key is given as a byte range
+// in the source, e.g. the label name or the section title. Each list of keys
+// in a \ref or \cite produces a record per key. The section path of a record
+// is found by following section from entry to entry until NO_SECTION.
+struct IndexEntry {
+  IndexKind kind;
+  // The sectioning level for SECTION_KIND, i.e. 0 for \chapter and 1 for
+  // \section. The level of \part is -1.
+  int8_t level;
+  int32_t section;
+  uint32_t start_byte, end_byte;
+  uint32_t key_start, key_end;
+};
+
+// Extracts labels, references, citations, sectioning and definitions from a
+// syntax tree. The node types are resolved to symbols once per language so
+// that the walk itself only compares symbols. Subtrees that cannot contain an
+// indexed command like verbatim and comments are not entered.
+class Indexer {
+  // The kind for each symbol or KIND_COUNT if it is not indexed.
+  std::vector<IndexKind> kinds;
+  // Symbols whose subtree is never entered.
+  std::vector<bool> skipped;
+  std::vector<bool> groups, optionals, rights;
+
+  // The sections that enclose the current position as (level, entry).
+  std::vector<std::pair<int8_t, int32_t>> sections;
+
+  int8_t section_level(TSNode node, const char *source) const;
+
+  bool is_class(TSNode node, const char *source) const;
+
+  void add_keys(std::vector<IndexEntry> &entries, IndexEntry entry,
+                TSNode parameter, const char *source, bool list) const;
+
+  void add_command(std::vector<IndexEntry> &entries, TSNode node,
+                   IndexKind kind, const char *source);
+
+public:
+  Indexer(const TSLanguage *language);
+
+  // Appends the records for the tree below root to entries. With a byte
+  // range only the commands that start inside it are extracted and the
+  // section of a record can only refer to a record from the same call.
+  void extract(std::vector<IndexEntry> &entries, TSNode root,
+               const char *source, uint32_t start_byte = 0,
+               uint32_t end_byte = UINT32_MAX);
+
+  // Widens a byte range so that it covers every indexed command in the tree
+  // that overlaps either end of it.
+  void expand(TSNode root, uint32_t &start_byte, uint32_t &end_byte) const;
+};
+
+// The levels from \part to \subparagraph.
+const int8_t MIN_SECTION_LEVEL = -1;
+const int SECTION_LEVEL_COUNT = 7;
+
+// The start offsets of the sections of one level, held in a gap buffer like
+// the entries of an IncrementalIndex and moved along with them.
+class SectionOffsets {
+  std::vector<uint32_t> offsets;
+  size_t gap_start = 0, gap_end = 0;
+
+  uint32_t at(size_t index, uint32_t length) const;
+
+public:
+  void clear();
+
+  // Moves the gap to start_byte and drops the offsets before end_byte that
+  // follow it.
+  void erase(uint32_t start_byte, uint32_t end_byte, uint32_t length);
+
+  // Inserts an offset at the gap. Offsets have to be inserted in order.
+  void insert(uint32_t offset);
+
+  // The last offset before the given one or UINT32_MAX if there is none.
+  uint32_t last_before(uint32_t offset, uint32_t length) const;
+};
+
+// Keeps the index of a document current as it is edited. The entries are
+// held in a gap buffer that is moved to each edit. Entries after the gap
+// store their offsets from the end of the document so an edit shifts them
+// without touching them. An update costs time in proportion to the changed
+// ranges and the distance between edits instead of the document size. The
+// section of each entry is NO_SECTION, use section_path instead, which
+// looks the sections up by level.
+class IncrementalIndex {
+  Indexer indexer;
+  std::vector<IndexEntry> entries, extracted;
+  size_t gap_start = 0, gap_end = 0;
+  uint32_t length = 0;
+  SectionOffsets sections[SECTION_LEVEL_COUNT];
+
+  IndexEntry flip(IndexEntry entry) const;
+
+  void move_gap(uint32_t offset);
+
+  // The sections before offset with a level below the given one that
+  // enclose each other, outermost first. Levels count from
+  // MIN_SECTION_LEVEL.
+  std::vector<size_t> enclosing_sections(uint32_t offset, int level) const;
+
+  // Drops the entries that start between the two offsets and leaves the gap
+  // in their place. Returns the distance from the furthest end of a dropped
+  // entry to the end of the document or UINT32_MAX if none was dropped.
+  uint32_t erase(uint32_t start_byte, uint32_t end_byte);
+
+  void insert(const IndexEntry &entry);
+
+  void replace(TSNode root, const char *source, uint32_t start_byte,
+               uint32_t end_byte);
+
+public:
+  IncrementalIndex(const TSLanguage *language) : indexer(language) {}
+
+  // Rebuilds the index from scratch.
+  void reset(const TSTree *tree, const char *source, uint32_t length);
+
+  // Updates the index after an edit. The edit has to be applied to old_tree
+  // with ts_tree_edit and new_tree be the result of reparsing source with it.
+  void update(const TSTree *old_tree, const TSTree *new_tree,
+              const TSInputEdit &edit, const char *source);
+
+  size_t size() const { return entries.size() - (gap_end - gap_start); }
+
+  IndexEntry operator[](size_t index) const;
+
+  // The index of the first entry that starts at or after offset.
+  size_t lower_bound(uint32_t offset) const;
+
+  // The indices of the sections that enclose an entry, outermost first. It
+  // takes a binary search per level and section in the path.
+  std::vector<size_t> section_path(size_t index) const;
+
+  // The indices of the sections that enclose an offset, outermost first.
+  std::vector<size_t> section_path_at(uint32_t offset) const {
+    return enclosing_sections(offset, SECTION_LEVEL_COUNT);
+  }
+};
+
+} // namespace LaTeX
+
+#endif
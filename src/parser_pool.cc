@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "parser_pool.hh"
+
+namespace LaTeX {
+
+namespace {
+
+const uint64_t INDEX_MASK = 0xffffffffull;
+
+// Touches the common paths of the scanner and the parse table.
+const char *const WARM_UP_DOCUMENT =
+    "\\documentclass{article}\n\\begin{document}\n\\section{Warm up}\n"
+    "Text $x^2$ % comment\n\\end{document}\n";
+
+} // namespace
+
+PooledParser::PooledParser(PooledParser &&other)
+    : pool(other.pool), parser(other.parser), slot(other.slot) {
+  other.pool = nullptr;
+  other.parser = nullptr;
+}
+
+PooledParser &PooledParser::operator=(PooledParser &&other) {
+  if (this != &other) {
+    release();
+    pool = other.pool;
+    parser = other.parser;
+    slot = other.slot;
+    other.pool = nullptr;
+    other.parser = nullptr;
+  }
+
+  return *this;
+}
+
+void PooledParser::release() {
+  if (pool) {
+    pool->release(parser, slot);
+    pool = nullptr;
+    parser = nullptr;
+  }
+}
+
+ParserPool::ParserPool(const TSLanguage *language, uint32_t capacity,
+                       uint32_t prefill)
+    : language(language), capacity(std::min(capacity, NO_SLOT - 1)),
+      slots(new Slot[this->capacity]), head(0), created(0), hits(0),
+      misses(0), overflows(0) {
+  prefill = std::min(prefill, this->capacity);
+
+  for (uint32_t i = 0; i < prefill; i++) {
+    TSParser *parser = create();
+    TSTree *tree = ts_parser_parse_string(parser, nullptr, WARM_UP_DOCUMENT,
+                                          std::strlen(WARM_UP_DOCUMENT));
+
+    if (tree) {
+      ts_tree_delete(tree);
+    }
+
+    ts_parser_reset(parser);
+    slots[i].parser = parser;
+    created.fetch_add(1, std::memory_order_relaxed);
+    push(i);
+  }
+}
+
+ParserPool::~ParserPool() {
+  uint32_t count = std::min(created.load(), capacity);
+
+  for (uint32_t i = 0; i < count; i++) {
+    ts_parser_delete(slots[i].parser);
+  }
+}
+
+TSParser *ParserPool::create() const {
+  TSParser *parser = ts_parser_new();
+  ts_parser_set_language(parser, language);
+  return parser;
+}
+
+bool ParserPool::pop(uint32_t &slot) {
+  uint64_t top = head.load(std::memory_order_acquire);
+
+  while ((top & INDEX_MASK) != 0) {
+    uint32_t index = static_cast<uint32_t>(top & INDEX_MASK) - 1;
+    // The slot may have been taken and put back since top was read, which
+    // changes the tag and makes the exchange fail.
+    uint64_t next = ((top >> 32) + 1) << 32 |
+                    slots[index].next.load(std::memory_order_relaxed);
+
+    if (head.compare_exchange_weak(top, next, std::memory_order_acquire,
+                                   std::memory_order_acquire)) {
+      slot = index;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ParserPool::push(uint32_t slot) {
+  uint64_t top = head.load(std::memory_order_relaxed);
+  uint64_t next;
+
+  do {
+    slots[slot].next.store(static_cast<uint32_t>(top & INDEX_MASK),
+                           std::memory_order_relaxed);
+    next = ((top >> 32) + 1) << 32 | (slot + 1);
+  } while (!head.compare_exchange_weak(top, next, std::memory_order_release,
+                                       std::memory_order_relaxed));
+}
+
+PooledParser ParserPool::checkout() {
+  auto start = std::chrono::steady_clock::now();
+  uint32_t slot;
+  TSParser *parser;
+
+  if (pop(slot)) {
+    hits.fetch_add(1, std::memory_order_relaxed);
+    parser = slots[slot].parser;
+  } else {
+    uint32_t count = created.load(std::memory_order_relaxed);
+
+    while (count < capacity &&
+           !created.compare_exchange_weak(count, count + 1,
+                                          std::memory_order_relaxed)) {
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    parser = create();
+
+    if (count < capacity) {
+      slot = count;
+      slots[slot].parser = parser;
+    } else {
+      slot = NO_SLOT;
+      overflows.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  checkout_nanos.add(static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count()));
+
+  return PooledParser(this, parser, slot);
+}
+
+void ParserPool::release(TSParser *parser, uint32_t slot) {
+  if (slot == NO_SLOT) {
+    ts_parser_delete(parser);
+    return;
+  }
+
+  ts_parser_reset(parser);
+  ts_parser_set_timeout_micros(parser, 0);
+  ts_parser_set_cancellation_flag(parser, nullptr);
+  ts_parser_set_included_ranges(parser, nullptr, 0);
+  push(slot);
+}
+
+ParserPoolStats ParserPool::stats() const {
+  ParserPoolStats stats;
+
+  stats.hits = hits.load(std::memory_order_relaxed);
+  stats.misses = misses.load(std::memory_order_relaxed);
+  stats.overflows = overflows.load(std::memory_order_relaxed);
+  stats.checkout_nanos = checkout_nanos.snapshot();
+  return stats;
+}
+
+} // namespace LaTeX
@@ -0,0 +1,115 @@
+#ifndef PARSER_POOL_HH_
+#define PARSER_POOL_HH_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "tree_sitter/api.h"
+
+#include "histogram.hh"
+
+namespace LaTeX {
+
+class ParserPool;
+
+// A parser checked out of a pool, which goes back to the pool when this is
+// destroyed.
+class PooledParser {
+  ParserPool *pool = nullptr;
+  TSParser *parser = nullptr;
+  uint32_t slot = 0;
+
+  PooledParser(ParserPool *pool, TSParser *parser, uint32_t slot)
+      : pool(pool), parser(parser), slot(slot) {}
+
+  friend class ParserPool;
+
+public:
+  PooledParser() {}
+
+  PooledParser(PooledParser &&other);
+
+  PooledParser &operator=(PooledParser &&other);
+
+  ~PooledParser() { release(); }
+
+  TSParser *get() const { return parser; }
+
+  operator TSParser *() const { return parser; }
+
+  // Returns the parser to the pool before this is destroyed.
+  void release();
+};
+
+struct ParserPoolStats {
+  // Checkouts served by a parser from the pool and those that had to create
+  // one.
+  uint64_t hits, misses;
+  // Parsers created beyond the capacity, which are deleted on release.
+  uint64_t overflows;
+  // The time a checkout took in nanoseconds.
+  LatencyHistogram checkout_nanos;
+};
+
+// Keeps parsers ready for use so that a request does not pay for creating a
+// parser, and with it a LaTeX::Scanner with its catcode table and UTF-8
+// converter. The free parsers are held in a lock free stack of slot indices
+// whose head carries a tag against the ABA problem. A parser is reset with
+// ts_parser_reset when it is returned, which drops any half finished parse,
+// and its timeout, cancellation flag and included ranges are cleared. The
+// scanner state is restored from the start state by the next parse anyway.
+//
+// Parsers are created on demand up to the capacity. A checkout when all of
+// them are in use creates a parser that is deleted on release. The scanner
+// options such as tree_sitter_latex_set_merge_comments are those in effect
+// when a parser is created.
+class ParserPool {
+  struct Slot {
+    TSParser *parser = nullptr;
+    std::atomic<uint32_t> next;
+  };
+
+  const TSLanguage *language;
+  uint32_t capacity;
+  std::unique_ptr<Slot[]> slots;
+  // The tag in the high half and one more than the index of the top slot in
+  // the low half, zero if the stack is empty.
+  std::atomic<uint64_t> head;
+  std::atomic<uint32_t> created;
+  std::atomic<uint64_t> hits, misses, overflows;
+  ConcurrentLatencyHistogram checkout_nanos;
+
+  TSParser *create() const;
+
+  bool pop(uint32_t &slot);
+
+  void push(uint32_t slot);
+
+  void release(TSParser *parser, uint32_t slot);
+
+  friend class PooledParser;
+
+public:
+  static const uint32_t NO_SLOT = UINT32_MAX;
+
+  // Creates prefill parsers up front and has each parse a short document,
+  // so that the first requests do not touch the scanner tables for the
+  // first time either.
+  ParserPool(const TSLanguage *language, uint32_t capacity = 64,
+             uint32_t prefill = 0);
+
+  ~ParserPool();
+
+  ParserPool(const ParserPool &) = delete;
+
+  ParserPool &operator=(const ParserPool &) = delete;
+
+  PooledParser checkout();
+
+  ParserPoolStats stats() const;
+};
+
+} // namespace LaTeX
+
+#endif
@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <thread>
+
+#include "budget.hh"
+#include "project.hh"
+
+namespace LaTeX {
+
+namespace {
+
+bool is_file(const std::string &path) {
+  struct stat status;
+  return stat(path.c_str(), &status) == 0 && S_ISREG(status.st_mode);
+}
+
+bool canonical_path(const std::string &path, std::string &result) {
+  char buffer[PATH_MAX];
+
+  if (!realpath(path.c_str(), buffer)) {
+    return false;
+  }
+
+  result = buffer;
+
+  return true;
+}
+
+bool has_extension(const std::string &name) {
+  size_t dot = name.rfind('.');
+  return dot != std::string::npos &&
+         (name.rfind('/') == std::string::npos || name.rfind('/') < dot);
+}
+
+} // namespace
+
+Project::Project(const TSLanguage *language, unsigned thread_count)
+    : language(language), thread_count(thread_count) {
+  if (this->thread_count == 0) {
+    this->thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+}
+
+Project::~Project() {
+  for (auto &file : file_list) {
+    if (file->tree) {
+      ts_tree_delete(file->tree);
+    }
+  }
+}
+
+void Project::add_search_path(const std::string &path) {
+  search_paths.push_back(path);
+}
+
+bool Project::resolve(const std::string &name, IndexKind kind,
+                      std::string &path) const {
+  std::vector<std::string> candidates;
+
+  if (kind == PACKAGE_KIND) {
+    candidates.push_back(name + ".sty");
+  } else if (kind == CLASS_KIND) {
+    candidates.push_back(name + ".cls");
+  } else {
+    // TeX tries the name with .tex added first.
+    if (!has_extension(name)) {
+      candidates.push_back(name + ".tex");
+    }
+
+    candidates.push_back(name);
+  }
+
+  for (const std::string &candidate : candidates) {
+    if (candidate[0] == '/') {
+      if (is_file(candidate)) {
+        return canonical_path(candidate, path);
+      }
+
+      continue;
+    }
+
+    if (is_file(root_directory + "/" + candidate)) {
+      return canonical_path(root_directory + "/" + candidate, path);
+    }
+
+    for (const std::string &directory : search_paths) {
+      if (is_file(directory + "/" + candidate)) {
+        return canonical_path(directory + "/" + candidate, path);
+      }
+    }
+  }
+
+  // Checking the database last keeps the probes above for the few files of
+  // the project itself.
+  for (const std::string &candidate : candidates) {
+    if (database && candidate[0] != '/' && database->find(candidate, path) &&
+        canonical_path(path, path)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Has to be called with the lock held.
+size_t Project::add_file(const std::string &path) {
+  auto it = file_ids.find(path);
+
+  if (it != file_ids.end()) {
+    return it->second;
+  }
+
+  size_t id = file_list.size();
+
+  file_list.emplace_back(new ProjectFile());
+  file_list.back()->path = path;
+  file_ids[path] = id;
+  queue.push_back(id);
+  pending++;
+  condition.notify_one();
+
+  return id;
+}
+
+void Project::parse_file(ProjectFile &file, TSParser *parser,
+                         Indexer &indexer) {
+  std::ifstream stream(file.path, std::ios::binary);
+  std::stringstream contents;
+  contents << stream.rdbuf();
+
+  file.source = contents.str();
+
+  BudgetedParse result = parse_with_budget(
+      parser, nullptr, file.source.data(),
+      static_cast<uint32_t>(file.source.length()),
+      (budget_micros == 0) ? std::chrono::steady_clock::time_point::max()
+                           : std::chrono::steady_clock::now() +
+                                 std::chrono::microseconds(budget_micros));
+
+  file.tree = result.tree;
+
+  if (file.tree) {
+    indexer.extract(file.entries, ts_tree_root_node(file.tree),
+                    file.source.data());
+  } else {
+    file.budget_offset = result.offset;
+  }
+}
+
+void Project::work() {
+  TSParser *parser = ts_parser_new();
+  Indexer indexer(language);
+  std::vector<std::pair<std::string, bool>> references;
+
+  ts_parser_set_language(parser, language);
+
+  while (true) {
+    ProjectFile *file;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+
+      condition.wait(lock, [this] { return !queue.empty() || pending == 0; });
+
+      if (queue.empty()) {
+        break;
+      }
+
+      file = file_list[queue.front()].get();
+      queue.pop_front();
+    }
+
+    parse_file(*file, parser, indexer);
+    references.clear();
+
+    // Resolving touches the file system so it is done before taking the
+    // lock.
+    for (const IndexEntry &entry : file->entries) {
+      if (entry.kind == INPUT_KIND || entry.kind == PACKAGE_KIND ||
+          entry.kind == CLASS_KIND) {
+        std::string name(file->source, entry.key_start,
+                         entry.key_end - entry.key_start), path;
+
+        if (resolve(name, entry.kind, path)) {
+          references.emplace_back(path, true);
+        } else {
+          references.emplace_back(name, false);
+        }
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto &reference : references) {
+      if (reference.second) {
+        file->dependencies.push_back(add_file(reference.first));
+      } else {
+        file->missing.push_back(reference.first);
+      }
+    }
+
+    if (--pending == 0) {
+      condition.notify_all();
+    }
+  }
+
+  ts_parser_delete(parser);
+}
+
+bool Project::load(const std::string &root) {
+  std::string path;
+
+  if (!file_list.empty() || !is_file(root) || !canonical_path(root, path)) {
+    return false;
+  }
+
+  root_directory = path.substr(0, path.rfind('/'));
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    add_file(path);
+  }
+
+  std::vector<std::thread> threads;
+
+  for (unsigned i = 0; i < thread_count; i++) {
+    threads.emplace_back(&Project::work, this);
+  }
+
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  return true;
+}
+
+std::vector<std::pair<size_t, size_t>> Project::cycles() const {
+  enum Color : uint8_t { WHITE, GRAY, BLACK };
+  std::vector<std::pair<size_t, size_t>> result;
+  std::vector<Color> colors(file_list.size(), WHITE);
+  // The files on the current path with the next dependency to visit.
+  std::vector<std::pair<size_t, size_t>> stack;
+
+  for (size_t start = 0; start < file_list.size(); start++) {
+    if (colors[start] != WHITE) {
+      continue;
+    }
+
+    colors[start] = GRAY;
+    stack.emplace_back(start, 0);
+
+    while (!stack.empty()) {
+      size_t id = stack.back().first;
+      size_t &next = stack.back().second;
+      const std::vector<size_t> &dependencies = file_list[id]->dependencies;
+
+      if (next == dependencies.size()) {
+        colors[id] = BLACK;
+        stack.pop_back();
+        continue;
+      }
+
+      size_t dependency = dependencies[next++];
+
+      if (colors[dependency] == GRAY) {
+        result.emplace_back(id, dependency);
+      } else if (colors[dependency] == WHITE) {
+        colors[dependency] = GRAY;
+        stack.emplace_back(dependency, 0);
+      }
+    }
+  }
+
+  return result;
+}
+
+} // namespace LaTeX
@@ -0,0 +1,108 @@
+#ifndef PROJECT_HH_
+#define PROJECT_HH_
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "file_database.hh"
+#include "index.hh"
+
+namespace LaTeX {
+
+// A file of a project together with its syntax tree and index.
+struct ProjectFile {
+  // The resolved path, which identifies the file.
+  std::string path;
+  std::string source;
+  // Null when the parse ran out of budget, in which case there are no
+  // entries either.
+  TSTree *tree = nullptr;
+  // How far the parse got when it ran out of budget.
+  uint32_t budget_offset = 0;
+  std::vector<IndexEntry> entries;
+  // The files referenced from this one as indices into Project::files, in
+  // the order of the references.
+  std::vector<size_t> dependencies;
+  // The names of references that could not be resolved.
+  std::vector<std::string> missing;
+};
+
+// Parses a project starting from its root file. Every file that is found
+// through \input, \include, \usepackage, \documentclass or \IfFileExists is
+// scheduled on a pool of threads as soon as the reference is indexed, so
+// files are parsed while the ones that reference them are still being
+// worked on. Each file is parsed once no matter how often it is referenced.
+//
+// Names are resolved like TeX does, i.e. relative to the directory of the
+// root file, then the search paths and finally the filename database,
+// adding .tex to inputs without an extension, .sty to packages and .cls to
+// classes.
+class Project {
+  const TSLanguage *language;
+  unsigned thread_count;
+  uint64_t budget_micros = 0;
+  std::string root_directory;
+  std::vector<std::string> search_paths;
+  const FileDatabase *database = nullptr;
+
+  std::vector<std::unique_ptr<ProjectFile>> file_list;
+  std::unordered_map<std::string, size_t> file_ids;
+  std::deque<size_t> queue;
+  size_t pending = 0;
+  std::mutex mutex;
+  std::condition_variable condition;
+
+  bool resolve(const std::string &name, IndexKind kind,
+               std::string &path) const;
+
+  size_t add_file(const std::string &path);
+
+  void parse_file(ProjectFile &file, TSParser *parser, Indexer &indexer);
+
+  void work();
+
+public:
+  // Uses one thread per core when thread_count is zero.
+  Project(const TSLanguage *language, unsigned thread_count = 0);
+
+  ~Project();
+
+  Project(const Project &) = delete;
+
+  Project &operator=(const Project &) = delete;
+
+  void add_search_path(const std::string &path);
+
+  // Resolves names that are not found in the project or the search paths
+  // without probing the file system, e.g. those from a texmf tree. The
+  // database has to outlive the call to load.
+  void set_file_database(const FileDatabase *database) {
+    this->database = database;
+  }
+
+  // Gives up on a file whose parse takes longer than this, so that a single
+  // pathological file cannot hold up a worker. Zero means no limit.
+  void set_parse_budget(uint64_t micros) { budget_micros = micros; }
+
+  // Parses root and every file it reaches. Returns false if root cannot be
+  // read. A project can only be loaded once.
+  bool load(const std::string &root);
+
+  // The files in the order they were found, the root first.
+  const std::vector<std::unique_ptr<ProjectFile>> &files() const {
+    return file_list;
+  }
+
+  // The references that close a cycle as (file, dependency) pairs.
+  std::vector<std::pair<size_t, size_t>> cycles() const;
+};
+
+} // namespace LaTeX
+
+#endif
@@ -6,6 +6,13 @@
 
 namespace LaTeX {
 
+std::atomic<bool> Scanner::default_merge_comments(false);
+std::atomic<bool> Scanner::default_opaque_regions(false);
+thread_local std::string Scanner::initial_state;
+thread_local ScanBudget Scanner::budget;
+thread_local bool Scanner::record_serialized_lengths = false;
+thread_local std::vector<uint64_t> Scanner::serialized_lengths;
+
 using std::any_of;
 using std::string;
 using std::u32string;
@@ -22,6 +29,27 @@ void Scanner::reset() {
   catcode_table.reset();
 }
 
+// The clock is only read every BUDGET_CHECK_INTERVAL calls, but once the
+// budget is exhausted every later call reports it.
+bool Scanner::over_budget() {
+  return budget.exhausted || (--budget_countdown == 0 && check_budget());
+}
+
+bool Scanner::check_budget() {
+  ScanBudget &current = budget;
+
+  budget_countdown = BUDGET_CHECK_INTERVAL;
+
+  if (!current.exhausted &&
+      ((current.cancellation_flag && *current.cancellation_flag) ||
+       (current.deadline != std::chrono::steady_clock::time_point::max() &&
+        std::chrono::steady_clock::now() >= current.deadline))) {
+    current.exhausted = true;
+  }
+
+  return current.exhausted;
+}
+
 unsigned Scanner::serialize(char *buffer) const {
   SerializationBuffer buf(buffer);
 
@@ -33,8 +61,14 @@ unsigned Scanner::serialize(char *buffer) const {
 void Scanner::deserialize(const char *buffer, unsigned length) {
   reset();
 
+  // Tree-sitter passes no state before the first external token.
   if (length == 0) {
-    return;
+    if (initial_state.empty()) {
+      return;
+    }
+
+    buffer = initial_state.data();
+    length = initial_state.length();
   }
 
   DeserializationBuffer buf(buffer, length);
@@ -44,46 +78,38 @@ void Scanner::deserialize(const char *buffer, unsigned length) {
 
 bool Scanner::enter_raw_mode(TSLexer *lexer) {
   raw = true;
-  advanced = false;
   return read_char(lexer);
 }
 
 bool Scanner::enter_translated_mode(TSLexer *lexer) {
   raw = false;
-  advanced = false;
   return read_char(lexer);
 }
 
+// The lexer is left positioned at the lookahead when advanced is set so that
+// the end of a token only needs to be marked once. Superscript escapes like
+// ^^M are the exception since the whole sequence has to be consumed to decode
+// it. In that case the end is marked before the sequence.
 bool Scanner::read_char(TSLexer *lexer) {
-  if (raw) {
-    if (advanced) {
-      lexer->advance(lexer, false);
-    } else {
-      advanced = true;
-    }
-
-    lookahead = lexer->lookahead;
-
-    if (!lexer->lookahead)
-      return false;
-
-    return true;
+  if (advanced) {
+    lexer->advance(lexer, false);
   }
 
+  advanced = true;
   lookahead = lexer->lookahead;
+  category = catcode_table[lookahead];
 
-  lexer->mark_end(lexer);
-
-  if (!lexer->lookahead)
+  if (!lookahead)
     return false;
 
-  advanced = true;
-  lexer->advance(lexer, false);
-
-  if (catcode_table[lookahead] != SUPERSCRIPT_CATEGORY) {
+  if (raw || category != SUPERSCRIPT_CATEGORY) {
     return true;
   }
 
+  lexer->mark_end(lexer);
+  lexer->advance(lexer, false);
+  advanced = false;
+
   int count = 1;
 
   while (count < 6 && static_cast<char32_t>(lexer->lookahead) == lookahead) {
@@ -122,12 +148,14 @@ bool Scanner::read_char(TSLexer *lexer) {
     return false;
   }
 
+  category = catcode_table[lookahead];
+
   return true;
 }
 
 bool Scanner::match_char(TSLexer *lexer, const CategoryFlags &flags,
                          const u32string &chars, bool exclude) {
-  if (flags[catcode_table[lookahead]] &&
+  if (flags[category] &&
       exclude == (chars.find(lookahead) == u32string::npos)) {
     read_char(lexer);
     return true;
@@ -140,8 +168,9 @@ bool Scanner::match_chars(TSLexer *lexer, const CategoryFlags &flags,
                           const u32string &chars, bool exclude) {
   bool skipped = false;
 
-  while (flags[catcode_table[lookahead]] &&
-         exclude == (chars.find(lookahead) == u32string::npos)) {
+  while (flags[category] &&
+         exclude == (chars.find(lookahead) == u32string::npos) &&
+         !over_budget()) {
     skipped = true;
     if (!read_char(lexer))
       break;
@@ -150,6 +179,23 @@ bool Scanner::match_chars(TSLexer *lexer, const CategoryFlags &flags,
   return skipped;
 }
 
+void Scanner::skip_line(TSLexer *lexer) {
+  if (!lookahead || category == EOL_CATEGORY) {
+    return;
+  }
+
+  // Only the terminating EOL is of interest so the characters are not
+  // translated or matched against a category set.
+  while (lexer->lookahead &&
+         catcode_table[lexer->lookahead] != EOL_CATEGORY && !over_budget()) {
+    lexer->advance(lexer, false);
+  }
+
+  advanced = true;
+  lookahead = lexer->lookahead;
+  category = catcode_table[lookahead];
+}
+
 bool Scanner::match_string(TSLexer *lexer, const std::string &value) {
   for (char32_t ch : convert.from_bytes(value)) {
     if (lookahead != ch) {
@@ -162,7 +208,7 @@ bool Scanner::match_string(TSLexer *lexer, const std::string &value) {
 }
 
 string Scanner::read_string(TSLexer *lexer, Category catcode) {
-  if (catcode_table[lookahead] == catcode) {
+  if (category == catcode) {
     return read_string(lexer, 1 << catcode);
   }
 
@@ -177,8 +223,9 @@ string Scanner::read_string(TSLexer *lexer, const CategoryFlags &flags,
                             const u32string &chars, bool exclude) {
   string result;
 
-  while (flags[catcode_table[lookahead]] &&
-         exclude == (chars.find(lookahead) == u32string::npos)) {
+  while (flags[category] &&
+         exclude == (chars.find(lookahead) == u32string::npos) &&
+         !over_budget()) {
     result.append(convert.to_bytes(lookahead));
     if (!read_char(lexer))
       break;
@@ -211,7 +258,7 @@ bool Scanner::scan_verb_end_delim(TSLexer *lexer) {
     }
 
     // EOL is not allowed in inline verbatim
-    if (catcode_table[lookahead] == EOL_CATEGORY) {
+    if (category == EOL_CATEGORY) {
       return symbol(lexer, exit);
     }
   }
@@ -243,7 +290,7 @@ bool Scanner::scan_verbatim_text(TSLexer *lexer) {
       } else {
         read_char(lexer);
       }
-    } while (lookahead);
+    } while (lookahead && !over_budget());
 
     return true;
   }
@@ -251,49 +298,80 @@ bool Scanner::scan_verbatim_text(TSLexer *lexer) {
   return false;
 }
 
-bool Scanner::scan_comment(TSLexer *lexer) {
+SymbolType Scanner::read_comment_type(TSLexer *lexer) {
+  if (lookahead == ':') {
+    return comment_tag;
+  }
+
+  match_chars(lexer, SPACE_FLAG);
+
+  if (lookahead == 'a') {
+    if (read_char(lexer) && lookahead == 'r' && read_char(lexer) &&
+        lookahead == 'a' && read_char(lexer) && lookahead == 'r' &&
+        read_char(lexer) && lookahead == 'a' && read_char(lexer) &&
+        lookahead == ':') {
+      return comment_arara;
+    }
+  } else if (lookahead == '!' && read_char(lexer)) {
+    if (lookahead == 'T' && read_char(lexer) &&
+        (lookahead == 'e' || lookahead == 'E') && read_char(lexer) &&
+        lookahead == 'X' && read_char(lexer) && category == SPACE_CATEGORY) {
+      return comment_tex;
+    } else if (lookahead == 'B' && read_char(lexer) &&
+               (lookahead == 'i' || lookahead == 'I') && read_char(lexer) &&
+               (lookahead == 'b' || lookahead == 'B') && read_char(lexer) &&
+               category == SPACE_CATEGORY) {
+      return comment_bib;
+    }
+  }
+
+  return comment;
+}
+
+void Scanner::skip_comment(TSLexer *lexer) {
+  // Gobble the reset of the comment
+  skip_line(lexer);
+
+  // Eat any EOL
+  if (category == EOL_CATEGORY) {
+    read_char(lexer);
+  }
+}
+
+bool Scanner::scan_comment(TSLexer *lexer, const bool *valid_symbols) {
   lexer->result_symbol = comment;
 
   if (enter_raw_mode(lexer)) {
-    string comment_type;
+    lexer->result_symbol = read_comment_type(lexer);
+    skip_comment(lexer);
+  }
 
-    if (lookahead == ':') {
-      lexer->result_symbol = comment_tag;
-    } else {
-      match_chars(lexer, SPACE_FLAG);
-
-      if (lookahead == 'a') {
-        if (read_char(lexer) && lookahead == 'r' && read_char(lexer) &&
-            lookahead == 'a' && read_char(lexer) && lookahead == 'r' &&
-            read_char(lexer) && lookahead == 'a' && read_char(lexer) &&
-            lookahead == ':') {
-          lexer->result_symbol = comment_arara;
-        }
-      } else if (lookahead == '!' && read_char(lexer)) {
-        if (lookahead == 'T' && read_char(lexer) &&
-            (lookahead == 'e' || lookahead == 'E') && read_char(lexer) &&
-            lookahead == 'X' && read_char(lexer) &&
-            catcode_table[lookahead] == SPACE_CATEGORY) {
-          lexer->result_symbol = comment_tex;
-        } else if (lookahead == 'B' && read_char(lexer) &&
-                   (lookahead == 'i' || lookahead == 'I') && read_char(lexer) &&
-                   (lookahead == 'b' || lookahead == 'B') && read_char(lexer) &&
-                   catcode_table[lookahead] == SPACE_CATEGORY) {
-          lexer->result_symbol = comment_bib;
-        }
-      }
+  lexer->mark_end(lexer);
+
+  if (lexer->result_symbol != comment || !merge_comments ||
+      !valid_symbols[comment_lines]) {
+    return true;
+  }
+
+  // Merge the following plain comment lines. Leading spaces are skipped as
+  // TeX does at the start of a line.
+  while (!over_budget()) {
+    match_chars(lexer, SPACE_FLAG);
+
+    if (category != COMMENT_CATEGORY) {
+      break;
     }
 
-    // Gobble the reset of the comment
-    match_chars(lexer, ~EOL_FLAG);
+    read_char(lexer);
 
-    // Eat any EOL
-    if (catcode_table[lookahead] == EOL_CATEGORY) {
-      read_char(lexer);
+    if (read_comment_type(lexer) != comment) {
+      break;
     }
-  }
 
-  lexer->mark_end(lexer);
+    skip_comment(lexer);
+    lexer->mark_end(lexer);
+    lexer->result_symbol = comment_lines;
+  }
 
   return true;
 }
@@ -301,44 +379,37 @@ bool Scanner::scan_comment(TSLexer *lexer) {
 bool Scanner::scan_cs(TSLexer *lexer, const bool *valid_symbols) {
   read_char(lexer);
 
-  if (catcode_table[lookahead] != LETTER_CATEGORY) {
+  if (category != LETTER_CATEGORY) {
     if (valid_symbols[cs_make_verb_delim]) {
       catcode_table.assign(lookahead, VERB_DELIM_EXT_CATEGORY, true);
 
-      lexer->result_symbol = cs_make_verb_delim;
-      lexer->mark_end(lexer);
-
-      return true;
+      return symbol(lexer, cs_make_verb_delim, true);
     }
 
     if (valid_symbols[cs_delete_verb_delim]) {
       catcode_table.erase(lookahead, true);
 
-      lexer->result_symbol = cs_delete_verb_delim;
-      lexer->mark_end(lexer);
-
-      return true;
+      return symbol(lexer, cs_delete_verb_delim, true);
     }
   }
 
   cs_name = read_string(lexer, LETTER_CATEGORY);
 
   auto it = control_sequences.find(cs_name);
-  lexer->result_symbol =
-      (it != control_sequences.end() && valid_symbols[it->second.symbol])
-          ? it->second.symbol
-          : cs;
 
-  return true;
+  return symbol(lexer,
+                (it != control_sequences.end() && valid_symbols[it->second.symbol])
+                    ? it->second.symbol
+                    : cs);
 }
 
 inline bool Scanner::symbol(TSLexer *lexer, SymbolType symbol, bool advance) {
-  if (advance) {
-    if (raw) {
-      lexer->advance(lexer, false);
-    }
-    lexer->mark_end(lexer);
-  } else if (raw) {
+  if (advance && advanced) {
+    lexer->advance(lexer, false);
+    advanced = false;
+  }
+
+  if (advance || advanced) {
     lexer->mark_end(lexer);
   }
 
@@ -351,32 +422,32 @@ bool Scanner::scan_space(TSLexer *lexer, const bool *valid_symbols) {
   int eol = 0;
 
   do {
-    if (catcode_table[lookahead] == EOL_CATEGORY)
+    if (category == EOL_CATEGORY)
       eol++;
-  } while (read_char(lexer) && (catcode_table[lookahead] == SPACE_CATEGORY ||
-                                catcode_table[lookahead] == EOL_CATEGORY));
+  } while (read_char(lexer) &&
+           (category == SPACE_CATEGORY || category == EOL_CATEGORY) &&
+           !over_budget());
 
   if (eol > 1 && !valid_symbols[par_eol]) {
     return scan_text(lexer, valid_symbols);
   }
 
-  lexer->result_symbol = (eol > 1) ? par_eol : _space;
-
-  return true;
+  return symbol(lexer, (eol > 1) ? par_eol : _space);
 }
 
-bool Scanner::scan_env_name(TSLexer *lexer) {
+bool Scanner::scan_env_name(TSLexer *lexer, const bool *valid_symbols) {
   e_name = read_string(lexer, LETTER_FLAG | OTHER_FLAG);
 
   auto it = environments.find(e_name);
+  SymbolType type = (it == environments.end()) ? env_name : it->second.symbol;
 
-  if (it == environments.end()) {
-    lexer->result_symbol = env_name;
-  } else {
-    lexer->result_symbol = it->second.symbol;
+  // A reduced grammar profile may lack the symbol of the environment, which
+  // is then scanned as a generic one. The full profile has every symbol.
+  if (!LATEX_PACKAGES && !valid_symbols[type]) {
+    type = env_name;
   }
 
-  return true;
+  return symbol(lexer, type);
 }
 
 bool Scanner::scan_name(TSLexer *lexer) {
@@ -385,40 +456,253 @@ bool Scanner::scan_name(TSLexer *lexer) {
   auto it = names.find(u_name);
 
   if (it == names.end()) {
-    lexer->result_symbol = name;
-  } else {
-    lexer->result_symbol = it->second.symbol;
-    catcode_table.assign(it->second.intervals, it->second.global);
+    return symbol(lexer, name);
   }
 
-  return true;
+  catcode_table.apply(it->second.regime, it->second.global);
+
+  return symbol(lexer, it->second.symbol);
 }
 
 bool Scanner::scan_math_delim(TSLexer *lexer, const bool *valid_symbols) {
   read_char(lexer);
 
   if (valid_symbols[math_shift_end]) {
-    lexer->result_symbol = math_shift_end;
-  } else if (catcode_table[lookahead] == MATH_SHIFT_CATEGORY) {
-    lexer->mark_end(lexer);
-    lexer->result_symbol = valid_symbols[display_math_shift_end]
-                               ? display_math_shift_end
-                               : display_math_shift;
-  } else {
-    lexer->result_symbol = math_shift;
+    return symbol(lexer, math_shift_end);
   }
 
-  return true;
+  if (category == MATH_SHIFT_CATEGORY) {
+    return symbol(lexer,
+                  valid_symbols[display_math_shift_end] ? display_math_shift_end
+                                                        : display_math_shift,
+                  true);
+  }
+
+  return symbol(lexer, math_shift);
+}
+
+void Scanner::skip_verb(TSLexer *lexer) {
+  char32_t delim = lookahead;
+
+  while (read_char(lexer) && lookahead != delim &&
+         category != EOL_CATEGORY && !over_budget()) {
+  }
+
+  if (lookahead == delim) {
+    read_char(lexer);
+  }
+}
+
+// Skips the argument of \MakeShortVerb, \DefineShortVerb or \DeleteShortVerb
+// in an opaque region and makes or deletes the short verb delimiter it names.
+void Scanner::skip_short_verb_command(TSLexer *lexer, bool define) {
+  if (lookahead == '*') {
+    read_char(lexer);
+  }
+
+  match_chars(lexer, SPACE_FLAG);
+
+  bool braced = category == BEGIN_CATEGORY;
+
+  if (braced) {
+    read_char(lexer);
+  }
+
+  if (category == ESCAPE_CATEGORY && read_char(lexer)) {
+    if (define) {
+      catcode_table.assign(lookahead, VERB_DELIM_EXT_CATEGORY, true);
+    } else {
+      catcode_table.erase(lookahead, true);
+    }
+
+    read_char(lexer);
+  }
+
+  if (braced) {
+    match_chars(lexer, SPACE_FLAG);
+
+    if (category == END_CATEGORY) {
+      read_char(lexer);
+    }
+  }
+}
+
+// Skips the rest of \global\catcode`\c=n in an opaque region and assigns the
+// category.
+void Scanner::skip_catcode_assignment(TSLexer *lexer) {
+  if (lookahead != '`' || !read_char(lexer)) {
+    return;
+  }
+
+  if (category == ESCAPE_CATEGORY && !read_char(lexer)) {
+    return;
+  }
+
+  char32_t ch = lookahead;
+  int code = -1;
+
+  read_char(lexer);
+  match_chars(lexer, SPACE_FLAG);
+
+  if (lookahead == '=') {
+    read_char(lexer);
+    match_chars(lexer, SPACE_FLAG);
+  }
+
+  while (lookahead >= '0' && lookahead <= '9' && code < CATEGORY_COUNT) {
+    code = std::max(code, 0) * 10 + (lookahead - '0');
+    read_char(lexer);
+  }
+
+  if (code >= 0 && code <= INVALID_CATEGORY) {
+    catcode_table.assign(ch, static_cast<Category>(code), true);
+    category = catcode_table[lookahead];
+  }
+}
+
+// Consume the body of a math region or environment without tokenizing it.
+// Braces are balanced and comments and inline verbatim are skipped so that
+// their contents cannot end the body early. The token ends before the closing
+// math shift, \] or \) for math, before the \end matching the current
+// environment, before an unbalanced } or at the end of the input. Local
+// catcode changes in the body end with it and are not tracked, but the
+// global ones of \MakeShortVerb, \DeleteShortVerb and \global\catcode are
+// applied. An empty body is not a token, the math shift, \), \] or \end
+// that closes it is returned instead.
+bool Scanner::scan_opaque(TSLexer *lexer, SymbolType type,
+                          const bool *valid_symbols) {
+  int depth = 0, nesting = 0;
+  bool global = false;
+
+  enter_raw_mode(lexer);
+
+  if (type == opaque_math && category == MATH_SHIFT_CATEGORY &&
+      (valid_symbols[math_shift_end] ||
+       valid_symbols[display_math_shift_end])) {
+    return scan_math_delim(lexer, valid_symbols);
+  }
+
+  for (bool empty = true; lookahead && !over_budget(); empty = false) {
+    switch (category) {
+    case BEGIN_CATEGORY:
+      depth++;
+      break;
+    case END_CATEGORY:
+      if (depth == 0) {
+        return symbol(lexer, type);
+      }
+      depth--;
+      break;
+    case MATH_SHIFT_CATEGORY:
+      if (depth == 0 && type == opaque_math) {
+        return symbol(lexer, type);
+      }
+      break;
+    case COMMENT_CATEGORY:
+      skip_line(lexer);
+      continue;
+    case VERB_DELIM_EXT_CATEGORY:
+      skip_verb(lexer);
+      continue;
+    case ESCAPE_CATEGORY: {
+      // The end is marked before the escape in case this is the terminator.
+      lexer->mark_end(lexer);
+      lexer->result_symbol = type;
+
+      if (!read_char(lexer) || category != LETTER_CATEGORY) {
+        SymbolType end =
+            (lookahead == ')') ? cs_inline_math_end : cs_display_math_end;
+
+        global = false;
+
+        if (depth == 0 && type == opaque_math &&
+            (lookahead == ']' || lookahead == ')')) {
+          return !(empty && valid_symbols[end]) || symbol(lexer, end, true);
+        }
+        break;
+      }
+
+      string name = read_string(lexer, LETTER_CATEGORY);
+      bool global_prefix = global;
+
+      global = name == "global";
+
+      if (name == "MakeShortVerb" || name == "DefineShortVerb" ||
+          name == "DeleteShortVerb") {
+        skip_short_verb_command(lexer, name != "DeleteShortVerb");
+      } else if (name == "catcode" && global_prefix) {
+        skip_catcode_assignment(lexer);
+      } else if (name == "verb") {
+        if (lookahead == '*') {
+          read_char(lexer);
+        }
+        skip_verb(lexer);
+      } else if (depth == 0 && type == opaque_env &&
+                 (name == "begin" || name == "end")) {
+        bool end_only = empty && name == "end" && valid_symbols[cs_end];
+
+        if (end_only) {
+          lexer->mark_end(lexer);
+        }
+
+        match_chars(lexer, SPACE_FLAG);
+
+        if (category != BEGIN_CATEGORY) {
+          continue;
+        }
+
+        bool begin = name == "begin";
+
+        read_char(lexer);
+        name = read_string(lexer, LETTER_FLAG | OTHER_FLAG);
+
+        if (category != END_CATEGORY) {
+          depth++;
+          continue;
+        }
+
+        if (name == e_name) {
+          if (begin) {
+            nesting++;
+          } else if (nesting == 0) {
+            if (end_only) {
+              lexer->result_symbol = cs_end;
+            }
+            return true;
+          } else {
+            nesting--;
+          }
+        }
+
+        read_char(lexer);
+      }
+      continue;
+    }
+    default:
+      break;
+    }
+
+    read_char(lexer);
+  }
+
+  return symbol(lexer, type);
 }
 
 bool Scanner::scan_ignored_line(TSLexer *lexer) {
-  match_chars(lexer, ~EOL_FLAG);
+  skip_line(lexer);
 
-  return symbol(lexer, ignored_line, catcode_table[lookahead] == EOL_CATEGORY);
+  return symbol(lexer, ignored_line, category == EOL_CATEGORY);
 }
 
 bool Scanner::scan_ignored_rest(TSLexer *lexer) {
-  match_chars(lexer);
+  // Nothing is tokenized after \endinput so skip straight to the end.
+  while (lexer->lookahead && !over_budget()) {
+    lexer->advance(lexer, false);
+  }
+
+  advanced = true;
+  lookahead = lexer->lookahead;
+  category = catcode_table[lookahead];
 
   return symbol(lexer, ignored_rest);
 }
@@ -502,18 +786,22 @@ bool Scanner::scan_text(TSLexer *lexer, const bool *valid_symbols) {
     break;
   }
 
-  string keyword = read_string(lexer, LETTER_CATEGORY);
+  // Keywords are only matched when the parser can accept one. Otherwise just
+  // consume the word.
+  if (valid_keyword(valid_symbols)) {
+    SymbolType keyword = read_keyword(lexer);
 
-  auto it = keywords.find(keyword);
-
-  if (it != keywords.end() && valid_symbols[it->second]) {
-    lexer->result_symbol = it->second;
-    return true;
+    if (keyword != text && valid_symbols[keyword]) {
+      return symbol(lexer, keyword);
+    }
+  } else if (category == LETTER_CATEGORY) {
+    match_chars(lexer, LETTER_FLAG);
+  } else {
+    read_char(lexer);
   }
 
   if (valid_symbols[text_single]) {
-    lexer->result_symbol = text_single;
-    return true;
+    return symbol(lexer, text_single);
   }
 
   u32string excluded;
@@ -529,15 +817,13 @@ bool Scanner::scan_text(TSLexer *lexer, const bool *valid_symbols) {
   match_chars(lexer, LETTER_FLAG | OTHER_FLAG | SPACE_FLAG | EOL_FLAG,
               excluded);
 
-  lexer->result_symbol = text;
-
-  return true;
+  return symbol(lexer, text);
 }
 
 bool Scanner::scan_cmd_apply(TSLexer *lexer) {
   auto it = control_sequences.find(cs_name);
   if (it != control_sequences.end()) {
-    catcode_table.assign(it->second.intervals);
+    catcode_table.apply(it->second.regime);
   }
 
   return symbol(lexer, _cmd_apply);
@@ -547,7 +833,7 @@ bool Scanner::scan_env_begin(TSLexer *lexer) {
   catcode_table.push();
   auto it = environments.find(e_name);
   if (it != environments.end()) {
-    catcode_table.assign(it->second.intervals);
+    catcode_table.apply(it->second.regime);
   }
 
   return symbol(lexer, _env_begin);
@@ -572,6 +858,8 @@ bool Scanner::scan_scope_end(TSLexer *lexer) {
 }
 
 bool Scanner::scan(TSLexer *lexer, const bool *valid_symbols) {
+  advanced = false;
+
   if (valid_symbols[_cmd_apply]) {
     return scan_cmd_apply(lexer);
   }
@@ -601,6 +889,9 @@ bool Scanner::scan(TSLexer *lexer, const bool *valid_symbols) {
     if (scan_verb_end_delim(lexer)) {
       return true;
     }
+
+    // Only the lookahead was read, so the body starts at the same character.
+    advanced = false;
   }
 
   // Scan an inline verbatim body.
@@ -612,6 +903,21 @@ bool Scanner::scan(TSLexer *lexer, const bool *valid_symbols) {
     return scan_verbatim_text(lexer);
   }
 
+  if (opaque_regions) {
+    if (valid_symbols[opaque_math]) {
+      return scan_opaque(lexer, opaque_math, valid_symbols);
+    }
+
+    // The optional argument of tikzpicture or dmath may still follow, so a [
+    // and the spaces before it are left to the parser.
+    if (valid_symbols[opaque_env] &&
+        !(valid_symbols[lbrack] &&
+          (lexer->lookahead == '[' ||
+           catcode_table[lexer->lookahead] == SPACE_CATEGORY))) {
+      return scan_opaque(lexer, opaque_env, valid_symbols);
+    }
+  }
+
   if (!enter_translated_mode(lexer)) {
     lexer->result_symbol = char_ref_invalid;
     lexer->mark_end(lexer);
@@ -635,9 +941,7 @@ bool Scanner::scan(TSLexer *lexer, const bool *valid_symbols) {
     return scan_ignored_rest(lexer);
   }
 
-  Category code = catcode_table[lookahead];
-
-  switch (code) {
+  switch (category) {
   case ESCAPE_CATEGORY:
     if (valid_symbol_in_range(valid_symbols, cs_addvspace, cs)) {
       return scan_cs(lexer, valid_symbols);
@@ -711,7 +1015,7 @@ bool Scanner::scan(TSLexer *lexer, const bool *valid_symbols) {
     break;
   case COMMENT_CATEGORY:
     if (valid_symbols[comment]) {
-      return scan_comment(lexer);
+      return scan_comment(lexer, valid_symbols);
     }
     break;
   case VERB_DELIM_EXT_CATEGORY:
@@ -724,7 +1028,7 @@ bool Scanner::scan(TSLexer *lexer, const bool *valid_symbols) {
       break;
     }
     if (valid_symbol_in_range(valid_symbols, env_name_alignat, env_name)) {
-      return scan_env_name(lexer);
+      return scan_env_name(lexer, valid_symbols);
     }
     if (valid_symbols[name]) {
       return scan_name(lexer);
@@ -759,7 +1063,21 @@ bool tree_sitter_latex_external_scanner_scan(void *payload, TSLexer *lexer,
 unsigned tree_sitter_latex_external_scanner_serialize(void *payload,
                                                       char *buffer) {
   auto *scanner = static_cast<LaTeX::Scanner *>(payload);
-  return scanner->serialize(buffer);
+  unsigned length = scanner->serialize(buffer);
+
+  // Tree-sitter serializes the state after each external token it scans and
+  // keeps it in the token, whether or not the token ends up in the tree.
+  if (LaTeX::Scanner::record_serialized_lengths) {
+    std::vector<uint64_t> &lengths = LaTeX::Scanner::serialized_lengths;
+
+    if (length >= lengths.size()) {
+      lengths.resize(length + 1);
+    }
+
+    lengths[length]++;
+  }
+
+  return length;
 }
 
 void tree_sitter_latex_external_scanner_deserialize(void *payload,
@@ -773,4 +1091,48 @@ void tree_sitter_latex_external_scanner_destroy(void *payload) {
   auto *scanner = static_cast<LaTeX::Scanner *>(payload);
   delete scanner;
 }
+
+void tree_sitter_latex_set_merge_comments(bool enabled) {
+  LaTeX::Scanner::default_merge_comments = enabled;
+}
+
+void tree_sitter_latex_set_opaque_regions(bool enabled) {
+  LaTeX::Scanner::default_opaque_regions = enabled;
+}
+
+void tree_sitter_latex_set_initial_state(const char *buffer,
+                                         unsigned length) {
+  if (length == 0) {
+    LaTeX::Scanner::initial_state.clear();
+  } else {
+    LaTeX::Scanner::initial_state.assign(buffer, length);
+  }
+}
+
+void tree_sitter_latex_set_scan_budget(uint64_t timeout_micros,
+                                       const size_t *cancellation_flag) {
+  LaTeX::ScanBudget &budget = LaTeX::Scanner::budget;
+
+  budget.deadline =
+      (timeout_micros == 0)
+          ? std::chrono::steady_clock::time_point::max()
+          : std::chrono::steady_clock::now() +
+                std::chrono::microseconds(timeout_micros);
+  budget.cancellation_flag = cancellation_flag;
+  budget.exhausted = false;
+}
+
+bool tree_sitter_latex_scan_budget_exhausted() {
+  return LaTeX::Scanner::budget.exhausted;
+}
+
+void tree_sitter_latex_record_serialized_lengths(bool enabled) {
+  LaTeX::Scanner::record_serialized_lengths = enabled;
+  LaTeX::Scanner::serialized_lengths.clear();
+}
+
+const uint64_t *tree_sitter_latex_serialized_lengths(unsigned *count) {
+  *count = LaTeX::Scanner::serialized_lengths.size();
+  return LaTeX::Scanner::serialized_lengths.data();
+}
 }
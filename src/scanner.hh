@@ -1,6 +1,8 @@
 #ifndef SCANNER_HH_
 #define SCANNER_HH_
 
+#include <atomic>
+#include <chrono>
 #include <codecvt>
 #include <locale>
 #include <string>
@@ -11,6 +13,21 @@
 
 #include "catcode.hh"
 
+// The grammar profile selects which package modules are compiled into the
+// control sequence, environment and name tables. It has to match the
+// TREE_SITTER_LATEX_PROFILE the parser was generated with. The full profile
+// is the default.
+#if defined(LATEX_PROFILE_CORE)
+#define LATEX_AMS 0
+#define LATEX_PACKAGES 0
+#elif defined(LATEX_PROFILE_CORE_AMS)
+#define LATEX_AMS 1
+#define LATEX_PACKAGES 0
+#else
+#define LATEX_AMS 1
+#define LATEX_PACKAGES 1
+#endif
+
 namespace LaTeX {
 
 enum SymbolType {
@@ -27,6 +44,7 @@ enum SymbolType {
   comma,
   comment_arara,
   comment_bib,
+  comment_lines,
   comment_tag,
   comment_tex,
   comment,
@@ -214,6 +232,8 @@ enum SymbolType {
   minus,
   name,
   octal,
+  opaque_env,
+  opaque_math,
   par_eol,
   parameter_ref,
   plus_sym,
@@ -241,7 +261,7 @@ enum SymbolType {
 struct CatCodeCommand {
   SymbolType symbol;
   bool global;
-  std::vector<CatCodeInterval> intervals;
+  RegimeId regime = NO_REGIME;
 
   CatCodeCommand(SymbolType t, bool g = false) {
     symbol = t;
@@ -249,7 +269,7 @@ struct CatCodeCommand {
   }
 
   CatCodeCommand(SymbolType t, bool g, std::initializer_list<CatCodeInterval> i)
-      : intervals(i) {
+      : regime(CatCodeTable::compile(i)) {
     symbol = t;
     global = g;
   }
@@ -257,16 +277,28 @@ struct CatCodeCommand {
 
 struct Environment {
   SymbolType symbol;
-  std::vector<CatCodeInterval> intervals;
+  RegimeId regime = NO_REGIME;
 
   Environment(SymbolType s) { symbol = s; }
 
   Environment(SymbolType s, std::initializer_list<CatCodeInterval> i)
-      : intervals(i) {
+      : regime(CatCodeTable::compile(i)) {
     symbol = s;
   }
 };
 
+// Limits the time the scans on a thread may take, so that a parse with a
+// timeout or cancellation flag also stops inside long tokens like the body of
+// a verbatim environment. A scan that runs out of budget ends its token
+// early, so the tree of such a parse has to be discarded.
+struct ScanBudget {
+  std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::time_point::max();
+  const size_t *cancellation_flag = nullptr;
+  // Set once a scan has run out of budget.
+  bool exhausted = false;
+};
+
 #ifdef _MSC_VER
 #define CHAR32_T __int32
 #else
@@ -283,42 +315,26 @@ class Scanner {
   std::wstring_convert<std::codecvt_utf8<CHAR32_T>, CHAR32_T> convert;
   std::string cs_name, e_name, u_name;
   char32_t start_delim = 0, lookahead = 0;
+  Category category = OTHER_CATEGORY;
   bool raw = false, advanced = false;
-  CatCodeTable catcode_table = {
-      {' ', ' ', SPACE_CATEGORY},
-      {'_', '_', SUBSCRIPT_CATEGORY},
-      {'{', '{', BEGIN_CATEGORY},
-      {'}', '}', END_CATEGORY},
-      {'\\', '\\', ESCAPE_CATEGORY},
-      // NUL is technically ignored, but tree sitter seems to use it to indicate
-      // EOF.
-      // {'\0',   '\0',   IGNORED_CATEGORY},
-      // SOH is subscript in plain.tex but not in latex.ltx
-      // {'\1', '\1', SUBSCRIPT_CATEGORY},
-      // FF is active character for \par in latex.ltx
-      {'\f', '\f', ACTIVE_CHAR_CATEGORY},
-      {'\n', '\n', EOL_CATEGORY},
-      {'\t', '\t', SPACE_CATEGORY},
-      // VT superscript in plain.tex but not in latex.ltx
-      // {'\v', '\v', SUPERSCRIPT_CATEGORY},
-      {'\x7f', '\x7f', INVALID_CATEGORY},
-      {'&', '&', ALIGNMENT_TAB_CATEGORY},
-      {'#', '#', PARAMETER_CATEGORY},
-      {'%', '%', COMMENT_CATEGORY},
-      {'^', '^', SUPERSCRIPT_CATEGORY},
-      {'~', '~', ACTIVE_CHAR_CATEGORY},
-      {'$', '$', MATH_SHIFT_CATEGORY},
-      {'a', 'z', LETTER_CATEGORY},
-      {'A', 'Z', LETTER_CATEGORY},
-  };
+  bool merge_comments = default_merge_comments;
+  uint32_t budget_countdown = BUDGET_CHECK_INTERVAL;
+  bool opaque_regions = default_opaque_regions;
+  CatCodeTable catcode_table;
+
+  // The number of characters read in a long loop between budget checks.
+  static const uint32_t BUDGET_CHECK_INTERVAL = 4096;
 
   static std::unordered_map<std::string, CatCodeCommand> control_sequences;
   static std::unordered_map<std::string, CatCodeCommand> names;
   static std::unordered_map<std::string, Environment> environments;
-  static std::unordered_map<std::string, SymbolType> keywords;
 
   void reset();
 
+  inline bool over_budget();
+
+  bool check_budget();
+
   bool valid_symbol_in_range(const bool *valid_symbols, SymbolType first,
                              SymbolType last);
 
@@ -340,6 +356,8 @@ class Scanner {
   bool match_chars(TSLexer *lexer, const CategoryFlags &flags = ANY_FLAG,
                    const std::u32string &chars = U"", bool exclude = true);
 
+  void skip_line(TSLexer *lexer);
+
   bool match_string(TSLexer *lexer, const std::string &value);
 
   bool scan_verb_start_delim(TSLexer *lexer, const bool *valid_symbols,
@@ -351,7 +369,11 @@ class Scanner {
 
   bool scan_verbatim_text(TSLexer *lexer);
 
-  bool scan_comment(TSLexer *lexer);
+  SymbolType read_comment_type(TSLexer *lexer);
+
+  void skip_comment(TSLexer *lexer);
+
+  bool scan_comment(TSLexer *lexer, const bool *valid_symbols);
 
   bool scan_cs(TSLexer *lexer, const bool *valid_symbols);
 
@@ -359,12 +381,20 @@ class Scanner {
 
   bool scan_space(TSLexer *lexer, const bool *valid_symbols);
 
-  bool scan_env_name(TSLexer *lexer);
+  bool scan_env_name(TSLexer *lexer, const bool *valid_symbols);
 
   bool scan_name(TSLexer *lexer);
 
   bool scan_math_delim(TSLexer *lexer, const bool *valid_symbols);
 
+  void skip_verb(TSLexer *lexer);
+
+  void skip_short_verb_command(TSLexer *lexer, bool define);
+
+  void skip_catcode_assignment(TSLexer *lexer);
+
+  bool scan_opaque(TSLexer *lexer, SymbolType type, const bool *valid_symbols);
+
   inline bool scan_ignored_line(TSLexer *lexer);
 
   bool scan_ignored_rest(TSLexer *lexer);
@@ -379,6 +409,10 @@ class Scanner {
 
   bool scan_parameter_ref(TSLexer *lexer);
 
+  bool valid_keyword(const bool *valid_symbols);
+
+  SymbolType read_keyword(TSLexer *lexer);
+
   bool scan_text(TSLexer *lexer, const bool *valid_symbols);
 
   bool scan_cmd_apply(TSLexer *lexer);
@@ -392,6 +426,28 @@ class Scanner {
   bool scan_scope_end(TSLexer *lexer);
 
 public:
+  // When set, scanners created afterwards merge consecutive plain comment
+  // lines into a single comment_lines token.
+  static std::atomic<bool> default_merge_comments;
+
+  // When set, scanners created afterwards return the bodies of math regions,
+  // tikzpicture and tabular environments as a single opaque token.
+  static std::atomic<bool> default_opaque_regions;
+
+  // The state a scanner starts from on this thread instead of the empty one,
+  // e.g. the state at the start of a chunk in a split parse.
+  static thread_local std::string initial_state;
+
+  // The budget of the scans on this thread, which is unlimited by default.
+  static thread_local ScanBudget budget;
+
+  // The number of serialize calls on this thread that returned a state of
+  // each length, while recording is on. Tokens that the parser discards,
+  // e.g. while it recovers from an error, are serialized too, so these are
+  // more than the states the tree keeps.
+  static thread_local bool record_serialized_lengths;
+  static thread_local std::vector<uint64_t> serialized_lengths;
+
   Scanner() {}
 
   unsigned serialize(char *buffer) const;
@@ -399,6 +455,9 @@ public:
   void deserialize(const char *buffer, unsigned length);
 
   bool scan(TSLexer *lexer, const bool *valid_symbols);
+
+  friend class Prescanner;
+  friend class Tokenizer;
 };
 
 } // namespace LaTeX
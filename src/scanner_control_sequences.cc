@@ -35,10 +35,12 @@ unordered_map<string, CatCodeCommand> Scanner::control_sequences = {
     {"uccode", cs_code},
     {"vphantom", cs_phantom_smash},
     {"xdef", cs_def},
+#if LATEX_AMS
     // latex amsmath amsmath-sty
     {"eqref", cs_ref},
     {"tag", cs_tag},
     {"text", cs_text},
+#endif
     // latex base doc-sty
     {"DoNotIndex", cs_DoNotIndex},
     // latex base latex-ltx
@@ -203,6 +205,7 @@ unordered_map<string, CatCodeCommand> Scanner::control_sequences = {
     // latex base shortvrb-sty
     {"DeleteShortVerb", cs_DeleteShortVerb},
     {"MakeShortVerb", cs_MakeShortVerb},
+#if LATEX_PACKAGES
     // latex biblatex biblatex-sty
     {"autocite", cs_cite},
     {"Autocite", cs_cite},
@@ -605,6 +608,7 @@ unordered_map<string, CatCodeCommand> Scanner::control_sequences = {
        {'}', '}', END_CATEGORY},
        {'~', '~', ACTIVE_CHAR_CATEGORY},
        {'\x7f', '\x7f', INVALID_CATEGORY}}}},
+#endif
 };
 
 }; // namespace LaTeX
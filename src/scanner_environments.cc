@@ -6,6 +6,7 @@ using std::string;
 using std::unordered_map;
 
 unordered_map<string, Environment> Scanner::environments = {
+#if LATEX_AMS
     // latex amscls amsthm-sty
     {"proof", env_name_theorem},
     // latex amsmath amsmath-sty
@@ -22,6 +23,7 @@ unordered_map<string, Environment> Scanner::environments = {
     {"multiline*", env_name_display_math},
     {"split", env_name_display_math},
     {"split*", env_name_display_math},
+#endif
     // latex base alltt-sty
     {"alltt",
      {env_name,
@@ -61,6 +63,7 @@ unordered_map<string, Environment> Scanner::environments = {
     {"tabular*", env_name_tabularstar},
     {"thebibliography", env_name_thebibliography},
     {"theorem", env_name_theorem},
+#if LATEX_PACKAGES
     // latex breqn breqn-sty
     {"darray", env_name_dmath},
     {"darray*", env_name_dmath},
@@ -117,10 +120,12 @@ unordered_map<string, Environment> Scanner::environments = {
     {"longtable", env_name_tabular},
     // latex tools tabularx-sty
     {"tabularx", env_name_tabularstar},
+#endif
     // latex tools verbatim-sty
     {"comment", env_name_comment},
     {"verbatim", env_name_verbatim},
     {"verbatim*", env_name_verbatim},
+#if LATEX_PACKAGES
     // lualatex luacode luacode-sty
     {"luacode",
      {env_name_luacode,
@@ -136,6 +141,7 @@ unordered_map<string, Environment> Scanner::environments = {
        {'~', '~', OTHER_CATEGORY},
        {'\x7f', '\x7f', INVALID_CATEGORY}}}},
     {"luacode*", env_name_luacodestar},
+#endif
 };
 
 }; // namespace LaTeX
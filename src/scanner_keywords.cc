@@ -2,18 +2,86 @@
 
 namespace LaTeX {
 
-using std::string;
-using std::unordered_map;
-
-unordered_map<string, SymbolType> Scanner::keywords = {
-    {",", comma},     {"(", lparen},      {")", rparen},   {"[", lbrack},
-    {"]", rbrack},    {"*", star},        {"`", backtick}, {"+", plus_sym},
-    {"=", equals},    {"bp", unit},       {"cc", unit},    {"cm", unit},
-    {"dd", unit},     {"em", unit},       {"ex", unit},    {"fi", unit},
-    {"fil", unit},    {"fill", unit},     {"filll", unit}, {"in", unit},
-    {"minus", minus}, {"mm", unit},       {"mu", unit},    {"nc", unit},
-    {"nd", unit},     {"pc", unit},       {"plus", plus},  {"pt", unit},
+namespace {
+
+struct Keyword {
+  const char *name;
+  SymbolType symbol;
+};
+
+// Sorted so that keywords sharing a prefix are adjacent and each keyword
+// precedes its extensions. This lets read_keyword walk the table like a trie
+// by narrowing the range of candidates one character at a time.
+constexpr Keyword keywords[] = {
+    {"(", lparen},    {")", rparen},   {"*", star},      {"+", plus_sym},
+    {",", comma},     {"=", equals},   {"[", lbrack},    {"]", rbrack},
+    {"`", backtick},  {"bp", unit},    {"cc", unit},     {"cm", unit},
+    {"dd", unit},     {"em", unit},    {"ex", unit},     {"fi", unit},
+    {"fil", unit},    {"fill", unit},  {"filll", unit},  {"in", unit},
+    {"minus", minus}, {"mm", unit},    {"mu", unit},     {"nc", unit},
+    {"nd", unit},     {"pc", unit},    {"plus", plus},   {"pt", unit},
     {"sp", unit},     {"spread", spread}, {"to", to},
 };
 
+constexpr size_t keyword_count = sizeof(keywords) / sizeof(Keyword);
+
+constexpr SymbolType keyword_symbols[] = {
+    backtick, comma, equals, lbrack, lparen, minus,  plus,
+    plus_sym, rbrack, rparen, spread, star,  to,     unit,
+};
+
+constexpr bool less(const char *a, const char *b) {
+  return (*a == *b) ? (*a != '\0' && less(a + 1, b + 1)) : (*a < *b);
+}
+
+constexpr bool sorted(size_t i = 1) {
+  return i >= keyword_count ||
+         (less(keywords[i - 1].name, keywords[i].name) && sorted(i + 1));
+}
+
+static_assert(sorted(), "keywords must be in ascending order");
+
+} // namespace
+
+bool Scanner::valid_keyword(const bool *valid_symbols) {
+  for (SymbolType symbol : keyword_symbols) {
+    if (valid_symbols[symbol]) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+SymbolType Scanner::read_keyword(TSLexer *lexer) {
+  size_t first = 0, last = keyword_count, depth = 0;
+  bool letters = category == LETTER_CATEGORY;
+
+  // Consume a run of letters or a single other character just as
+  // read_string(lexer, LETTER_CATEGORY) does.
+  do {
+    size_t end = last;
+
+    while (first < end &&
+           static_cast<unsigned char>(keywords[first].name[depth]) <
+               lookahead) {
+      first++;
+    }
+
+    last = first;
+
+    while (last < end &&
+           static_cast<unsigned char>(keywords[last].name[depth]) ==
+               lookahead) {
+      last++;
+    }
+
+    depth++;
+  } while (read_char(lexer) && letters && category == LETTER_CATEGORY);
+
+  return (first < last && keywords[first].name[depth] == '\0')
+             ? keywords[first].symbol
+             : text;
+}
+
 }; // namespace LaTeX
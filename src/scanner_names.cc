@@ -10,6 +10,7 @@ unordered_map<string, CatCodeCommand> Scanner::names = {
     {"ltxdoc", {name, true, {{'|', '|', VERB_DELIM_EXT_CATEGORY}}}},
     // latex base ltxguide-cls
     {"ltxguide", {name, true, {{'|', '|', VERB_DELIM_EXT_CATEGORY}}}},
+#if LATEX_PACKAGES
     // latex dashundergaps l3doc-TUB-cls
     {
         "l3doc-TUB",
@@ -30,6 +31,7 @@ unordered_map<string, CatCodeCommand> Scanner::names = {
     {"nlctdoc", {name, true, {{'|', '|', VERB_DELIM_EXT_CATEGORY}}}},
     // platex base plnews-cls
     {"plnews", {name, true, {{'|', '|', VERB_DELIM_EXT_CATEGORY}}}},
+#endif
 };
 
 }; // namespace LaTeX
@@ -0,0 +1,17 @@
+#ifndef SHA256_HH_
+#define SHA256_HH_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace LaTeX {
+
+const size_t SHA256_SIZE = 32;
+
+// The SHA-256 digest of a buffer, which the caches key sources by so that
+// two different sources never share an entry in practice.
+void sha256(const char *data, size_t length, uint8_t digest[SHA256_SIZE]);
+
+} // namespace LaTeX
+
+#endif
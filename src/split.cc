@@ -0,0 +1,693 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#include "bits.hh"
+#include "catcode_bitmap.hh"
+#include "scanner.hh"
+#include "serialization.hh"
+#include "split.hh"
+
+extern "C" void tree_sitter_latex_set_initial_state(const char *buffer,
+                                                    unsigned length);
+
+namespace LaTeX {
+
+namespace {
+
+const CatCodeClassifier &default_classifier() {
+  static const CatCodeClassifier classifier;
+  return classifier;
+}
+
+// The categories that the main loop of the prescan stops at.
+bool is_stop(Category category) {
+  return category == ESCAPE_CATEGORY || category == BEGIN_CATEGORY ||
+         category == END_CATEGORY || category == COMMENT_CATEGORY ||
+         category == EOL_CATEGORY || category == VERB_DELIM_EXT_CATEGORY;
+}
+
+// Environments whose bodies the scanner returns as a single token.
+bool is_verbatim(SymbolType symbol) {
+  return symbol == env_name_comment || symbol == env_name_lstlisting ||
+         symbol == env_name_minted || symbol == env_name_verbatim;
+}
+
+} // namespace
+
+// Reads a document with the catcode table of a scanner, applying the same
+// changes as the scanner does when the parser asks for them. Only bytes
+// below 0x80 are looked up in the table, the others are taken as letters.
+//
+// Runs of bytes that need no attention are skipped with the bitmaps of the
+// default regime as long as the table stops at the same characters.
+class Prescanner {
+  // Whether the table stops at the same characters as the default regime
+  // for each catcode level. Global changes make the saved levels unknown.
+  enum Fast : uint8_t { SLOW, FAST, UNKNOWN };
+
+  const char *source;
+  uint32_t length, position = 0;
+  TSPoint point = {0, 0}, cs_point = {0, 0};
+  Scanner scanner;
+  const CatCodeTable defaults;
+  std::vector<std::string> environments;
+  uint32_t depth = 0;
+  bool safe = true, in_document = false;
+  std::vector<Fast> fast_levels;
+  bool fast = true;
+  const CatCodeClassifier &classifier = default_classifier();
+  uint32_t block_start = UINT32_MAX;
+  CatCodeBitmaps block;
+
+  Category category(uint32_t offset) const {
+    unsigned char ch = source[offset];
+    return ch < 0x80 ? scanner.catcode_table[ch] : LETTER_CATEGORY;
+  }
+
+  bool follows_defaults() const {
+    for (char32_t ch = 0; ch < 0x80; ch++) {
+      if (is_stop(scanner.catcode_table[ch]) != is_stop(defaults[ch]) ||
+          (scanner.catcode_table[ch] == EOL_CATEGORY) !=
+              (defaults[ch] == EOL_CATEGORY)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  void push_level() {
+    scanner.catcode_table.push();
+    fast_levels.push_back(fast ? FAST : SLOW);
+  }
+
+  void pop_level() {
+    scanner.catcode_table.pop();
+
+    Fast level = fast_levels.back();
+
+    fast_levels.pop_back();
+    fast = level == UNKNOWN ? follows_defaults() : level == FAST;
+  }
+
+  void changed(bool global) {
+    fast = follows_defaults();
+
+    if (global) {
+      std::fill(fast_levels.begin(), fast_levels.end(), UNKNOWN);
+    }
+  }
+
+  // Advances to the first byte before limit whose bit is set in the bitmap
+  // picked by select, or to limit. The bitmaps are those of the default
+  // regime, so the EOL bitmap has exactly the newlines that start a row.
+  template <typename Select> void skip_to(uint32_t limit, Select select) {
+    while (position < limit) {
+      uint32_t start = position & ~static_cast<uint32_t>(BITMAP_BLOCK_SIZE - 1);
+
+      if (start != block_start) {
+        classifier.classify(
+            source + start,
+            std::min<uint32_t>(BITMAP_BLOCK_SIZE, length - start), block);
+        block_start = start;
+      }
+
+      uint32_t offset = position - start;
+      uint32_t end = std::min<uint32_t>(BITMAP_BLOCK_SIZE, limit - start);
+      uint64_t range = ~static_cast<uint64_t>(0) << offset;
+
+      if (end < BITMAP_BLOCK_SIZE) {
+        range &= (static_cast<uint64_t>(1) << end) - 1;
+      }
+
+      uint64_t found = select(block) & range;
+
+      if (found) {
+        end = lowest_bit(found);
+        range &= (static_cast<uint64_t>(1) << end) - 1;
+      }
+
+      uint64_t lines = block.eol & range;
+
+      if (lines) {
+        point.row += count_bits(lines);
+        point.column = end - highest_bit(lines) - 1;
+      } else {
+        point.column += end - offset;
+      }
+
+      position = start + end;
+
+      if (found) {
+        return;
+      }
+    }
+  }
+
+  void advance() {
+    if (source[position] == '\n') {
+      point.row++;
+      point.column = 0;
+    } else {
+      point.column++;
+    }
+
+    position++;
+  }
+
+  void skip_spaces() {
+    while (position < length && (category(position) == SPACE_CATEGORY ||
+                                 category(position) == EOL_CATEGORY)) {
+      advance();
+    }
+  }
+
+  void skip_line() {
+    if (fast) {
+      skip_to(length,
+              [](const CatCodeBitmaps &bitmaps) { return bitmaps.eol; });
+      return;
+    }
+
+    while (position < length && category(position) != EOL_CATEGORY) {
+      advance();
+    }
+  }
+
+  // Skips an inline verbatim up to the delimiter. Like the scanner the
+  // verbatim ends at the end of the line.
+  void skip_verb(char delimiter) {
+    while (position < length && source[position] != delimiter &&
+           category(position) != EOL_CATEGORY) {
+      advance();
+    }
+
+    if (position < length && source[position] == delimiter) {
+      advance();
+    }
+  }
+
+  // Reads the name of a control sequence starting at the escape character.
+  std::string read_cs() {
+    uint32_t start = ++position;
+
+    point.column++;
+
+    if (position >= length) {
+      return std::string();
+    }
+
+    if (category(position) != LETTER_CATEGORY) {
+      advance();
+    } else {
+      while (position < length && category(position) == LETTER_CATEGORY) {
+        advance();
+      }
+    }
+
+    return std::string(source + start, position - start);
+  }
+
+  // Reads the contents of a group without nested groups, e.g. the name of
+  // an environment.
+  bool read_group(std::string &text) {
+    skip_spaces();
+
+    if (position >= length || category(position) != BEGIN_CATEGORY) {
+      return false;
+    }
+
+    advance();
+
+    uint32_t start = position;
+
+    while (position < length && category(position) != END_CATEGORY) {
+      if (category(position) == BEGIN_CATEGORY) {
+        return false;
+      }
+
+      advance();
+    }
+
+    if (position >= length) {
+      return false;
+    }
+
+    text.assign(source + start, position - start);
+    advance();
+
+    return true;
+  }
+
+  void skip_verbatim_environment(const std::string &name) {
+    std::string end = "\\end{" + name + "}";
+    const char *found =
+        std::search(source + position, source + length, end.begin(), end.end());
+
+    skip_to(std::min<uint32_t>(found - source + end.size(), length),
+            [](const CatCodeBitmaps &) { return static_cast<uint64_t>(0); });
+  }
+
+  void begin_environment(uint32_t start) {
+    std::string name;
+
+    if (!read_group(name)) {
+      safe = false;
+      return;
+    }
+
+    if (name == "document") {
+      if (!environments.empty() || depth > 0 || in_document) {
+        safe = false;
+        return;
+      }
+
+      // The document environment is left out of the catcode levels so that
+      // the state at a boundary is the one before \begin{document}, which
+      // each chunk repeats.
+      plan.document_begin = {cs_point, point, start, position};
+      in_document = true;
+      return;
+    }
+
+    auto it = Scanner::environments.find(name);
+
+    if (it != Scanner::environments.end() && is_verbatim(it->second.symbol)) {
+      skip_verbatim_environment(name);
+      return;
+    }
+
+    environments.push_back(name);
+    push_level();
+
+    if (it != Scanner::environments.end() &&
+        it->second.regime != NO_REGIME) {
+      scanner.catcode_table.apply(it->second.regime);
+      changed(false);
+    }
+  }
+
+  // Returns false at the end of the document.
+  bool end_environment(uint32_t start) {
+    std::string name;
+
+    if (!read_group(name)) {
+      safe = false;
+      return true;
+    }
+
+    if (name == "document" && environments.empty() && depth == 0) {
+      plan.document_end = {cs_point, point, start, position};
+      return false;
+    }
+
+    if (environments.empty() || environments.back() != name) {
+      safe = false;
+      return true;
+    }
+
+    environments.pop_back();
+    pop_level();
+
+    return true;
+  }
+
+  // Applies the catcode changes of the names in \usepackage or
+  // \documentclass, e.g. of ltxdoc.
+  void use_names() {
+    std::string names;
+
+    skip_spaces();
+
+    if (position < length && source[position] == '[') {
+      while (position < length && source[position] != ']') {
+        advance();
+      }
+
+      if (position < length) {
+        advance();
+      }
+    }
+
+    if (!read_group(names)) {
+      return;
+    }
+
+    size_t start = 0;
+
+    while (start <= names.size()) {
+      size_t end = std::min(names.find(',', start), names.size());
+      size_t first = names.find_first_not_of(" \t\r\n", start);
+      size_t last = names.find_last_not_of(" \t\r\n", end - 1);
+
+      if (first < end && last != std::string::npos && last >= first) {
+        auto it = Scanner::names.find(names.substr(first, last - first + 1));
+
+        if (it != Scanner::names.end()) {
+          scanner.catcode_table.apply(it->second.regime, it->second.global);
+          changed(it->second.global);
+        }
+      }
+
+      start = end + 1;
+    }
+  }
+
+  void short_verb(bool make) {
+    skip_spaces();
+
+    if (position < length && source[position] == '*') {
+      advance();
+    }
+
+    bool group = position < length && category(position) == BEGIN_CATEGORY;
+
+    if (group) {
+      advance();
+    }
+
+    if (position + 1 >= length || category(position) != ESCAPE_CATEGORY ||
+        static_cast<unsigned char>(source[position + 1]) >= 0x80) {
+      safe = false;
+      return;
+    }
+
+    advance();
+
+    char32_t ch = source[position];
+
+    advance();
+
+    if (make) {
+      scanner.catcode_table.assign(ch, VERB_DELIM_EXT_CATEGORY, true);
+    } else {
+      scanner.catcode_table.erase(ch, true);
+    }
+
+    changed(true);
+
+    if (group && position < length && category(position) == END_CATEGORY) {
+      advance();
+    }
+  }
+
+  void add_boundary(uint32_t start) {
+    SplitBoundary boundary;
+    char buffer[TREE_SITTER_SERIALIZATION_BUFFER_SIZE];
+
+    boundary.byte = start;
+    boundary.point = cs_point;
+    boundary.state.assign(buffer, scanner.serialize(buffer));
+    plan.boundaries.push_back(boundary);
+  }
+
+  // Returns false at the end of the document.
+  bool control_sequence() {
+    uint32_t start = position;
+    TSPoint start_point = point;
+    std::string name = read_cs();
+    auto it = Scanner::control_sequences.find(name);
+
+    cs_point = start_point;
+
+    if (it == Scanner::control_sequences.end()) {
+      return true;
+    }
+
+    switch (it->second.symbol) {
+    case cs_section:
+      if (safe && depth == 0 && environments.empty() &&
+          (in_document || plan.document_begin.end_byte == 0)) {
+        add_boundary(start);
+      }
+      return true;
+    case cs_begin:
+      begin_environment(start);
+      return true;
+    case cs_end:
+      return end_environment(start);
+    case cs_begingroup:
+      depth++;
+      push_level();
+      return true;
+    case cs_endgroup:
+      if (depth == 0) {
+        safe = false;
+      } else {
+        depth--;
+        pop_level();
+      }
+      return true;
+    case cs_verb:
+      if (position < length && source[position] == '*') {
+        advance();
+      }
+      if (position < length) {
+        char delimiter = source[position];
+        advance();
+        skip_verb(delimiter);
+      }
+      return true;
+    case cs_MakeShortVerb:
+    case cs_DeleteShortVerb:
+      short_verb(it->second.symbol == cs_MakeShortVerb);
+      return true;
+    case cs_use:
+    case cs_use_209:
+      use_names();
+      return true;
+    case cs_code:
+      // Arbitrary assignments are not followed.
+      safe = false;
+      return true;
+    default:
+      break;
+    }
+
+    // Changes inside a group may or may not be undone at its end depending
+    // on whether the parser treats the group as a scope.
+    if (it->second.regime != NO_REGIME) {
+      if (depth > 0) {
+        safe = false;
+      } else {
+        scanner.catcode_table.apply(it->second.regime);
+        changed(false);
+      }
+    }
+
+    return true;
+  }
+
+public:
+  SplitPlan plan;
+
+  Prescanner(const char *source, uint32_t length)
+      : source(source), length(length) {
+    plan.document_begin = plan.document_end = {{0, 0}, {0, 0}, 0, 0};
+  }
+
+  void run() {
+    while (position < length && safe) {
+      switch (category(position)) {
+      case ESCAPE_CATEGORY:
+        if (!control_sequence()) {
+          return;
+        }
+        break;
+      case BEGIN_CATEGORY:
+        depth++;
+        push_level();
+        advance();
+        break;
+      case END_CATEGORY:
+        if (depth == 0) {
+          safe = false;
+        } else {
+          depth--;
+          pop_level();
+        }
+        advance();
+        break;
+      case COMMENT_CATEGORY:
+        skip_line();
+        break;
+      case VERB_DELIM_EXT_CATEGORY: {
+        char delimiter = source[position];
+        advance();
+        skip_verb(delimiter);
+        break;
+      }
+      default:
+        if (fast) {
+          skip_to(length, [](const CatCodeBitmaps &bitmaps) {
+            return bitmaps.escape | bitmaps.begin | bitmaps.end |
+                   bitmaps.comment;
+          });
+        } else {
+          advance();
+        }
+        break;
+      }
+    }
+
+    // The end of the document is still needed after the last boundary. The
+    // last one is taken since it cannot be in a verbatim of the document.
+    while (position < length) {
+      if (source[position] == '\\' && position + 4 < length &&
+          std::strncmp(source + position, "\\end", 4) == 0) {
+        uint32_t start = position;
+        std::string name;
+
+        cs_point = point;
+        read_cs();
+
+        if (read_group(name) && name == "document") {
+          plan.document_end = {cs_point, point, start, position};
+        }
+      } else {
+        advance();
+        skip_to(length,
+                [](const CatCodeBitmaps &bitmaps) { return bitmaps.escape; });
+      }
+    }
+  }
+};
+
+SplitPlan prescan(const char *source, uint32_t length) {
+  Prescanner prescanner(source, length);
+
+  prescanner.run();
+
+  return prescanner.plan;
+}
+
+SplitDocument::~SplitDocument() {
+  for (SplitChunk &chunk : chunk_list) {
+    if (chunk.tree) {
+      ts_tree_delete(chunk.tree);
+    }
+  }
+}
+
+void SplitDocument::parse(const TSLanguage *language, const char *source,
+                          uint32_t length, unsigned thread_count,
+                          uint32_t chunk_size) {
+  SplitPlan plan = prescan(source, length);
+  std::vector<const SplitBoundary *> starts = {nullptr};
+  bool has_document = plan.document_begin.end_byte > 0;
+  bool has_end = plan.document_end.end_byte > 0;
+  TSPoint end_point = {0, 0};
+  uint32_t line_start = 0;
+
+  for (uint32_t start = 0; start < length; start += BITMAP_BLOCK_SIZE) {
+    CatCodeBitmaps bitmaps;
+
+    default_classifier().classify(
+        source + start, std::min<uint32_t>(BITMAP_BLOCK_SIZE, length - start),
+        bitmaps);
+
+    if (bitmaps.eol) {
+      end_point.row += count_bits(bitmaps.eol);
+      line_start = start + highest_bit(bitmaps.eol) + 1;
+    }
+  }
+
+  end_point.column = length - line_start;
+
+  // Chunks end where the next one starts, the last one at the end of the
+  // source so that nothing after \end{document} is lost.
+  for (const SplitBoundary &boundary : plan.boundaries) {
+    uint32_t start = starts.back() ? starts.back()->byte : 0;
+
+    if (boundary.byte - start >= chunk_size &&
+        length - boundary.byte >= chunk_size) {
+      starts.push_back(&boundary);
+    }
+  }
+
+  for (auto &chunk : chunk_list) {
+    if (chunk.tree) {
+      ts_tree_delete(chunk.tree);
+    }
+  }
+
+  chunk_list.assign(starts.size(), SplitChunk());
+
+  for (size_t i = 0; i < starts.size(); i++) {
+    SplitChunk &chunk = chunk_list[i];
+
+    chunk.start_byte = starts[i] ? starts[i]->byte : 0;
+    chunk.start_point = starts[i] ? starts[i]->point : TSPoint{0, 0};
+    chunk.end_byte = (i + 1 < starts.size()) ? starts[i + 1]->byte : length;
+    chunk.end_point =
+        (i + 1 < starts.size()) ? starts[i + 1]->point : end_point;
+  }
+
+  if (thread_count == 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  thread_count = std::min<size_t>(thread_count, chunk_list.size());
+
+  std::atomic<size_t> next(0);
+  auto work = [&]() {
+    TSParser *parser = ts_parser_new();
+
+    ts_parser_set_language(parser, language);
+
+    for (size_t i = next++; i < chunk_list.size(); i = next++) {
+      SplitChunk &chunk = chunk_list[i];
+      std::vector<TSRange> ranges;
+
+      if (chunk_list.size() > 1) {
+        if (i > 0 && has_document) {
+          ranges.push_back(plan.document_begin);
+        }
+
+        ranges.push_back(
+            {chunk.start_point, chunk.end_point, chunk.start_byte,
+             chunk.end_byte});
+
+        if (i + 1 < chunk_list.size() && has_end) {
+          ranges.push_back(plan.document_end);
+        }
+      }
+
+      ts_parser_set_included_ranges(parser, ranges.data(), ranges.size());
+
+      if (starts[i]) {
+        tree_sitter_latex_set_initial_state(starts[i]->state.data(),
+                                            starts[i]->state.size());
+      }
+
+      chunk.tree = ts_parser_parse_string(parser, nullptr, source, length);
+      tree_sitter_latex_set_initial_state(nullptr, 0);
+    }
+
+    ts_parser_delete(parser);
+  };
+
+  std::vector<std::thread> threads;
+
+  for (unsigned i = 1; i < thread_count; i++) {
+    threads.emplace_back(work);
+  }
+
+  work();
+
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+size_t SplitDocument::find(uint32_t byte) const {
+  auto it = std::upper_bound(
+      chunk_list.begin(), chunk_list.end(), byte,
+      [](uint32_t b, const SplitChunk &chunk) { return b < chunk.start_byte; });
+
+  return it == chunk_list.begin() ? 0 : it - chunk_list.begin() - 1;
+}
+
+} // namespace LaTeX
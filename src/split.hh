@@ -0,0 +1,76 @@
+#ifndef SPLIT_HH_
+#define SPLIT_HH_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tree_sitter/api.h"
+
+namespace LaTeX {
+
+// A point in a document where a chunk can start together with the scanner
+// state to start it from.
+struct SplitBoundary {
+  uint32_t byte;
+  TSPoint point;
+  std::string state;
+};
+
+// The result of the prescan of a document.
+struct SplitPlan {
+  // The sectioning commands outside of any group, verbatim, comment or
+  // environment other than document in the order they appear.
+  std::vector<SplitBoundary> boundaries;
+  // The \begin{document} and \end{document} commands, if there are any.
+  // Their start and end bytes are equal if there are not.
+  TSRange document_begin, document_end;
+};
+
+// Finds the points where a document can be split without parsing it. It
+// follows groups and environments and the catcode changes of the commands,
+// package names and environments that the scanner knows. Once it meets
+// something whose effect it cannot follow, e.g. \catcode or a catcode change
+// inside a group, the rest of the document has no boundaries.
+SplitPlan prescan(const char *source, uint32_t length);
+
+// A part of a document parsed on its own. The tree uses the offsets of the
+// whole document. It also contains \begin{document} and \end{document} so
+// that each chunk parses as a complete document.
+struct SplitChunk {
+  uint32_t start_byte, end_byte;
+  TSPoint start_point, end_point;
+  TSTree *tree = nullptr;
+};
+
+// Parses a large document in chunks that start at top level sectioning
+// commands on a number of threads. Each chunk is parsed as an included range
+// of the whole source with the scanner started from the state the prescan
+// found at its start. A document without safe boundaries is parsed as a
+// single chunk.
+class SplitDocument {
+  std::vector<SplitChunk> chunk_list;
+
+public:
+  SplitDocument() {}
+
+  ~SplitDocument();
+
+  SplitDocument(const SplitDocument &) = delete;
+
+  SplitDocument &operator=(const SplitDocument &) = delete;
+
+  // Parses source in chunks of at least chunk_size bytes using thread_count
+  // threads, one per core if it is zero.
+  void parse(const TSLanguage *language, const char *source, uint32_t length,
+             unsigned thread_count = 0, uint32_t chunk_size = 1 << 20);
+
+  const std::vector<SplitChunk> &chunks() const { return chunk_list; }
+
+  // The index of the chunk that contains byte.
+  size_t find(uint32_t byte) const;
+};
+
+} // namespace LaTeX
+
+#endif
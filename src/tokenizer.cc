@@ -0,0 +1,615 @@
+#include <algorithm>
+#include <cstring>
+
+#include "tokenizer.h"
+#include "tokenizer.hh"
+
+namespace LaTeX {
+
+namespace {
+
+const int SYMBOL_COUNT = verbatim_text + 1;
+
+bool is_environment_name(SymbolType symbol) {
+  return symbol >= env_name_alignat && symbol <= env_name;
+}
+
+// Environments whose body is a single verbatim token and that do not push a
+// catcode level.
+bool is_verbatim(SymbolType symbol) {
+  switch (symbol) {
+  case env_name_comment:
+  case env_name_filecontents:
+  case env_name_gnuplot:
+  case env_name_lstlisting:
+  case env_name_luacodestar:
+  case env_name_minted:
+  case env_name_verbatim:
+  case env_name_Verbatim:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Verbatim environments whose parameters extend to the end of the line.
+bool has_line_parameters(SymbolType symbol) {
+  return symbol == env_name_filecontents || symbol == env_name_gnuplot ||
+         symbol == env_name_lstlisting || symbol == env_name_minted ||
+         symbol == env_name_Verbatim;
+}
+
+// The symbols of commands that change catcodes once they are read.
+struct Applying {
+  bool symbols[SYMBOL_COUNT] = {};
+
+  Applying(const std::unordered_map<std::string, CatCodeCommand> &commands) {
+    for (auto &command : commands) {
+      if (command.second.regime != NO_REGIME) {
+        symbols[command.second.symbol] = true;
+      }
+    }
+  }
+};
+
+} // namespace
+
+void Tokenizer::Lexer::advance(TSLexer *lexer, bool) {
+  Lexer *self = reinterpret_cast<Lexer *>(lexer);
+
+  self->position = self->next;
+  self->decode();
+}
+
+void Tokenizer::Lexer::mark_end(TSLexer *lexer) {
+  Lexer *self = reinterpret_cast<Lexer *>(lexer);
+
+  self->marked = self->position;
+}
+
+// Invalid sequences are read as U+FFFD one byte at a time.
+void Tokenizer::Lexer::decode() {
+  if (position >= length) {
+    next = length;
+    lexer.lookahead = 0;
+    return;
+  }
+
+  const unsigned char *bytes =
+      reinterpret_cast<const unsigned char *>(source) + position;
+  uint32_t available = length - position;
+  char32_t ch = bytes[0];
+  uint32_t size = 1;
+
+  if (ch >= 0x80) {
+    if (ch >= 0xc2 && ch < 0xe0) {
+      size = 2;
+      ch &= 0x1f;
+    } else if (ch >= 0xe0 && ch < 0xf0) {
+      size = 3;
+      ch &= 0x0f;
+    } else if (ch >= 0xf0 && ch < 0xf5) {
+      size = 4;
+      ch &= 0x07;
+    } else {
+      size = 0;
+    }
+
+    for (uint32_t i = 1; i < size; i++) {
+      if (i >= available || (bytes[i] & 0xc0) != 0x80) {
+        size = 0;
+        break;
+      }
+
+      ch = (ch << 6) | (bytes[i] & 0x3f);
+    }
+
+    if (size == 0 || (size == 3 && ch < 0x800) ||
+        (size == 4 && (ch < 0x10000 || ch > 0x10ffff)) ||
+        (ch >= 0xd800 && ch < 0xe000)) {
+      ch = 0xfffd;
+      size = 1;
+    }
+  }
+
+  next = position + size;
+  lexer.lookahead = ch;
+}
+
+void Tokenizer::Lexer::reset(uint32_t offset) {
+  position = offset;
+  decode();
+}
+
+const bool *Tokenizer::valid_symbols(Step step) {
+  static const struct Table {
+    bool symbols[STEP_COUNT][SYMBOL_COUNT] = {};
+
+    void add_text(Step step) {
+      bool *valid = symbols[step];
+
+      std::fill(valid + cs_addvspace, valid + cs + 1, true);
+      valid[cs_make_verb_delim] = false;
+      valid[cs_delete_verb_delim] = false;
+
+      for (SymbolType symbol :
+           {_space, active_char, alignment_tab, comment, comment_arara,
+            comment_bib, comment_lines, comment_tag, comment_tex,
+            display_math_shift, ignored, l, math_shift, par_eol,
+            parameter_ref, r, short_verb_delim, subscript, superscript,
+            SymbolType::text}) {
+        valid[symbol] = true;
+      }
+    }
+
+    void add(Step step, std::initializer_list<SymbolType> list) {
+      for (SymbolType symbol : list) {
+        symbols[step][symbol] = true;
+      }
+    }
+
+    Table() {
+      for (Step step :
+           {TEXT_STEP, GROUP_BODY, BRACK_BODY, MINT_START, MINT_LANGUAGE}) {
+        add_text(step);
+      }
+
+      add(GROUP_OPEN, {l, _space});
+      add(GROUP_CLOSE, {r, _space});
+      add(BRACK_BODY, {rbrack});
+      std::fill(symbols[BEGIN_NAME] + env_name_alignat,
+                symbols[BEGIN_NAME] + env_name + 1, true);
+      std::fill(symbols[END_NAME] + env_name_alignat,
+                symbols[END_NAME] + env_name + 1, true);
+      add(LINE_END, {eol, lbrack, l, _space});
+      add(VERBATIM, {verbatim_text});
+      add(USE_OPTIONS, {lbrack, l, _space});
+      add(NAME, {name, r, _space});
+      add(NAME_SEPARATOR, {comma, r, _space});
+      add(VERB_START, {star, verb_delim});
+      add(LISTING_START, {lbrack, verb_delim_no_lbrack});
+      add(MINT_START, {lbrack});
+      add(VERB_BODY, {verb_body, verb_end_delim});
+      add(VERB_END, {verb_end_delim});
+      add(MAKE_SHORT_VERB, {star, l, cs_make_verb_delim, _space});
+      add(MAKE_SHORT_VERB_CS, {cs_make_verb_delim, _space});
+      add(DELETE_SHORT_VERB, {star, l, cs_delete_verb_delim, _space});
+      add(DELETE_SHORT_VERB_CS, {cs_delete_verb_delim, _space});
+    }
+  } table;
+
+  return table.symbols[step];
+}
+
+Tokenizer::Tokenizer(const char *source, uint32_t length) {
+  lexer.lexer = TSLexer();
+  lexer.lexer.advance = Lexer::advance;
+  lexer.lexer.mark_end = Lexer::mark_end;
+  lexer.source = source;
+  lexer.length = length;
+  lexer.reset(0);
+}
+
+// Scans like the parser does, i.e. the token ends where the scanner last
+// marked it or where it stopped if it never did, and the next one starts at
+// the end of the token.
+bool Tokenizer::scan(const bool *valid_symbols, Token &token) {
+  uint32_t start = lexer.position;
+
+  lexer.marked = UINT32_MAX;
+
+  if (!scanner.scan(&lexer.lexer, valid_symbols)) {
+    lexer.reset(start);
+    return false;
+  }
+
+  if (lexer.marked == UINT32_MAX) {
+    lexer.marked = lexer.position;
+  }
+
+  token.symbol = static_cast<SymbolType>(lexer.lexer.result_symbol);
+  token.start_byte = start;
+  token.end_byte = std::max(start, lexer.marked);
+  lexer.reset(token.end_byte);
+
+  return true;
+}
+
+void Tokenizer::zero_width(SymbolType symbol) {
+  bool valid[SYMBOL_COUNT] = {};
+  Token token;
+
+  valid[symbol] = true;
+  scan(valid, token);
+}
+
+void Tokenizer::open_scope() {
+  zero_width(_scope_begin);
+  depth++;
+}
+
+void Tokenizer::close_scope() {
+  if (depth > 0) {
+    zero_width(_scope_end);
+    depth--;
+  }
+}
+
+void Tokenizer::push(Step step, uint32_t value) {
+  expectations.push_back({step, value});
+}
+
+void Tokenizer::text(SymbolType symbol) {
+  static const Applying applying(Scanner::control_sequences);
+
+  switch (symbol) {
+  case l:
+  case cs_begingroup:
+    open_scope();
+    break;
+  case r:
+  case cs_endgroup:
+    close_scope();
+    break;
+  case cs_begin:
+    push(AFTER_BEGIN);
+    push(GROUP_CLOSE);
+    push(BEGIN_NAME);
+    push(GROUP_OPEN);
+    break;
+  case cs_end:
+    push(AFTER_END);
+    push(GROUP_CLOSE);
+    push(END_NAME);
+    push(GROUP_OPEN);
+    break;
+  case cs_use:
+  case cs_use_209:
+    push(USE_OPTIONS);
+    break;
+  case cs_verb:
+    push(VERB_START);
+    break;
+  case cs_lstinline:
+    push(LISTING_START);
+    break;
+  case cs_mint:
+  case cs_mintinline:
+    push(MINT_START);
+    break;
+  case short_verb_delim:
+    push(VERB_BODY);
+    break;
+  case cs_MakeShortVerb:
+    push(MAKE_SHORT_VERB);
+    break;
+  case cs_DeleteShortVerb:
+    push(DELETE_SHORT_VERB);
+    break;
+  default:
+    // The parser applies the catcodes after the parameters of a command.
+    // Those that change catcodes mostly have none, so they are applied
+    // right away.
+    if (applying.symbols[symbol]) {
+      zero_width(_cmd_apply);
+    }
+    break;
+  }
+}
+
+// Handles a token read for an expectation that has already been popped.
+// Anything unexpected is taken as text and ends the construct.
+void Tokenizer::expect(Expectation expectation, const Token &token) {
+  SymbolType symbol = token.symbol;
+
+  switch (expectation.step) {
+  case GROUP_OPEN:
+  case GROUP_CLOSE:
+  case USE_OPTIONS:
+  case NAME:
+  case NAME_SEPARATOR:
+  case MAKE_SHORT_VERB:
+  case MAKE_SHORT_VERB_CS:
+  case DELETE_SHORT_VERB:
+  case DELETE_SHORT_VERB_CS:
+    if (symbol == _space) {
+      expectations.push_back(expectation);
+      return;
+    }
+    break;
+  default:
+    break;
+  }
+
+  switch (expectation.step) {
+  case GROUP_BODY:
+    if (symbol != r || depth != expectation.value) {
+      expectations.push_back(expectation);
+    }
+    text(symbol);
+    return;
+  case BRACK_BODY:
+    if (symbol != rbrack) {
+      expectations.push_back(expectation);
+      text(symbol);
+    }
+    return;
+  case LINE_END:
+    if (symbol == eol ||
+        std::memchr(lexer.source + token.start_byte, '\n',
+                    token.end_byte - token.start_byte)) {
+      return;
+    }
+    expectations.push_back(expectation);
+    if (symbol == lbrack) {
+      push(BRACK_BODY);
+    } else if (symbol == l) {
+      open_scope();
+      push(GROUP_BODY, depth);
+    } else {
+      text(symbol);
+    }
+    return;
+  case GROUP_OPEN:
+    if (symbol == l) {
+      open_scope();
+      return;
+    }
+    break;
+  case GROUP_CLOSE:
+    if (symbol == r) {
+      close_scope();
+      return;
+    }
+    break;
+  case BEGIN_NAME:
+  case END_NAME:
+    // The name is handed to the step that runs after the group.
+    if (is_environment_name(symbol) && expectations.size() >= 2) {
+      expectations[expectations.size() - 2].value = symbol;
+      return;
+    }
+    break;
+  case VERBATIM:
+    return;
+  case USE_OPTIONS:
+    if (symbol == lbrack) {
+      push(NAME);
+      push(GROUP_OPEN);
+      push(BRACK_BODY);
+      return;
+    }
+    if (symbol == l) {
+      open_scope();
+      push(NAME);
+      return;
+    }
+    break;
+  case NAME:
+  case NAME_SEPARATOR:
+    if (symbol == r) {
+      close_scope();
+      return;
+    }
+    if (symbol == (expectation.step == NAME ? name : comma)) {
+      push(expectation.step == NAME ? NAME_SEPARATOR : NAME);
+      return;
+    }
+    break;
+  case VERB_START:
+    if (symbol == star) {
+      expectations.push_back(expectation);
+      return;
+    }
+    if (symbol == verb_delim) {
+      push(VERB_BODY);
+      return;
+    }
+    break;
+  case LISTING_START:
+    if (symbol == lbrack) {
+      push(VERB_START);
+      push(BRACK_BODY);
+      return;
+    }
+    if (symbol == verb_delim_no_lbrack) {
+      push(VERB_BODY);
+      return;
+    }
+    break;
+  case MINT_START:
+  case MINT_LANGUAGE:
+    if (symbol == lbrack && expectation.step == MINT_START) {
+      push(MINT_LANGUAGE);
+      push(BRACK_BODY);
+      return;
+    }
+    if (symbol == _space) {
+      expectations.push_back(expectation);
+      return;
+    }
+    push(VERB_START);
+    if (symbol == l) {
+      open_scope();
+      push(GROUP_BODY, depth);
+    }
+    return;
+  case VERB_BODY:
+    if (symbol == verb_body) {
+      push(VERB_END);
+      return;
+    }
+    if (symbol == verb_end_delim || symbol == exit) {
+      return;
+    }
+    break;
+  case VERB_END:
+    if (symbol == verb_end_delim || symbol == exit) {
+      return;
+    }
+    break;
+  case MAKE_SHORT_VERB:
+  case DELETE_SHORT_VERB:
+    if (symbol == star) {
+      expectations.push_back(expectation);
+      return;
+    }
+    if (symbol == l) {
+      open_scope();
+      push(GROUP_CLOSE);
+      push(expectation.step == MAKE_SHORT_VERB ? MAKE_SHORT_VERB_CS
+                                               : DELETE_SHORT_VERB_CS);
+      return;
+    }
+    if (symbol == cs_make_verb_delim || symbol == cs_delete_verb_delim) {
+      return;
+    }
+    break;
+  case MAKE_SHORT_VERB_CS:
+  case DELETE_SHORT_VERB_CS:
+    if (symbol == cs_make_verb_delim || symbol == cs_delete_verb_delim) {
+      return;
+    }
+    break;
+  default:
+    break;
+  }
+
+  expectations.clear();
+  text(symbol);
+}
+
+bool Tokenizer::next(Token &token) {
+  while (true) {
+    // Run the steps that read nothing.
+    while (!expectations.empty() &&
+           (expectations.back().step == AFTER_BEGIN ||
+            expectations.back().step == AFTER_END)) {
+      Expectation expectation = expectations.back();
+      SymbolType symbol = static_cast<SymbolType>(expectation.value);
+
+      expectations.pop_back();
+
+      // The name was not read.
+      if (!is_environment_name(symbol)) {
+        continue;
+      }
+
+      if (expectation.step == AFTER_BEGIN) {
+        if (!is_verbatim(symbol)) {
+          zero_width(_env_begin);
+          environment_depth++;
+        } else {
+          push(VERBATIM);
+
+          if (has_line_parameters(symbol)) {
+            push(LINE_END);
+          }
+        }
+      } else if (!is_verbatim(symbol) && environment_depth > 0) {
+        zero_width(_env_end);
+        environment_depth--;
+      }
+    }
+
+    if (lexer.position >= lexer.length) {
+      return false;
+    }
+
+    Step step = expectations.empty() ? TEXT_STEP : expectations.back().step;
+
+    if (!scan(valid_symbols(step), token)) {
+      // Read again as text, or skip a character the parser would report as
+      // an error.
+      if (expectations.empty()) {
+        lexer.reset(lexer.next);
+      } else {
+        expectations.clear();
+      }
+      continue;
+    }
+
+    bool empty = token.end_byte == token.start_byte;
+
+    if (expectations.empty()) {
+      text(token.symbol);
+    } else {
+      Expectation expectation = expectations.back();
+      expectations.pop_back();
+      expect(expectation, token);
+    }
+
+    if (!empty) {
+      return true;
+    }
+
+    // Only the end of an inline verbatim at the end of a line and an empty
+    // verbatim environment are expected to be empty. Anything else would be
+    // read again forever.
+    if (token.symbol != exit && token.symbol != verbatim_text) {
+      expectations.clear();
+      lexer.reset(lexer.next);
+    }
+  }
+}
+
+} // namespace LaTeX
+
+using LaTeX::Token;
+using LaTeX::Tokenizer;
+
+struct TSLaTeXTokenizer {
+  Tokenizer tokenizer;
+
+  TSLaTeXTokenizer(const char *source, uint32_t length)
+      : tokenizer(source, length) {}
+};
+
+extern "C" {
+
+TSLaTeXTokenizer *tree_sitter_latex_tokenizer_new(const char *source,
+                                                  uint32_t length) {
+  return new TSLaTeXTokenizer(source, length);
+}
+
+void tree_sitter_latex_tokenizer_delete(TSLaTeXTokenizer *self) {
+  delete self;
+}
+
+bool tree_sitter_latex_tokenizer_next(TSLaTeXTokenizer *self,
+                                      TSLaTeXToken *token) {
+  Token next;
+
+  if (!self->tokenizer.next(next)) {
+    return false;
+  }
+
+  token->symbol = next.symbol;
+  token->start_byte = next.start_byte;
+  token->end_byte = next.end_byte;
+
+  return true;
+}
+
+uint32_t tree_sitter_latex_tokenize(const char *source, uint32_t length,
+                                    TSLaTeXTokenCallback callback,
+                                    void *payload) {
+  Tokenizer tokenizer(source, length);
+  Token next;
+  TSLaTeXToken token;
+  uint32_t count = 0;
+
+  while (tokenizer.next(next)) {
+    token.symbol = next.symbol;
+    token.start_byte = next.start_byte;
+    token.end_byte = next.end_byte;
+    count++;
+
+    if (!callback(payload, &token)) {
+      break;
+    }
+  }
+
+  return count;
+}
+}
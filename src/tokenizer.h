@@ -0,0 +1,46 @@
+#ifndef TREE_SITTER_LATEX_TOKENIZER_H_
+#define TREE_SITTER_LATEX_TOKENIZER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Runs the external scanner of the LaTeX grammar over a UTF-8 buffer without
+// the parser, e.g. for word counts or to find labels and citations. The
+// symbol of a token is the index of the external token in grammar.js, which
+// is LaTeX::SymbolType in scanner.hh.
+typedef struct TSLaTeXTokenizer TSLaTeXTokenizer;
+
+typedef struct {
+  uint16_t symbol;
+  uint32_t start_byte;
+  uint32_t end_byte;
+} TSLaTeXToken;
+
+// Returns false to stop tokenizing.
+typedef bool (*TSLaTeXTokenCallback)(void *payload, const TSLaTeXToken *token);
+
+// The source has to outlive the tokenizer.
+TSLaTeXTokenizer *tree_sitter_latex_tokenizer_new(const char *source,
+                                                  uint32_t length);
+
+void tree_sitter_latex_tokenizer_delete(TSLaTeXTokenizer *self);
+
+// Reads the next token. Returns false at the end of the source.
+bool tree_sitter_latex_tokenizer_next(TSLaTeXTokenizer *self,
+                                      TSLaTeXToken *token);
+
+// Passes every token to callback until it returns false. Returns the number
+// of tokens passed.
+uint32_t tree_sitter_latex_tokenize(const char *source, uint32_t length,
+                                    TSLaTeXTokenCallback callback,
+                                    void *payload);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
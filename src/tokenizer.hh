@@ -0,0 +1,112 @@
+#ifndef TOKENIZER_HH_
+#define TOKENIZER_HH_
+
+#include <cstdint>
+#include <vector>
+
+#include "scanner.hh"
+
+namespace LaTeX {
+
+struct Token {
+  SymbolType symbol;
+  uint32_t start_byte, end_byte;
+};
+
+// Drives a scanner over a UTF-8 buffer in place of the parser. The tokens it
+// asks for are those of document text, except that it follows the commands
+// that change how the following text is scanned: groups, environments,
+// \verb and its relatives, short verbs, verbatim environments and the
+// catcode changes of commands and packages, e.g. \makeatletter or
+// \usepackage{ltxdoc}. Like the parser it asks the scanner for the zero
+// width tokens that push, pop and apply catcodes, but these are not
+// returned.
+//
+// The arguments of other commands are returned as text, and math is scanned
+// like text.
+class Tokenizer {
+  // What is expected next, in place of document text.
+  enum Step : uint8_t {
+    TEXT_STEP,
+    GROUP_OPEN,
+    GROUP_CLOSE,
+    // Text up to the end of the group the step was pushed in.
+    GROUP_BODY,
+    BRACK_BODY,
+    BEGIN_NAME,
+    END_NAME,
+    // Zero width steps that run once the name of an environment is read.
+    AFTER_BEGIN,
+    AFTER_END,
+    // Text up to the end of the line that starts a verbatim environment.
+    LINE_END,
+    VERBATIM,
+    USE_OPTIONS,
+    NAME,
+    NAME_SEPARATOR,
+    VERB_START,
+    LISTING_START,
+    MINT_START,
+    MINT_LANGUAGE,
+    VERB_BODY,
+    VERB_END,
+    MAKE_SHORT_VERB,
+    MAKE_SHORT_VERB_CS,
+    DELETE_SHORT_VERB,
+    DELETE_SHORT_VERB_CS,
+    STEP_COUNT
+  };
+
+  struct Expectation {
+    Step step;
+    // The group depth of GROUP_BODY or the environment of AFTER_BEGIN and
+    // AFTER_END.
+    uint32_t value;
+  };
+
+  struct Lexer {
+    TSLexer lexer;
+    const char *source;
+    uint32_t length, position, next, marked;
+
+    static void advance(TSLexer *lexer, bool);
+
+    static void mark_end(TSLexer *lexer);
+
+    void decode();
+
+    void reset(uint32_t offset);
+  };
+
+  Lexer lexer;
+  Scanner scanner;
+  std::vector<Expectation> expectations;
+  uint32_t depth = 0, environment_depth = 0;
+
+  static const bool *valid_symbols(Step step);
+
+  bool scan(const bool *valid_symbols, Token &token);
+
+  void zero_width(SymbolType symbol);
+
+  void open_scope();
+
+  void close_scope();
+
+  void push(Step step, uint32_t value = 0);
+
+  void text(SymbolType symbol);
+
+  void expect(Expectation expectation, const Token &token);
+
+public:
+  // The source has to outlive the tokenizer.
+  Tokenizer(const char *source, uint32_t length);
+
+  // Reads the next token. Returns false at the end of the source.
+  bool next(Token &token);
+};
+
+} // namespace LaTeX
+
+#endif
@@ -0,0 +1,131 @@
+// Checks that every catcode bitmap kernel the CPU supports classifies all 256
+// byte values like a byte by byte lookup in the catcode table, for buffers
+// of every length up to a few blocks so that each tail length is covered.
+//
+// Usage: catcode-bitmap-test
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "catcode_bitmap.hh"
+
+using namespace LaTeX;
+
+const Category CATEGORIES[6] = {ESCAPE_CATEGORY,  BEGIN_CATEGORY,
+                                END_CATEGORY,     COMMENT_CATEGORY,
+                                EOL_CATEGORY,     MATH_SHIFT_CATEGORY};
+
+const char *const KERNEL_NAMES[] = {"auto", "scalar", "sse2", "avx2"};
+
+uint64_t field(const CatCodeBitmaps &bitmaps, int i) {
+  const uint64_t fields[6] = {bitmaps.escape,  bitmaps.begin, bitmaps.end,
+                              bitmaps.comment, bitmaps.eol,
+                              bitmaps.math_shift};
+  return fields[i];
+}
+
+// The bitmaps of a buffer from the categories of each byte.
+std::vector<CatCodeBitmaps> expected(const CatCodeTable &table,
+                                     const std::string &data) {
+  std::vector<CatCodeBitmaps> bitmaps(
+      (data.length() + BITMAP_BLOCK_SIZE - 1) / BITMAP_BLOCK_SIZE,
+      CatCodeBitmaps());
+
+  for (size_t i = 0; i < data.length(); i++) {
+    unsigned char ch = data[i];
+    uint64_t bit = static_cast<uint64_t>(1) << (i % BITMAP_BLOCK_SIZE);
+    CatCodeBitmaps &block = bitmaps[i / BITMAP_BLOCK_SIZE];
+    uint64_t *fields[6] = {&block.escape,  &block.begin, &block.end,
+                           &block.comment, &block.eol,   &block.math_shift};
+
+    for (int j = 0; j < 6; j++) {
+      if (ch < 0x80 && table[ch] == CATEGORIES[j]) {
+        *fields[j] |= bit;
+      }
+    }
+  }
+
+  return bitmaps;
+}
+
+// Returns the number of mismatched blocks and reports the first one.
+size_t check(const char *name, const CatCodeTable &table,
+             const std::string &data) {
+  std::vector<CatCodeBitmaps> reference = expected(table, data);
+  size_t failures = 0;
+
+  for (CatCodeKernel id : {SCALAR_KERNEL, SSE2_KERNEL, AVX2_KERNEL}) {
+    if (!CatCodeClassifier::supported(id)) {
+      continue;
+    }
+
+    CatCodeClassifier classifier(table, id);
+    std::vector<CatCodeBitmaps> bitmaps;
+
+    classifier.classify(data.data(), data.length(), bitmaps);
+
+    if (bitmaps.size() != reference.size()) {
+      std::cerr << name << ", " << KERNEL_NAMES[id] << ", length "
+                << data.length() << ": " << bitmaps.size() << " blocks"
+                << std::endl;
+      failures++;
+      continue;
+    }
+
+    for (size_t block = 0; block < bitmaps.size(); block++) {
+      for (int i = 0; i < 6; i++) {
+        if (field(bitmaps[block], i) != field(reference[block], i)) {
+          if (failures == 0) {
+            std::cerr << name << ", " << KERNEL_NAMES[id] << ", length "
+                      << data.length() << ": block " << block
+                      << " differs in category " << int(CATEGORIES[i])
+                      << std::endl;
+          }
+          failures++;
+          break;
+        }
+      }
+    }
+  }
+
+  return failures;
+}
+
+int main() {
+  CatCodeTable standard, changed;
+  std::string bytes;
+  size_t failures = 0;
+
+  // NUL as an escape checks that the padding of a short block is masked
+  // off, and | as a comment character that the table is followed.
+  changed.assign(0, ESCAPE_CATEGORY);
+  changed.assign('|', COMMENT_CATEGORY);
+  changed.assign('%', OTHER_CATEGORY);
+
+  // Every byte value in two orders, read from several offsets below.
+  for (int i = 0; i < 256; i++) {
+    bytes.push_back(static_cast<char>(i));
+  }
+  for (int i = 255; i >= 0; i--) {
+    bytes.push_back(static_cast<char>((i * 7) & 0xff));
+  }
+
+  for (size_t length = 0; length <= 4 * BITMAP_BLOCK_SIZE + 1; length++) {
+    for (size_t offset : {size_t(0), size_t(1), size_t(131)}) {
+      std::string data = bytes.substr(offset, length);
+
+      failures += check("default table", standard, data);
+      failures += check("changed table", changed, data);
+    }
+  }
+
+  failures += check("all bytes", standard, bytes);
+  failures += check("all bytes", changed, bytes);
+
+  if (failures == 0) {
+    std::cerr << "All kernels match the catcode table" << std::endl;
+  }
+
+  return failures ? 1 : 0;
+}
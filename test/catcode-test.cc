@@ -0,0 +1,119 @@
+// Checks that catcode tables read back from a scanner state reject regime
+// ids that were never interned, and that catcode changes still apply and
+// survive serialization once the process wide regime registry is full.
+//
+// Usage: catcode-test
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "catcode.hh"
+
+using namespace LaTeX;
+
+int failures = 0;
+
+void check(bool condition, const char *description) {
+  if (!condition) {
+    std::cerr << "Failed: " << description << std::endl;
+    failures++;
+  }
+}
+
+// A state with a single level in the given regime.
+std::string state_with_regime(RegimeId id) {
+  char data[64];
+  SerializationBuffer buffer(data);
+
+  buffer << uint16_t(1) << id << uint16_t(1) << 0u << uint16_t(0);
+
+  return std::string(data, buffer.length);
+}
+
+CatCodeTable round_trip(const CatCodeTable &table) {
+  char data[1024];
+  SerializationBuffer out(data);
+  CatCodeTable copy;
+
+  out << table;
+
+  DeserializationBuffer in(data, out.length);
+  in >> copy;
+
+  return copy;
+}
+
+int main() {
+  CatCodeTable table;
+  std::string state;
+
+  table.assign('@', LETTER_CATEGORY);
+
+  state = state_with_regime(0x1234);
+  DeserializationBuffer unknown(state.data(), state.length());
+  unknown >> table;
+  check(table['@'] == OTHER_CATEGORY && table['\\'] == ESCAPE_CATEGORY,
+        "a regime that was never interned resets the table");
+
+  table.assign('@', LETTER_CATEGORY);
+
+  state = state_with_regime(PRIVATE_REGIME_BASE + 3);
+  DeserializationBuffer missing(state.data(), state.length());
+  missing >> table;
+  check(table['@'] == OTHER_CATEGORY,
+        "a private regime that is not in the state resets the table");
+
+  // Each delta differs in the categories of four characters, which fills
+  // the registry.
+  for (unsigned i = 0; i < 0x10000; i++) {
+    CatCodeTable::compile({{'0', '0', Category(i & 0xf)},
+                           {'1', '1', Category((i >> 4) & 0xf)},
+                           {'2', '2', Category((i >> 8) & 0xf)},
+                           {'3', '3', Category((i >> 12) & 0xf)}});
+  }
+
+  check(CatCodeTable::compile('4', ACTIVE_CHAR_CATEGORY) == NO_REGIME,
+        "the registry is full");
+
+  table.reset();
+  table.assign('@', LETTER_CATEGORY);
+  check(table['@'] == LETTER_CATEGORY, "an assignment to a full registry");
+
+  table.push();
+  table.assign('!', ACTIVE_CHAR_CATEGORY);
+  table.assign('|', VERB_DELIM_EXT_CATEGORY, true);
+  check(table['!'] == ACTIVE_CHAR_CATEGORY && table['@'] == LETTER_CATEGORY,
+        "a local assignment in a group");
+
+  CatCodeTable copy = round_trip(table);
+  check(copy['!'] == ACTIVE_CHAR_CATEGORY && copy['@'] == LETTER_CATEGORY &&
+            copy['|'] == VERB_DELIM_EXT_CATEGORY,
+        "private regimes are serialized");
+
+  copy.pop();
+  check(copy['!'] == OTHER_CATEGORY && copy['@'] == LETTER_CATEGORY &&
+            copy['|'] == VERB_DELIM_EXT_CATEGORY,
+        "the global scope of a deserialized table");
+
+  table.pop();
+  check(table['!'] == OTHER_CATEGORY && table['|'] == VERB_DELIM_EXT_CATEGORY,
+        "a global assignment survives the group");
+
+  // Private slots are reused once no level refers to them.
+  for (int i = 0; i < 10000; i++) {
+    table.push();
+    table.assign('!', (i % 2) ? ACTIVE_CHAR_CATEGORY : LETTER_CATEGORY);
+    table.pop();
+  }
+
+  table.erase('|', true);
+  check(table['|'] == OTHER_CATEGORY && table['@'] == LETTER_CATEGORY,
+        "a global erase in a full registry");
+
+  if (failures == 0) {
+    std::cerr << "All catcode checks pass" << std::endl;
+  }
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,150 @@
+// Checks that FileDatabase reads ls-R files like kpathsea, finds names in the
+// order their directories are listed and that a database built from a texmf
+// tree reads back from the ls-R file it writes. How Project falls back on the
+// database is checked by project-test.
+//
+// Usage: file-database-test <texmf directory>
+
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#include "file_database.hh"
+
+using namespace LaTeX;
+
+int failures = 0;
+
+void check(bool condition, const char *description) {
+  if (!condition) {
+    std::cerr << "Failed: " << description << std::endl;
+    failures++;
+  }
+}
+
+// The path a name is found at or an empty string.
+std::string find(const FileDatabase &database, const std::string &name) {
+  std::string path;
+  return database.find(name, path) ? path : "";
+}
+
+bool write_file(const std::string &path, const std::string &contents) {
+  std::ofstream stream(path, std::ios::binary);
+  stream << contents;
+  return static_cast<bool>(stream);
+}
+
+void check_load(const std::string &directory) {
+  FileDatabase database;
+
+  // CRLF line ends, a name before the first directory, an absolute
+  // directory, a trailing slash and a name listed in two directories.
+  check(write_file(directory + "/ls-R",
+                   "% ls-R -- filename database for kpathsea; do not change "
+                   "this line.\r\n"
+                   "top.tex\r\n"
+                   "\r\n"
+                   "./tex/latex/base:\r\n"
+                   "article.cls\r\n"
+                   "shared.sty\r\n"
+                   "\n"
+                   "./tex/xlatex/extra/:\n"
+                   "extra.sty\n"
+                   "\n"
+                   "/usr/share/texmf/tex/latex/shared:\n"
+                   "shared.sty\n"
+                   "% A comment.\n"
+                   "extra.sty\n"),
+        "writes the ls-R file");
+
+  check(!database.load(directory + "/none"), "a missing ls-R file");
+  check(database.load(directory + "/ls-R"), "loads the ls-R file");
+  check(database.size() == 4, "four names");
+
+  check(find(database, "top.tex") == directory + "/top.tex",
+        "a name before the first directory");
+  check(find(database, "article.cls") ==
+            directory + "/tex/latex/base/article.cls",
+        "a relative directory");
+  check(find(database, "extra.sty") ==
+            directory + "/tex/xlatex/extra/extra.sty",
+        "a directory with a trailing slash");
+  check(find(database, "shared.sty") ==
+            directory + "/tex/latex/base/shared.sty",
+        "the first directory listed wins");
+  check(find(database, "shared/shared.sty") ==
+            "/usr/share/texmf/tex/latex/shared/shared.sty",
+        "a name with a directory");
+  check(find(database, "xlatex/extra/extra.sty") ==
+                directory + "/tex/xlatex/extra/extra.sty" &&
+            find(database, "latex/extra/extra.sty").empty(),
+        "directories match whole components");
+  check(find(database, "tex/latex/base/article.cls") ==
+            directory + "/tex/latex/base/article.cls",
+        "several directories");
+  check(find(database, "other/article.cls").empty(),
+        "a name in another directory");
+  check(find(database, "none.sty").empty(), "a name that is not listed");
+}
+
+// The root is given as on the command line, which may be relative, and
+// texmf is its absolute path.
+void check_build(const std::string &root, const std::string &texmf,
+                 const std::string &directory) {
+  FileDatabase built, loaded;
+
+  built.build(root, 4);
+
+  check(find(built, "texmfpkg.sty") ==
+            texmf + "/tex/latex/texmfpkg/texmfpkg.sty",
+        "a file in a built database");
+  check(find(built, "latex/local/local.sty") ==
+            texmf + "/tex/latex/local/local.sty",
+        "a name with a directory in a built database");
+
+  check(built.write(directory + "/built-ls-R"), "writes the built database");
+  check(loaded.load(directory + "/built-ls-R"),
+        "loads the written database");
+  check(loaded.size() == built.size(),
+        "the written database has the same names");
+  check(find(loaded, "texmfpkg.sty") == find(built, "texmfpkg.sty") &&
+            find(loaded, "local.sty") == find(built, "local.sty"),
+        "the written database finds the same files");
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: file-database-test <texmf directory>" << std::endl;
+    return 1;
+  }
+
+  char texmf[PATH_MAX], temporary[] = "/tmp/file-database-test.XXXXXX";
+
+  if (!realpath(argv[1], texmf)) {
+    std::cerr << "Cannot find " << argv[1] << std::endl;
+    return 1;
+  }
+
+  if (!mkdtemp(temporary)) {
+    std::cerr << "Cannot create a temporary directory" << std::endl;
+    return 1;
+  }
+
+  std::string directory = temporary;
+
+  check_load(directory);
+  check_build(argv[1], texmf, directory);
+
+  unlink((directory + "/ls-R").c_str());
+  unlink((directory + "/built-ls-R").c_str());
+  rmdir(directory.c_str());
+
+  if (failures == 0) {
+    std::cerr << "All file database checks pass" << std::endl;
+  }
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,191 @@
+// Edits a generated document at random, reparses it incrementally and checks
+// after every edit that the IncrementalIndex holds the same records and
+// section paths as extracting the records of the whole tree again.
+//
+// Usage: incremental-index-test [-s <seed>] [-n <edits>]
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "index.hh"
+
+using namespace LaTeX;
+
+extern "C" const TSLanguage *tree_sitter_latex();
+
+// Pieces of the document and of the text that edits insert. Some of them
+// only make sense together, e.g. the braces, or break the commands they
+// are inserted into.
+const char *const SNIPPETS[] = {
+    "\\part{Zero}\n",
+    "\\chapter{One}\n",
+    "\\section{Intro}\n",
+    "\\section*{Star}\n",
+    "\\subsection{Detail}\n",
+    "\\paragraph{Para}\n",
+    "\\section{Title \\label{sec:title}}\n",
+    "\\label{sec:a}",
+    "\\ref{a, b}",
+    "\\cite[p.~1]{knuth,lamport}",
+    "\\usepackage{amsmath,graphicx}\n",
+    "\\input{body}\n",
+    "\\newcommand{\\foo}{\\label{def}}\n",
+    "\\verb|\\label{v}|",
+    "\\begin{verbatim}\n\\label{w}\n\\end{verbatim}\n",
+    "% \\label{c}\n",
+    "Some text. ",
+    "\n\n",
+    "{",
+    "}",
+    "\\",
+    "lab",
+    ",",
+};
+
+const size_t SNIPPET_COUNT = sizeof(SNIPPETS) / sizeof(SNIPPETS[0]);
+
+TSPoint point_at(const std::string &source, uint32_t offset) {
+  TSPoint point = {0, 0};
+
+  for (uint32_t i = 0; i < offset; i++) {
+    if (source[i] == '\n') {
+      point.row++;
+      point.column = 0;
+    } else {
+      point.column++;
+    }
+  }
+
+  return point;
+}
+
+bool same_record(const IndexEntry &a, const IndexEntry &b) {
+  return a.kind == b.kind && a.level == b.level &&
+         a.start_byte == b.start_byte && a.end_byte == b.end_byte &&
+         a.key_start == b.key_start && a.key_end == b.key_end;
+}
+
+// Returns an empty string if the index matches the records of the tree or
+// else a description of the first difference.
+std::string compare(const IncrementalIndex &index, Indexer &indexer,
+                    const TSTree *tree, const std::string &source) {
+  std::vector<IndexEntry> expected;
+
+  indexer.extract(expected, ts_tree_root_node(tree), source.data());
+
+  if (index.size() != expected.size()) {
+    return std::to_string(index.size()) + " records instead of " +
+           std::to_string(expected.size());
+  }
+
+  for (size_t i = 0; i < expected.size(); i++) {
+    if (!same_record(index[i], expected[i])) {
+      return "record " + std::to_string(i) + " at " +
+             std::to_string(index[i].start_byte) + " instead of " +
+             std::to_string(expected[i].start_byte);
+    }
+
+    std::vector<size_t> path;
+
+    for (int32_t section = expected[i].section; section != NO_SECTION;
+         section = expected[section].section) {
+      path.insert(path.begin(), section);
+    }
+
+    if (index.section_path(i) != path) {
+      return "section path of record " + std::to_string(i);
+    }
+  }
+
+  return "";
+}
+
+int main(int argc, char **argv) {
+  unsigned seed = 1, edits = 2000;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "-s") == 0) {
+      seed = std::atoi(argv[i + 1]);
+    } else if (std::strcmp(argv[i], "-n") == 0) {
+      edits = std::atoi(argv[i + 1]);
+    } else {
+      std::cerr << "Usage: incremental-index-test [-s <seed>] [-n <edits>]"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  std::mt19937 random(seed);
+  std::string source;
+
+  for (int i = 0; i < 400; i++) {
+    source += SNIPPETS[random() % SNIPPET_COUNT];
+  }
+
+  const TSLanguage *language = tree_sitter_latex();
+  TSParser *parser = ts_parser_new();
+  IncrementalIndex index(language);
+  Indexer indexer(language);
+
+  ts_parser_set_language(parser, language);
+
+  TSTree *tree =
+      ts_parser_parse_string(parser, nullptr, source.data(), source.size());
+
+  index.reset(tree, source.data(), source.size());
+
+  std::string difference = compare(index, indexer, tree, source);
+
+  if (!difference.empty()) {
+    std::cerr << "Seed " << seed << ", before the first edit: " << difference
+              << std::endl;
+  }
+
+  for (unsigned step = 0; step < edits && difference.empty(); step++) {
+    uint32_t start = random() % (source.size() + 1);
+    uint32_t removed =
+        std::min<uint32_t>(random() % 16, source.size() - start);
+    std::string text =
+        (random() % 5) ? SNIPPETS[random() % SNIPPET_COUNT] : "";
+    TSInputEdit edit;
+
+    edit.start_byte = start;
+    edit.old_end_byte = start + removed;
+    edit.new_end_byte = start + text.size();
+    edit.start_point = point_at(source, start);
+    edit.old_end_point = point_at(source, start + removed);
+    source.replace(start, removed, text);
+    edit.new_end_point = point_at(source, start + text.size());
+
+    ts_tree_edit(tree, &edit);
+
+    TSTree *new_tree =
+        ts_parser_parse_string(parser, tree, source.data(), source.size());
+
+    index.update(tree, new_tree, edit, source.data());
+    ts_tree_delete(tree);
+    tree = new_tree;
+
+    difference = compare(index, indexer, tree, source);
+
+    if (!difference.empty()) {
+      std::cerr << "Seed " << seed << ", edit " << step << " replacing "
+                << removed << " bytes at " << start << " with \"" << text
+                << "\": " << difference << std::endl;
+    }
+  }
+
+  ts_tree_delete(tree);
+  ts_parser_delete(parser);
+
+  if (difference.empty()) {
+    std::cerr << edits << " edits checked" << std::endl;
+  }
+
+  return difference.empty() ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+// Checks the records the Indexer extracts from the cases of corpus files.
+// The expected output of a case lists a record per line as its kind, the
+// level of a section, the key and the key of the section it is in, e.g.
+//
+//   section 1 "Introduction"
+//   label "sec:intro" in "Introduction"
+//
+// Usage: index-test <file ...>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "corpus.hh"
+#include "index.hh"
+
+using namespace LaTeX;
+
+extern "C" const TSLanguage *tree_sitter_latex();
+
+// Indexed by IndexKind.
+const char *const KIND_NAMES[KIND_COUNT] = {"label",
+                                            "ref",
+                                            "cite",
+                                            "section",
+                                            "bibitem",
+                                            "newcommand",
+                                            "newenvironment",
+                                            "newglossaryentry",
+                                            "input",
+                                            "package",
+                                            "class"};
+
+std::string key(const IndexEntry &entry, const std::string &source) {
+  return '"' +
+         source.substr(entry.key_start, entry.key_end - entry.key_start) +
+         '"';
+}
+
+std::string format(const std::vector<IndexEntry> &entries,
+                   const std::string &source) {
+  std::ostringstream output;
+
+  for (const IndexEntry &entry : entries) {
+    output << KIND_NAMES[entry.kind];
+
+    if (entry.kind == SECTION_KIND) {
+      output << ' ' << static_cast<int>(entry.level);
+    }
+
+    output << ' ' << key(entry, source);
+
+    if (entry.section != NO_SECTION) {
+      output << " in " << key(entries[entry.section], source);
+    }
+
+    output << '\n';
+  }
+
+  std::string result = output.str();
+
+  if (!result.empty()) {
+    result.pop_back();
+  }
+
+  return result;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: index-test <file ...>" << std::endl;
+    return 1;
+  }
+
+  const TSLanguage *language = tree_sitter_latex();
+  TSParser *parser = ts_parser_new();
+  Indexer indexer(language);
+  size_t count = 0, failures = 0;
+
+  ts_parser_set_language(parser, language);
+
+  for (int i = 1; i < argc; i++) {
+    std::vector<CorpusCase> cases;
+
+    if (!read_corpus_cases(argv[i], cases)) {
+      std::cerr << "Unable to read " << argv[i] << std::endl;
+      return 1;
+    }
+
+    for (const CorpusCase &test : cases) {
+      TSTree *tree = ts_parser_parse_string(
+          parser, nullptr, test.input.data(), test.input.length());
+      std::vector<IndexEntry> entries;
+
+      indexer.extract(entries, ts_tree_root_node(tree), test.input.data());
+      ts_tree_delete(tree);
+
+      std::string actual = format(entries, test.input);
+
+      count++;
+
+      if (actual != test.expected) {
+        failures++;
+        std::cerr << argv[i] << ": " << test.name << std::endl
+                  << "Expected:" << std::endl
+                  << test.expected << std::endl
+                  << "Actual:" << std::endl
+                  << actual << std::endl;
+      }
+    }
+  }
+
+  ts_parser_delete(parser);
+  std::cerr << count - failures << " of " << count << " cases passed"
+            << std::endl;
+
+  return failures ? 1 : 0;
+}
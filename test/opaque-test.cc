@@ -0,0 +1,177 @@
+// Checks the tokens the scanner returns in opaque region mode, i.e. that
+// empty math and empty environment bodies both yield their terminator, and
+// that global catcode changes in a skipped body still apply after it.
+//
+// Usage: opaque-test
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "scanner.hh"
+
+using namespace LaTeX;
+
+extern "C" void tree_sitter_latex_set_opaque_regions(bool enabled);
+
+const int SYMBOL_COUNT = verbatim_text + 1;
+
+struct BufferLexer {
+  TSLexer lexer;
+  const char32_t *begin, *position, *end, *marked;
+
+  static void advance(TSLexer *lexer, bool) {
+    BufferLexer *self = reinterpret_cast<BufferLexer *>(lexer);
+
+    if (self->position < self->end) {
+      self->position++;
+    }
+
+    lexer->lookahead = (self->position < self->end) ? *self->position : 0;
+  }
+
+  static void mark_end(TSLexer *lexer) {
+    BufferLexer *self = reinterpret_cast<BufferLexer *>(lexer);
+    self->marked = self->position;
+  }
+
+  BufferLexer(const std::u32string &text) {
+    lexer.advance = advance;
+    lexer.mark_end = mark_end;
+    begin = text.data();
+    end = begin + text.length();
+    reset(begin);
+  }
+
+  void reset(const char32_t *p) {
+    position = marked = p;
+    lexer.lookahead = (position < end) ? *position : 0;
+  }
+};
+
+struct Step {
+  std::vector<SymbolType> valid;
+  SymbolType symbol;
+  const char *text;
+};
+
+struct OpaqueCase {
+  const char *name, *source;
+  std::vector<Step> steps;
+};
+
+const std::vector<SymbolType> ENV_NAME = {env_name};
+const std::vector<SymbolType> ENV_BODY = {opaque_env, cs_end};
+const std::vector<SymbolType> MATH_BODY = {
+    opaque_math, math_shift_end, cs_inline_math_end, cs_display_math_end};
+const std::vector<SymbolType> TEXT = {short_verb_delim, active_char, text};
+
+const OpaqueCase CASES[] = {
+    {"empty environment",
+     "foo}\\end{foo}",
+     {{ENV_NAME, env_name, "foo"},
+      {{r}, r, "}"},
+      {ENV_BODY, cs_end, "\\end"}}},
+    {"environment",
+     "foo}x{\\end{foo}}\\end{foo}",
+     {{ENV_NAME, env_name, "foo"},
+      {{r}, r, "}"},
+      {ENV_BODY, opaque_env, "x{\\end{foo}}"}}},
+    {"empty display math",
+     "$$$$",
+     {{{display_math_shift}, display_math_shift, "$$"},
+      {{opaque_math, display_math_shift_end}, display_math_shift_end, "$$"}}},
+    {"math",
+     "$x$",
+     {{{math_shift}, math_shift, "$"}, {MATH_BODY, opaque_math, "x"}}},
+    {"empty inline math", "\\)", {{MATH_BODY, cs_inline_math_end, "\\)"}}},
+    {"empty bracketed math", "\\]", {{MATH_BODY, cs_display_math_end, "\\]"}}},
+    {"inline math", "x\\)", {{MATH_BODY, opaque_math, "x"}}},
+    {"short verb made in math",
+     "$\\MakeShortVerb{\\|}$|",
+     {{{math_shift}, math_shift, "$"},
+      {MATH_BODY, opaque_math, "\\MakeShortVerb{\\|}"},
+      {MATH_BODY, math_shift_end, "$"},
+      {TEXT, short_verb_delim, "|"}}},
+    {"short verb deleted in math",
+     "$\\MakeShortVerb*\\|\\DeleteShortVerb{\\|}$|",
+     {{{math_shift}, math_shift, "$"},
+      {MATH_BODY, opaque_math, "\\MakeShortVerb*\\|\\DeleteShortVerb{\\|}"},
+      {MATH_BODY, math_shift_end, "$"},
+      {TEXT, text, "|"}}},
+    {"global catcode in an environment",
+     "foo}\\global\\catcode`\\!=13 \\end{foo}!",
+     {{ENV_NAME, env_name, "foo"},
+      {{r}, r, "}"},
+      {ENV_BODY, opaque_env, "\\global\\catcode`\\!=13 "},
+      {{cs_end}, cs_end, "\\end"},
+      {{l}, l, "{"},
+      {ENV_NAME, env_name, "foo"},
+      {{r}, r, "}"},
+      {TEXT, active_char, "!"}}},
+    {"local catcode in math",
+     "$\\catcode`!=13$!",
+     {{{math_shift}, math_shift, "$"},
+      {MATH_BODY, opaque_math, "\\catcode`!=13"},
+      {MATH_BODY, math_shift_end, "$"},
+      {TEXT, text, "!"}}},
+};
+
+// Returns an empty string if the tokens of the case match or else a
+// description of the first difference.
+std::string check(const OpaqueCase &test) {
+  std::string source(test.source);
+  std::u32string text(source.begin(), source.end());
+  BufferLexer buffer(text);
+  Scanner scanner;
+  bool valid_symbols[SYMBOL_COUNT];
+
+  for (size_t i = 0; i < test.steps.size(); i++) {
+    const Step &step = test.steps[i];
+    const char32_t *start = buffer.position;
+
+    std::fill(valid_symbols, valid_symbols + SYMBOL_COUNT, false);
+    for (SymbolType symbol : step.valid) {
+      valid_symbols[symbol] = true;
+    }
+
+    if (!scanner.scan(&buffer.lexer, valid_symbols)) {
+      return "no token " + std::to_string(i);
+    }
+
+    SymbolType symbol = SymbolType(buffer.lexer.result_symbol);
+    std::string actual = source.substr(start - buffer.begin,
+                                       buffer.marked - start);
+
+    if (symbol != step.symbol || actual != step.text) {
+      return "token " + std::to_string(i) + " is '" + actual +
+             "' with symbol " + std::to_string(symbol) + " instead of '" +
+             step.text + "' with symbol " + std::to_string(step.symbol);
+    }
+
+    buffer.reset(buffer.marked);
+  }
+
+  return "";
+}
+
+int main() {
+  size_t failures = 0;
+
+  tree_sitter_latex_set_opaque_regions(true);
+
+  for (const OpaqueCase &test : CASES) {
+    std::string difference = check(test);
+
+    if (!difference.empty()) {
+      std::cerr << test.name << ": " << difference << std::endl;
+      failures++;
+    }
+  }
+
+  std::cerr << sizeof(CASES) / sizeof(CASES[0]) - failures << " of "
+            << sizeof(CASES) / sizeof(CASES[0]) << " cases pass" << std::endl;
+
+  return failures ? 1 : 0;
+}
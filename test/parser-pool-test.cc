@@ -0,0 +1,177 @@
+// Checks that LaTeX::ParserPool hands out parsers ready for a parse, takes
+// them back reset, counts hits, misses and overflows and never gives the
+// same parser to two threads at once.
+//
+// Usage: parser-pool-test
+
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "parser_pool.hh"
+
+using namespace LaTeX;
+
+extern "C" const TSLanguage *tree_sitter_latex();
+
+const char *const DOCUMENT = "\\section{A}\nText $x$.\n";
+
+int failures = 0;
+
+void check(bool condition, const char *description) {
+  if (!condition) {
+    std::cerr << "Failed: " << description << std::endl;
+    failures++;
+  }
+}
+
+// Whether a parser parses a short document with the LaTeX grammar.
+bool parses(TSParser *parser) {
+  TSTree *tree = ts_parser_parse_string(parser, nullptr, DOCUMENT,
+                                        std::strlen(DOCUMENT));
+  bool parsed = tree && ts_tree_language(tree) == tree_sitter_latex() &&
+                !ts_node_has_error(ts_tree_root_node(tree));
+
+  if (tree) {
+    ts_tree_delete(tree);
+  }
+
+  return parsed;
+}
+
+void check_checkout() {
+  ParserPool pool(tree_sitter_latex(), 2);
+  TSParser *first;
+
+  {
+    PooledParser parser = pool.checkout();
+
+    first = parser;
+    check(parser.get() != nullptr, "a checkout from an empty pool");
+    check(parses(parser), "a new parser has the language");
+
+    ts_parser_set_timeout_micros(parser, 1000);
+  }
+
+  PooledParser parser = pool.checkout();
+  ParserPoolStats stats = pool.stats();
+
+  check(parser.get() == first, "a released parser is checked out again");
+  check(ts_parser_timeout_micros(parser) == 0,
+        "the timeout is cleared on release");
+  check(parses(parser), "a released parser parses again");
+  check(stats.hits == 1 && stats.misses == 1 && stats.overflows == 0,
+        "one hit and one miss");
+  check(stats.checkout_nanos.size() == 2, "both checkouts are timed");
+}
+
+void check_release() {
+  ParserPool pool(tree_sitter_latex(), 2);
+  PooledParser parser = pool.checkout();
+  TSParser *first = parser;
+  PooledParser moved(std::move(parser));
+
+  check(!parser.get() && moved.get() == first, "a move takes the parser");
+
+  parser = pool.checkout();
+  check(parser.get() != first, "a moved parser stays checked out");
+
+  moved.release();
+  check(!moved.get(), "release clears the parser");
+  moved.release();
+
+  PooledParser again = pool.checkout();
+
+  check(again.get() == first, "an explicit release returns the parser once");
+  check(pool.stats().hits == 1, "a second release does nothing");
+}
+
+void check_overflow() {
+  ParserPool pool(tree_sitter_latex(), 2, 1);
+  std::vector<PooledParser> parsers;
+
+  for (int i = 0; i < 4; i++) {
+    parsers.push_back(pool.checkout());
+  }
+
+  ParserPoolStats stats = pool.stats();
+
+  check(stats.hits == 1, "the prefilled parser is a hit");
+  check(stats.misses == 3 && stats.overflows == 2,
+        "checkouts beyond the capacity overflow");
+  check(parses(parsers[3]), "an overflow parser parses");
+
+  std::set<TSParser *> pooled = {parsers[0].get(), parsers[1].get()};
+
+  parsers.clear();
+
+  for (int i = 0; i < 2; i++) {
+    parsers.push_back(pool.checkout());
+  }
+
+  check(pooled == std::set<TSParser *>({parsers[0].get(), parsers[1].get()}),
+        "only parsers within the capacity are kept");
+  check(pool.stats().hits == 3, "the kept parsers are hits");
+}
+
+void check_concurrency() {
+  const unsigned THREAD_COUNT = 8, CHECKOUTS = 2000;
+  ParserPool pool(tree_sitter_latex(), 4, 2);
+  std::mutex mutex;
+  std::set<TSParser *> in_use;
+  std::atomic<unsigned> shared(0), failed_parses(0);
+  std::vector<std::thread> threads;
+
+  for (unsigned i = 0; i < THREAD_COUNT; i++) {
+    threads.emplace_back([&, i]() {
+      for (unsigned j = 0; j < CHECKOUTS; j++) {
+        PooledParser parser = pool.checkout();
+
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          shared += !in_use.insert(parser).second;
+        }
+
+        // A parse now and then keeps parsers checked out long enough for
+        // the pool to run dry.
+        if ((i + j) % 16 == 0 && !parses(parser)) {
+          failed_parses++;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        in_use.erase(parser);
+      }
+    });
+  }
+
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  ParserPoolStats stats = pool.stats();
+
+  check(shared == 0, "no parser is held by two threads");
+  check(failed_parses == 0, "every pooled parser parses");
+  check(stats.hits + stats.misses == THREAD_COUNT * CHECKOUTS,
+        "every checkout is a hit or a miss");
+  check(stats.misses - stats.overflows <= 2,
+        "no more parsers are kept than the capacity");
+}
+
+int main() {
+  check_checkout();
+  check_release();
+  check_overflow();
+  check_concurrency();
+
+  if (failures == 0) {
+    std::cerr << "All parser pool checks pass" << std::endl;
+  }
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,146 @@
+// Loads the fixture project in test/project with several thread counts and
+// checks the files it finds. Its root file uses a package from a search
+// path, which the ls-R file of test/project/texmf lists too, and one that
+// only the ls-R file lists. It inputs a file that does not exist and reaches
+// shared.tex through two spellings of its path, which inputs the root file
+// again.
+//
+// Usage: project-test <fixture directory>
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "project.hh"
+
+using namespace LaTeX;
+
+extern "C" const TSLanguage *tree_sitter_latex();
+
+int failures = 0;
+
+void check(bool condition, unsigned thread_count, const char *description) {
+  if (!condition) {
+    std::cerr << "Failed with " << thread_count
+              << " threads: " << description << std::endl;
+    failures++;
+  }
+}
+
+std::string canonical(const std::string &path) {
+  char buffer[PATH_MAX];
+  return realpath(path.c_str(), buffer) ? buffer : "";
+}
+
+// The id of the file with the given path or the number of files.
+size_t find(const Project &project, const std::string &path) {
+  const auto &files = project.files();
+
+  for (size_t id = 0; id < files.size(); id++) {
+    if (files[id]->path == path) {
+      return id;
+    }
+  }
+
+  return files.size();
+}
+
+std::vector<std::string> dependencies(const Project &project,
+                                      const std::string &path) {
+  std::vector<std::string> result;
+  size_t id = find(project, path);
+
+  if (id < project.files().size()) {
+    for (size_t dependency : project.files()[id]->dependencies) {
+      result.push_back(project.files()[dependency]->path);
+    }
+  }
+
+  return result;
+}
+
+void check_project(const std::string &fixture, const FileDatabase &database,
+                   unsigned thread_count) {
+  Project project(tree_sitter_latex(), thread_count);
+  std::string main = canonical(fixture + "/main.tex"),
+              one = canonical(fixture + "/chapters/one.tex"),
+              two = canonical(fixture + "/chapters/two.tex"),
+              shared = canonical(fixture + "/shared.tex"),
+              local = canonical(fixture + "/sty/local.sty"),
+              texmfpkg = canonical(
+                  fixture + "/texmf/tex/latex/texmfpkg/texmfpkg.sty");
+
+  project.add_search_path(fixture + "/sty");
+  project.set_file_database(&database);
+
+  check(project.load(fixture + "/main.tex"), thread_count, "loads the root");
+  check(!project.load(fixture + "/main.tex"), thread_count,
+        "a project is only loaded once");
+
+  const auto &files = project.files();
+
+  check(files.size() == 6, thread_count, "finds six files");
+  check(!files.empty() && files[0]->path == main, thread_count,
+        "the root file comes first");
+
+  for (const auto &file : files) {
+    check(file->tree != nullptr && !file->source.empty(), thread_count,
+          "every file is parsed");
+  }
+
+  check(dependencies(project, main) ==
+            std::vector<std::string>({local, texmfpkg, one, two}),
+        thread_count,
+        "the references of the root in order, the search path before the "
+        "filename database");
+  check(find(project, main) < files.size() &&
+            files[find(project, main)]->missing ==
+                std::vector<std::string>({"missing"}),
+        thread_count, "the missing input of the root");
+  check(dependencies(project, one) == std::vector<std::string>({shared}) &&
+            dependencies(project, two) == std::vector<std::string>({shared}),
+        thread_count, "both spellings resolve to the same file");
+  check(find(project, texmfpkg) < files.size(), thread_count,
+        "the package in the filename database");
+
+  std::vector<std::pair<size_t, size_t>> cycles = project.cycles();
+
+  check(cycles.size() == 1 &&
+            cycles[0] == std::make_pair(find(project, shared),
+                                        find(project, main)),
+        thread_count, "the input of the root closes the only cycle");
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: project-test <fixture directory>" << std::endl;
+    return 1;
+  }
+
+  std::string fixture = argv[1];
+  FileDatabase database;
+
+  if (!database.load(fixture + "/texmf/ls-R")) {
+    std::cerr << "Cannot read " << fixture << "/texmf/ls-R" << std::endl;
+    return 1;
+  }
+
+  // More threads than files leaves some of them idle.
+  for (unsigned thread_count : {1u, 2u, 16u}) {
+    check_project(fixture, database, thread_count);
+  }
+
+  Project project(tree_sitter_latex(), 2);
+
+  check(!project.load(fixture + "/none.tex"), 2,
+        "a root that does not exist");
+
+  if (failures == 0) {
+    std::cerr << "All project checks pass" << std::endl;
+  }
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,237 @@
+// Checks the boundaries the prescan of LaTeX::SplitDocument finds in
+// snippets, and that a document parsed in chunks has the same tokens as the
+// whole document parsed at once. For the latter every case of the given
+// corpus files is put between two sections and split at each boundary, so
+// that the chunk after the case starts from the scanner state the prescan
+// found for it. Cases whose whole parse has errors are skipped, since error
+// recovery may differ at the chunk ends.
+//
+// Usage: split-test <corpus file ...>
+
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "corpus.hh"
+#include "split.hh"
+
+using namespace LaTeX;
+
+extern "C" const TSLanguage *tree_sitter_latex();
+
+struct BoundaryCase {
+  const char *name, *source;
+  // The text at the start of each boundary.
+  std::vector<std::string> boundaries;
+};
+
+const BoundaryCase BOUNDARY_CASES[] = {
+    {"sections", "\\section{A}\nx\n\\section{B}\ny",
+     {"\\section{A}", "\\section{B}"}},
+    {"sections in the document",
+     "\\documentclass{article}\n\\begin{document}\n\\section{A}\n"
+     "\\subsection{B}\n\\end{document}\n",
+     {"\\section{A}", "\\subsection{B}"}},
+    {"section in a group", "{\\section{A}}\\section{B}", {"\\section{B}"}},
+    {"section in an environment",
+     "\\begin{itemize}\\section{A}\\end{itemize}\\section{B}",
+     {"\\section{B}"}},
+    {"section in a verbatim environment",
+     "\\begin{verbatim}\n\\section{A}\n\\end{verbatim}\n\\section{B}",
+     {"\\section{B}"}},
+    {"section in a comment", "% \\section{A}\n\\section{B}", {"\\section{B}"}},
+    {"section in a short verb",
+     "\\MakeShortVerb{\\|}\n|\\section{A}|\n\\section{B}", {"\\section{B}"}},
+    {"section after a catcode assignment",
+     "\\section{A}\n\\catcode`\\@=11\n\\section{B}", {"\\section{A}"}},
+    {"unbalanced group", "\\section{A}}\\section{B}", {"\\section{A}"}},
+};
+
+TSPoint point_at(const std::string &source, uint32_t offset) {
+  TSPoint point = {0, 0};
+
+  for (uint32_t i = 0; i < offset; i++) {
+    if (source[i] == '\n') {
+      point.row++;
+      point.column = 0;
+    } else {
+      point.column++;
+    }
+  }
+
+  return point;
+}
+
+// Returns an empty string if the boundaries match or else a description of
+// the first difference.
+std::string check_boundaries(const BoundaryCase &test) {
+  std::string source(test.source);
+  SplitPlan plan = prescan(source.data(), source.length());
+
+  if (plan.boundaries.size() != test.boundaries.size()) {
+    return std::to_string(plan.boundaries.size()) + " boundaries instead of " +
+           std::to_string(test.boundaries.size());
+  }
+
+  for (size_t i = 0; i < plan.boundaries.size(); i++) {
+    const SplitBoundary &boundary = plan.boundaries[i];
+    TSPoint point = point_at(source, boundary.byte);
+    const std::string &text = test.boundaries[i];
+
+    if (source.compare(boundary.byte, text.size(), text) != 0) {
+      return "boundary " + std::to_string(i) + " is at '" +
+             source.substr(boundary.byte, text.size()) + "' instead of '" +
+             text + "'";
+    }
+
+    if (boundary.point.row != point.row ||
+        boundary.point.column != point.column) {
+      return "boundary " + std::to_string(i) + " has the wrong point";
+    }
+  }
+
+  return "";
+}
+
+typedef std::tuple<TSSymbol, uint32_t, uint32_t> Token;
+
+// Appends the leaves of a tree that lie within [start, end).
+void collect_tokens(TSNode root, uint32_t start, uint32_t end,
+                    std::vector<Token> &tokens) {
+  TSTreeCursor cursor = ts_tree_cursor_new(root);
+
+  for (;;) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    uint32_t node_start = ts_node_start_byte(node),
+             node_end = ts_node_end_byte(node);
+    bool overlaps = node_start < end && node_end > start;
+
+    if (overlaps && ts_tree_cursor_goto_first_child(&cursor)) {
+      continue;
+    }
+
+    if (overlaps && node_start >= start && node_end <= end) {
+      tokens.emplace_back(ts_node_symbol(node), node_start, node_end);
+    }
+
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        ts_tree_cursor_delete(&cursor);
+        return;
+      }
+    }
+  }
+}
+
+// Returns an empty string if the chunks of a document have the tokens of
+// the whole document or else a description of the first difference. Sets
+// skipped if the whole document has errors.
+std::string check_chunks(TSParser *parser, const std::string &source,
+                         unsigned thread_count, bool &skipped) {
+  TSTree *whole = ts_parser_parse_string(parser, nullptr, source.data(),
+                                         source.length());
+  std::vector<Token> expected, actual;
+
+  skipped = ts_node_has_error(ts_tree_root_node(whole));
+  collect_tokens(ts_tree_root_node(whole), 0, source.length(), expected);
+  ts_tree_delete(whole);
+
+  if (skipped) {
+    return "";
+  }
+
+  SplitDocument document;
+
+  document.parse(tree_sitter_latex(), source.data(), source.length(),
+                 thread_count, 1);
+
+  uint32_t end = 0;
+
+  for (const SplitChunk &chunk : document.chunks()) {
+    if (chunk.start_byte != end || !chunk.tree) {
+      return "the chunks do not cover the document";
+    }
+
+    if (ts_node_has_error(ts_tree_root_node(chunk.tree))) {
+      return "the chunk at byte " + std::to_string(chunk.start_byte) +
+             " has errors";
+    }
+
+    collect_tokens(ts_tree_root_node(chunk.tree), chunk.start_byte,
+                   chunk.end_byte, actual);
+    end = chunk.end_byte;
+  }
+
+  if (end != source.length()) {
+    return "the chunks do not cover the document";
+  }
+
+  for (size_t i = 0; i < expected.size() && i < actual.size(); i++) {
+    if (expected[i] != actual[i]) {
+      return "token " + std::to_string(i) + " at byte " +
+             std::to_string(std::get<1>(actual[i])) + " differs";
+    }
+  }
+
+  if (expected.size() != actual.size()) {
+    return std::to_string(actual.size()) + " tokens instead of " +
+           std::to_string(expected.size());
+  }
+
+  return "";
+}
+
+int main(int argc, char **argv) {
+  size_t failures = 0, checked = 0, skipped_count = 0, split_count = 0;
+
+  for (const BoundaryCase &test : BOUNDARY_CASES) {
+    std::string difference = check_boundaries(test);
+
+    if (!difference.empty()) {
+      std::cerr << test.name << ": " << difference << std::endl;
+      failures++;
+    }
+  }
+
+  TSParser *parser = ts_parser_new();
+
+  ts_parser_set_language(parser, tree_sitter_latex());
+
+  for (int i = 1; i < argc; i++) {
+    std::vector<CorpusCase> cases;
+
+    if (!read_corpus_cases(argv[i], cases)) {
+      std::cerr << "Cannot read " << argv[i] << std::endl;
+      failures++;
+      continue;
+    }
+
+    for (const CorpusCase &test : cases) {
+      std::string source =
+          "\\section{Before}\n" + test.input + "\n\\section{After}\nEnd.\n";
+      bool skipped;
+      std::string difference = check_chunks(parser, source, 4, skipped);
+
+      if (!difference.empty()) {
+        std::cerr << argv[i] << ", " << test.name << ": " << difference
+                  << std::endl;
+        failures++;
+      } else if (skipped) {
+        skipped_count++;
+      } else {
+        checked++;
+        split_count +=
+            prescan(source.data(), source.length()).boundaries.size() > 1;
+      }
+    }
+  }
+
+  ts_parser_delete(parser);
+
+  std::cerr << checked << " documents match their chunks, " << split_count
+            << " of them split, " << skipped_count << " skipped with errors"
+            << std::endl;
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+// Checks the tokens the tokenizer returns for snippets whose scanning
+// depends on the commands before them, e.g. that the text after \verb and
+// its relatives is scanned as document text again.
+//
+// Usage: tokenizer-test
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "scanner.hh"
+#include "tokenizer.h"
+
+using namespace LaTeX;
+
+struct ExpectedToken {
+  SymbolType symbol;
+  const char *text;
+};
+
+struct TokenizerCase {
+  const char *name, *source;
+  std::vector<ExpectedToken> tokens;
+};
+
+const TokenizerCase CASES[] = {
+    {"verb followed by text",
+     "\\verb|a| x",
+     {{cs_verb, "\\verb"},
+      {verb_delim, "|"},
+      {verb_body, "a"},
+      {verb_end_delim, "|"},
+      {_space, " "},
+      {text, "x"}}},
+    {"starred verb",
+     "\\verb*|a b| x",
+     {{cs_verb, "\\verb"},
+      {star, "*"},
+      {verb_delim, "|"},
+      {verb_body, "a b"},
+      {verb_end_delim, "|"},
+      {_space, " "},
+      {text, "x"}}},
+    {"verb at the end",
+     "\\verb|a|",
+     {{cs_verb, "\\verb"},
+      {verb_delim, "|"},
+      {verb_body, "a"},
+      {verb_end_delim, "|"}}},
+    {"lstinline with options",
+     "\\lstinline[x]|a| y",
+     {{cs_lstinline, "\\lstinline"},
+      {lbrack, "["},
+      {text, "x"},
+      {rbrack, "]"},
+      {verb_delim, "|"},
+      {verb_body, "a"},
+      {verb_end_delim, "|"},
+      {_space, " "},
+      {text, "y"}}},
+    {"verbatim environment",
+     "\\begin{verbatim}\n\\x|\n\\end{verbatim} y",
+     {{cs_begin, "\\begin"},
+      {l, "{"},
+      {env_name_verbatim, "verbatim"},
+      {r, "}"},
+      {verbatim_text, "\n\\x|\n"},
+      {cs_end, "\\end"},
+      {l, "{"},
+      {env_name_verbatim, "verbatim"},
+      {r, "}"},
+      {_space, " "},
+      {text, "y"}}},
+};
+
+// Returns an empty string if the tokens of the case match or else a
+// description of the first difference.
+std::string check(const TokenizerCase &test) {
+  uint32_t length = std::strlen(test.source);
+  TSLaTeXTokenizer *tokenizer =
+      tree_sitter_latex_tokenizer_new(test.source, length);
+  TSLaTeXToken token;
+  std::string difference;
+  size_t i = 0;
+
+  for (; difference.empty() &&
+         tree_sitter_latex_tokenizer_next(tokenizer, &token);
+       i++) {
+    std::string actual(test.source + token.start_byte,
+                       token.end_byte - token.start_byte);
+
+    if (i >= test.tokens.size()) {
+      difference = "extra token '" + actual + "'";
+    } else if (token.symbol != test.tokens[i].symbol ||
+               actual != test.tokens[i].text) {
+      difference = "token " + std::to_string(i) + " is '" + actual +
+                   "' with symbol " + std::to_string(token.symbol) +
+                   " instead of '" + test.tokens[i].text + "' with symbol " +
+                   std::to_string(test.tokens[i].symbol);
+    }
+  }
+
+  tree_sitter_latex_tokenizer_delete(tokenizer);
+
+  if (difference.empty() && i < test.tokens.size()) {
+    difference = "missing token '" + std::string(test.tokens[i].text) + "'";
+  }
+
+  return difference;
+}
+
+int main() {
+  size_t failures = 0;
+
+  for (const TokenizerCase &test : CASES) {
+    std::string difference = check(test);
+
+    if (!difference.empty()) {
+      std::cerr << test.name << ": " << difference << std::endl;
+      failures++;
+    }
+  }
+
+  std::cerr << sizeof(CASES) / sizeof(CASES[0]) - failures << " of "
+            << sizeof(CASES) / sizeof(CASES[0]) << " cases pass" << std::endl;
+
+  return failures ? 1 : 0;
+}